@@ -2,6 +2,7 @@
 #include "MeshDescription.h"
 #include "MeshDescriptionBuilder.h"
 #include "StaticMeshAttributes.h"
+#include "StaticMeshResources.h"
 #include "Math/UnrealMathUtility.h"
 
 #include "MeshBuild.h"
@@ -9,6 +10,7 @@
 #include "MeshSimplify/XSPMeshSimplify.h"
 
 #include "XSPStat.h"
+#include "XSPMeshCodec.h"
 
 
 bool bXSPEnableMeshClean = true;
@@ -18,6 +20,13 @@ FAutoConsoleVariableRef CVarXSPEnableMeshClean(
     TEXT("是否剔除网格数据中的无效三角形，缺省为否")
 );
 
+bool bXSPVectorizedRawMeshDecode = true;
+FAutoConsoleVariableRef CVarXSPVectorizedRawMeshDecode(
+    TEXT("xsp.VectorizedRawMeshDecode"),
+    bXSPVectorizedRawMeshDecode,
+    TEXT("解码网格体时是否使用向量化实现(与标量实现的结果在法线量化误差内一致)，缺省为true")
+);
+
 bool bXSPIgnoreRawMesh = false;
 FAutoConsoleVariableRef CVarXSPIgnoreRawMesh(
     TEXT("xsp.IgnoreRawMesh"),
@@ -67,6 +76,48 @@ FAutoConsoleVariableRef CVarXSPSimplyRawMeshPercentVertices(
     TEXT("简化网格的目标顶点数比，缺省为0.5")
 );
 
+bool bXSPInstancePrimitives = true;
+FAutoConsoleVariableRef CVarXSPInstancePrimitives(
+    TEXT("xsp.InstancePrimitives"),
+    bXSPInstancePrimitives,
+    TEXT("圆柱体与椭圆形是否以共享单位网格体的实例绘制(否则在合批时按参数生成网格)，缺省为true")
+);
+
+bool bXSPWeldMeshVertices = true;
+FAutoConsoleVariableRef CVarXSPWeldMeshVertices(
+    TEXT("xsp.WeldMeshVertices"),
+    bXSPWeldMeshVertices,
+    TEXT("是否合并网格中重合且法线相近的顶点，缺省为true")
+);
+
+bool bXSPSmoothMeshNormals = true;
+FAutoConsoleVariableRef CVarXSPSmoothMeshNormals(
+    TEXT("xsp.SmoothMeshNormals"),
+    bXSPSmoothMeshNormals,
+    TEXT("没有法线数据的网格体是否生成平滑法线(否则使用面法线)，缺省为true")
+);
+
+float XSPSmoothMeshNormalsCreaseAngle = 30.f;
+FAutoConsoleVariableRef CVarXSPSmoothMeshNormalsCreaseAngle(
+    TEXT("xsp.SmoothMeshNormals.CreaseAngle"),
+    XSPSmoothMeshNormalsCreaseAngle,
+    TEXT("生成平滑法线时视为棱边的最小面夹角(度)，缺省为30")
+);
+
+float XSPWeldMeshVerticesTolerance = 0.01f;
+FAutoConsoleVariableRef CVarXSPWeldMeshVerticesTolerance(
+    TEXT("xsp.WeldMeshVertices.Tolerance"),
+    XSPWeldMeshVerticesTolerance,
+    TEXT("合并顶点的最大距离(厘米)，缺省为0.01")
+);
+
+float XSPWeldMeshVerticesNormalAngle = 5.f;
+FAutoConsoleVariableRef CVarXSPWeldMeshVerticesNormalAngle(
+    TEXT("xsp.WeldMeshVertices.NormalAngle"),
+    XSPWeldMeshVerticesNormalAngle,
+    TEXT("合并顶点的最大法线夹角(度)，缺省为5")
+);
+
 void ComputeNormal(const TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, int32 Offset)
 {
     int32 NumVertices = PositionList.Num()-Offset;
@@ -135,7 +186,7 @@ void AppendRawMesh(const std::vector<float>& vertices, TArray<FVector3f>& Vertex
     }
 }
 
-void AppendRawMesh(float* MeshVertexBuffer, float* MeshNormalBuffer, int32 BufferLength, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
+void AppendRawMesh(const float* MeshVertexBuffer, const float* MeshNormalBuffer, int32 BufferLength, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
 {
     if (nullptr == MeshVertexBuffer || BufferLength < 9 || BufferLength % 9 != 0)
     {
@@ -186,69 +237,314 @@ void AppendRawMesh(float* MeshVertexBuffer, float* MeshNormalBuffer, int32 Buffe
         }
     }
 
+    //按最大数量预留输出,剔除退化三角形后截断
+    PositionList.AddUninitialized(NumMeshVertices);
+    NormalList.AddUninitialized(NumMeshVertices);
+    IndexList.AddUninitialized(NumMeshVertices);
+    auto DecodeTriangles = bXSPVectorizedRawMeshDecode ? &DecodeRawMeshTriangles : &DecodeRawMeshTrianglesScalar;
+    int32 NumDecodedVertices = 3 * DecodeTriangles(MeshVertexBuffer, MeshNormalBuffer, NumMeshTriangles, bXSPEnableMeshClean, PositionOffset,
+        PositionList.GetData() + PositionOffset, NormalList.GetData() + PositionOffset, IndexList.GetData() + IndexOffset, InOutBoundingBox);
+    PositionList.SetNum(PositionOffset + NumDecodedVertices, false);
+    NormalList.SetNum(PositionOffset + NumDecodedVertices, false);
+    IndexList.SetNum(IndexOffset + NumDecodedVertices, false);
+}
+
+int32 DecodeRawMeshTriangles(const float* MeshVertexBuffer, const float* MeshNormalBuffer, int32 NumTriangles, bool bRejectDegenerate, uint32 BaseIndex,
+    FVector3f* OutPositions, FPackedNormal* OutNormals, uint32* OutIndices, FBox3f& InOutBoundingBox)
+{
+    //W分量缩放为0,使其不影响比较、叉积与包围盒
+    const VectorRegister4Float Scale = MakeVectorRegisterFloat(100.f, 100.f, 100.f, 0.f);
+    const VectorRegister4Float SafeNormalTolerance = VectorSetFloat1(UE_SMALL_NUMBER);
+    VectorRegister4Float BoundsMin = VectorSetFloat1(UE_BIG_NUMBER);
+    VectorRegister4Float BoundsMax = VectorSetFloat1(-UE_BIG_NUMBER);
+
+    int32 NumOutTriangles = 0;
+    for (int32 TriIndex = 0; TriIndex < NumTriangles; TriIndex++)
     {
-        if (bXSPEnableMeshClean)
+        //A、B各读4个float(第4个属于下一顶点),C只读3个,不会越过缓冲区末尾
+        const float* Src = MeshVertexBuffer + TriIndex * 9;
+        VectorRegister4Float A = VectorMultiply(VectorSwizzle(VectorLoad(Src + 0), 1, 0, 2, 3), Scale);
+        VectorRegister4Float B = VectorMultiply(VectorSwizzle(VectorLoad(Src + 3), 1, 0, 2, 3), Scale);
+        VectorRegister4Float C = VectorMultiply(VectorSwizzle(VectorLoadFloat3(Src + 6), 1, 0, 2, 3), Scale);
+
+        if (bRejectDegenerate)
         {
-            int32 Index = PositionOffset;
-            for (size_t j = 0; j < NumMeshTriangles; j++)
-            {
-                FVector3f A(MeshVertexBuffer[j * 9 + 1] * 100, MeshVertexBuffer[j * 9 + 0] * 100, MeshVertexBuffer[j * 9 + 2] * 100);
-                FVector3f B(MeshVertexBuffer[j * 9 + 4] * 100, MeshVertexBuffer[j * 9 + 3] * 100, MeshVertexBuffer[j * 9 + 5] * 100);
-                FVector3f C(MeshVertexBuffer[j * 9 + 7] * 100, MeshVertexBuffer[j * 9 + 6] * 100, MeshVertexBuffer[j * 9 + 8] * 100);
-                if (A == B || A == C || B == C)
-                    continue;
-
-                PositionList.Add(A);
-                PositionList.Add(B);
-                PositionList.Add(C);
-                InOutBoundingBox += A;
-                InOutBoundingBox += B;
-                InOutBoundingBox += C;
-
-                IndexList.Add(Index++);
-                IndexList.Add(Index++);
-                IndexList.Add(Index++);
-
-                if (nullptr != MeshNormalBuffer)
-                {
-                    NormalList.Add(FVector3f(MeshNormalBuffer[j * 9 + 1], MeshNormalBuffer[j * 9 + 0], MeshNormalBuffer[j * 9 + 2]));
-                    NormalList.Add(FVector3f(MeshNormalBuffer[j * 9 + 4], MeshNormalBuffer[j * 9 + 3], MeshNormalBuffer[j * 9 + 5]));
-                    NormalList.Add(FVector3f(MeshNormalBuffer[j * 9 + 7], MeshNormalBuffer[j * 9 + 6], MeshNormalBuffer[j * 9 + 8]));
-                }
-                else
-                {
-                    const FVector3f Edge21 = B - C;
-                    const FVector3f Edge20 = A - C;
-                    FVector3f TriNormal = (Edge21 ^ Edge20).GetSafeNormal();
-                    NormalList.Add(TriNormal);
-                    NormalList.Add(TriNormal);
-                    NormalList.Add(TriNormal);
-                }
-            }
+            //任意两个顶点的XYZ全部相等
+            int32 EqualAB = VectorMaskBits(VectorCompareEQ(A, B)) & 7;
+            int32 EqualAC = VectorMaskBits(VectorCompareEQ(A, C)) & 7;
+            int32 EqualBC = VectorMaskBits(VectorCompareEQ(B, C)) & 7;
+            if (EqualAB == 7 || EqualAC == 7 || EqualBC == 7)
+                continue;
+        }
+
+        int32 OutVertex = NumOutTriangles * 3;
+        VectorStoreFloat3(A, &OutPositions[OutVertex + 0].X);
+        VectorStoreFloat3(B, &OutPositions[OutVertex + 1].X);
+        VectorStoreFloat3(C, &OutPositions[OutVertex + 2].X);
+        BoundsMin = VectorMin(BoundsMin, VectorMin(A, VectorMin(B, C)));
+        BoundsMax = VectorMax(BoundsMax, VectorMax(A, VectorMax(B, C)));
+
+        if (nullptr != MeshNormalBuffer)
+        {
+            const float* SrcNormal = MeshNormalBuffer + TriIndex * 9;
+            FVector4f Normal;
+            VectorStore(VectorSet_W1(VectorSwizzle(VectorLoad(SrcNormal + 0), 1, 0, 2, 3)), &Normal.X);
+            OutNormals[OutVertex + 0] = Normal;
+            VectorStore(VectorSet_W1(VectorSwizzle(VectorLoad(SrcNormal + 3), 1, 0, 2, 3)), &Normal.X);
+            OutNormals[OutVertex + 1] = Normal;
+            VectorStore(VectorSet_W1(VectorSwizzle(VectorLoadFloat3(SrcNormal + 6), 1, 0, 2, 3)), &Normal.X);
+            OutNormals[OutVertex + 2] = Normal;
         }
         else
         {
-            PositionList.AddUninitialized(NumMeshVertices);
-            IndexList.AddUninitialized(NumMeshVertices);
-            for (size_t j = 0; j < NumMeshVertices; j++)
-            {
-                PositionList[PositionOffset + j].Set(MeshVertexBuffer[j * 3 + 1] * 100, MeshVertexBuffer[j * 3 + 0] * 100, MeshVertexBuffer[j * 3 + 2] * 100);
-                InOutBoundingBox += PositionList[PositionOffset + j];
-                IndexList[IndexOffset + j] = PositionOffset + j;
-            }
+            //与(B - C) ^ (A - C)).GetSafeNormal()相同,长度过小时为零向量
+            VectorRegister4Float Normal = VectorCross(VectorSubtract(B, C), VectorSubtract(A, C));
+            VectorRegister4Float SizeSquared = VectorDot3(Normal, Normal);
+            Normal = VectorSelect(VectorCompareGT(SizeSquared, SafeNormalTolerance), VectorMultiply(Normal, VectorReciprocalSqrtAccurate(SizeSquared)), VectorZeroFloat());
+            FVector4f TriNormal;
+            VectorStore(VectorSet_W1(Normal), &TriNormal.X);
+            FPackedNormal PackedNormal(TriNormal);
+            OutNormals[OutVertex + 0] = PackedNormal;
+            OutNormals[OutVertex + 1] = PackedNormal;
+            OutNormals[OutVertex + 2] = PackedNormal;
+        }
+
+        OutIndices[OutVertex + 0] = BaseIndex + OutVertex + 0;
+        OutIndices[OutVertex + 1] = BaseIndex + OutVertex + 1;
+        OutIndices[OutVertex + 2] = BaseIndex + OutVertex + 2;
+        NumOutTriangles++;
+    }
+
+    if (NumOutTriangles > 0)
+    {
+        FVector3f Min, Max;
+        VectorStoreFloat3(BoundsMin, &Min.X);
+        VectorStoreFloat3(BoundsMax, &Max.X);
+        InOutBoundingBox += FBox3f(Min, Max);
+    }
+    return NumOutTriangles;
+}
+
+int32 DecodeRawMeshTrianglesScalar(const float* MeshVertexBuffer, const float* MeshNormalBuffer, int32 NumTriangles, bool bRejectDegenerate, uint32 BaseIndex,
+    FVector3f* OutPositions, FPackedNormal* OutNormals, uint32* OutIndices, FBox3f& InOutBoundingBox)
+{
+    int32 NumOutTriangles = 0;
+    for (int32 j = 0; j < NumTriangles; j++)
+    {
+        FVector3f A(MeshVertexBuffer[j * 9 + 1] * 100, MeshVertexBuffer[j * 9 + 0] * 100, MeshVertexBuffer[j * 9 + 2] * 100);
+        FVector3f B(MeshVertexBuffer[j * 9 + 4] * 100, MeshVertexBuffer[j * 9 + 3] * 100, MeshVertexBuffer[j * 9 + 5] * 100);
+        FVector3f C(MeshVertexBuffer[j * 9 + 7] * 100, MeshVertexBuffer[j * 9 + 6] * 100, MeshVertexBuffer[j * 9 + 8] * 100);
+        if (bRejectDegenerate && (A == B || A == C || B == C))
+            continue;
+
+        int32 OutVertex = NumOutTriangles * 3;
+        OutPositions[OutVertex + 0] = A;
+        OutPositions[OutVertex + 1] = B;
+        OutPositions[OutVertex + 2] = C;
+        InOutBoundingBox += A;
+        InOutBoundingBox += B;
+        InOutBoundingBox += C;
+
+        if (nullptr != MeshNormalBuffer)
+        {
+            OutNormals[OutVertex + 0] = FVector3f(MeshNormalBuffer[j * 9 + 1], MeshNormalBuffer[j * 9 + 0], MeshNormalBuffer[j * 9 + 2]);
+            OutNormals[OutVertex + 1] = FVector3f(MeshNormalBuffer[j * 9 + 4], MeshNormalBuffer[j * 9 + 3], MeshNormalBuffer[j * 9 + 5]);
+            OutNormals[OutVertex + 2] = FVector3f(MeshNormalBuffer[j * 9 + 7], MeshNormalBuffer[j * 9 + 6], MeshNormalBuffer[j * 9 + 8]);
+        }
+        else
+        {
+            const FVector3f Edge21 = B - C;
+            const FVector3f Edge20 = A - C;
+            FVector3f TriNormal = (Edge21 ^ Edge20).GetSafeNormal();
+            OutNormals[OutVertex + 0] = TriNormal;
+            OutNormals[OutVertex + 1] = TriNormal;
+            OutNormals[OutVertex + 2] = TriNormal;
+        }
+
+        OutIndices[OutVertex + 0] = BaseIndex + OutVertex + 0;
+        OutIndices[OutVertex + 1] = BaseIndex + OutVertex + 1;
+        OutIndices[OutVertex + 2] = BaseIndex + OutVertex + 2;
+        NumOutTriangles++;
+    }
+    return NumOutTriangles;
+}
+
+namespace
+{
+    //按位置查找邻近顶点的空间哈希
+    //格子边长取容差的2倍,与某点距离不超过容差的点只可能落在每轴上最近的两个格子中
+    class FXSPVertexHash
+    {
+    public:
+        FXSPVertexHash(float InTolerance, int32 NumVertices)
+            : Tolerance(FMath::Max(InTolerance, 0.001f))
+        {
+            InvCellSize = 0.5f / Tolerance;
+            CellHeadMap.Reserve(NumVertices / 4);
+            NextInCell.Reserve(NumVertices);
+        }
+
+        //加入的顶点按加入顺序从0编号
+        int32 Add(const FVector3f& Position)
+        {
+            FVector3f CellPosition = Position * InvCellSize;
+            int32& Head = CellHeadMap.FindOrAdd(GetCell(CellPosition), INDEX_NONE);
+            NextInCell.Add(Head);
+            Head = NextInCell.Num() - 1;
+            return Head;
+        }
 
-            NormalList.AddUninitialized(NumMeshVertices);
-            if (nullptr != MeshNormalBuffer)
+        //在Position附近的格子中查找第一个满足Predicate的顶点,没有时返回INDEX_NONE
+        template<typename PredicateType>
+        int32 FindFirst(const FVector3f& Position, PredicateType Predicate) const
+        {
+            FVector3f CellPosition = Position * InvCellSize;
+            FIntVector Cell = GetCell(CellPosition);
+            FIntVector Neighbor(CellPosition.X - Cell.X < 0.5f ? -1 : 1, CellPosition.Y - Cell.Y < 0.5f ? -1 : 1, CellPosition.Z - Cell.Z < 0.5f ? -1 : 1);
+            for (int32 CellIndex = 0; CellIndex < 8; CellIndex++)
             {
-                for (size_t j = 0; j < NumMeshVertices; j++)
+                FIntVector SearchCell(Cell.X + (CellIndex & 1 ? Neighbor.X : 0), Cell.Y + (CellIndex & 2 ? Neighbor.Y : 0), Cell.Z + (CellIndex & 4 ? Neighbor.Z : 0));
+                const int32* Head = CellHeadMap.Find(SearchCell);
+                for (int32 Index = Head ? *Head : INDEX_NONE; Index != INDEX_NONE; Index = NextInCell[Index])
                 {
-                    NormalList[PositionOffset + j] = FVector3f(MeshNormalBuffer[j * 3 + 1], MeshNormalBuffer[j * 3 + 0], MeshNormalBuffer[j * 3 + 2]);
+                    if (Predicate(Index))
+                        return Index;
                 }
             }
-            else
+            return INDEX_NONE;
+        }
+
+        float GetToleranceSquared() const { return Tolerance * Tolerance; }
+
+    private:
+        static FIntVector GetCell(const FVector3f& CellPosition)
+        {
+            return FIntVector(FMath::FloorToInt32(CellPosition.X), FMath::FloorToInt32(CellPosition.Y), FMath::FloorToInt32(CellPosition.Z));
+        }
+
+        float Tolerance;
+        float InvCellSize;
+        //每个格子中顶点的链表
+        TMap<FIntVector, int32> CellHeadMap;
+        TArray<int32> NextInCell;
+    };
+}
+
+int32 WeldMeshVertices(TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, float Tolerance, float MinNormalDot, bool bRemoveDegenerate)
+{
+    int32 NumVertices = PositionList.Num();
+    check(NormalList.Num() == NumVertices);
+    if (NumVertices == 0)
+        return 0;
+
+    //合并后的顶点原地写到数组前部,哈希中的顶点编号即合并后的编号
+    FXSPVertexHash VertexHash(Tolerance, NumVertices);
+    float ToleranceSquared = VertexHash.GetToleranceSquared();
+    TArray<uint32> RemapArray;
+    RemapArray.SetNumUninitialized(NumVertices);
+
+    int32 NumWeldedVertices = 0;
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        FVector3f Position = PositionList[i];
+        FPackedNormal PackedNormal = NormalList[i];
+        FVector3f Normal = PackedNormal.ToFVector3f();
+
+        int32 WeldedIndex = VertexHash.FindFirst(Position, [&](int32 Index) {
+            return FVector3f::DistSquared(Position, PositionList[Index]) <= ToleranceSquared && (Normal | NormalList[Index].ToFVector3f()) >= MinNormalDot;
+        });
+        if (WeldedIndex == INDEX_NONE)
+        {
+            WeldedIndex = VertexHash.Add(Position);
+            PositionList[WeldedIndex] = Position;
+            NormalList[WeldedIndex] = PackedNormal;
+            NumWeldedVertices++;
+        }
+        RemapArray[i] = WeldedIndex;
+    }
+
+    int32 NumIndices = 0;
+    for (int32 i = 0; i + 2 < IndexList.Num(); i += 3)
+    {
+        uint32 A = RemapArray[IndexList[i]];
+        uint32 B = RemapArray[IndexList[i + 1]];
+        uint32 C = RemapArray[IndexList[i + 2]];
+        if (bRemoveDegenerate && (A == B || A == C || B == C))
+            continue;
+        IndexList[NumIndices++] = A;
+        IndexList[NumIndices++] = B;
+        IndexList[NumIndices++] = C;
+    }
+
+    PositionList.SetNum(NumWeldedVertices);
+    NormalList.SetNum(NumWeldedVertices);
+    IndexList.SetNum(NumIndices);
+    return NumVertices - NumWeldedVertices;
+}
+
+void SmoothMeshNormals(const TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, const TArray<uint32>& IndexList, int32 FirstIndex, float Tolerance, float MinFaceNormalDot)
+{
+    int32 NumCorners = IndexList.Num() - FirstIndex;
+    if (NumCorners < 3)
+        return;
+    const uint32* Corners = IndexList.GetData() + FirstIndex;
+
+    //各三角形的面法线与各角的内角
+    int32 NumTriangles = NumCorners / 3;
+    TArray<FVector3f> FaceNormals;
+    TArray<float> CornerAngles;
+    FaceNormals.SetNumUninitialized(NumTriangles);
+    CornerAngles.SetNumUninitialized(NumTriangles * 3);
+    for (int32 TriIndex = 0; TriIndex < NumTriangles; TriIndex++)
+    {
+        const FVector3f& A = PositionList[Corners[TriIndex * 3]];
+        const FVector3f& B = PositionList[Corners[TriIndex * 3 + 1]];
+        const FVector3f& C = PositionList[Corners[TriIndex * 3 + 2]];
+        FaceNormals[TriIndex] = ((B - C) ^ (A - C)).GetSafeNormal();
+
+        FVector3f AB = (B - A).GetSafeNormal(), BC = (C - B).GetSafeNormal(), CA = (A - C).GetSafeNormal();
+        CornerAngles[TriIndex * 3] = FMath::Acos(FMath::Clamp(AB | -CA, -1.f, 1.f));
+        CornerAngles[TriIndex * 3 + 1] = FMath::Acos(FMath::Clamp(BC | -AB, -1.f, 1.f));
+        CornerAngles[TriIndex * 3 + 2] = FMath::Acos(FMath::Clamp(CA | -BC, -1.f, 1.f));
+    }
+
+    //按位置将角分组,每组以第一个角的位置为准,组内的角用链表连接
+    FXSPVertexHash VertexHash(Tolerance, NumCorners);
+    float ToleranceSquared = VertexHash.GetToleranceSquared();
+    TArray<FVector3f> GroupPositions;
+    TArray<int32> GroupHeads;
+    TArray<int32> NextInGroup;
+    NextInGroup.SetNumUninitialized(NumTriangles * 3);
+    for (int32 Corner = 0; Corner < NumTriangles * 3; Corner++)
+    {
+        const FVector3f& Position = PositionList[Corners[Corner]];
+        int32 Group = VertexHash.FindFirst(Position, [&](int32 Index) {
+            return FVector3f::DistSquared(Position, GroupPositions[Index]) <= ToleranceSquared;
+        });
+        if (Group == INDEX_NONE)
+        {
+            Group = VertexHash.Add(Position);
+            GroupPositions.Add(Position);
+            GroupHeads.Add(INDEX_NONE);
+        }
+        NextInGroup[Corner] = GroupHeads[Group];
+        GroupHeads[Group] = Corner;
+    }
+
+    for (int32 Head : GroupHeads)
+    {
+        for (int32 Corner = Head; Corner != INDEX_NONE; Corner = NextInGroup[Corner])
+        {
+            const FVector3f& FaceNormal = FaceNormals[Corner / 3];
+            FVector3f Normal = FVector3f::ZeroVector;
+            for (int32 Other = Head; Other != INDEX_NONE; Other = NextInGroup[Other])
             {
-                ComputeNormal(PositionList, NormalList, PositionOffset);
+                const FVector3f& OtherFaceNormal = FaceNormals[Other / 3];
+                if ((FaceNormal | OtherFaceNormal) >= MinFaceNormalDot)
+                    Normal += OtherFaceNormal * CornerAngles[Other];
             }
+            //退化三角形的角保持面法线
+            NormalList[Corners[Corner]] = Normal.Normalize() ? Normal : FaceNormal;
         }
     }
 }
@@ -306,55 +602,123 @@ void AppendEllipticalMesh(const std::vector<float>& vertices, TArray<FVector3f>&
         NormalList->Append(EllipticalMeshNormals);
 }
 
-void AppendEllipticalMesh(float* PrimitiveParamsBuffer, uint8 BufferLength, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
+namespace
 {
-    if (nullptr == PrimitiveParamsBuffer || BufferLength < 10)
+    //椭圆形的圆周分段数
+    static const int32 XSPEllipticalNumSegments = 18;
+
+    void AppendEllipticalMesh(const FVector3f& Origin, const FVector3f& XVector, const FVector3f& YVector, float Radius, int32 NumSegments,
+        TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
     {
-        checkNoEntry();
-        return;
+        float DeltaAngle = UE_TWO_PI / NumSegments;
+        FVector3f Normal = (XVector ^ YVector).GetSafeNormal();
+        uint32 PositionOffset = PositionList.Num();
+
+        //沿径向的一圈向量
+        TArray<FVector3f> RadialVectors;
+        RadialVectors.SetNumUninitialized(NumSegments);
+        for (int32 i = 0; i < NumSegments; i++)
+        {
+            RadialVectors[i] = XVector * Radius * FMath::Sin(DeltaAngle * i) + YVector * Radius * FMath::Cos(DeltaAngle * i);
+        }
+
+        //椭圆面
+        TArray<FVector3f> EllipticalMeshVertices;
+        TArray<FPackedNormal> EllipticalMeshNormals;
+        TArray<uint32> EllipticalMeshIndices;
+        EllipticalMeshVertices.SetNumUninitialized(NumSegments + 1);
+        EllipticalMeshNormals.SetNumUninitialized(NumSegments + 1);
+        EllipticalMeshIndices.SetNumUninitialized(NumSegments * 3);
+        EllipticalMeshVertices[0] = Origin;
+        EllipticalMeshNormals[0] = Normal;
+        InOutBoundingBox += Origin;
+        for (int32 i = 0; i < NumSegments; i++)
+        {
+            EllipticalMeshVertices[i+1] = Origin + RadialVectors[i];
+            EllipticalMeshNormals[i+1] = Normal;
+            InOutBoundingBox += EllipticalMeshVertices[i+1];
+
+            //中心、下一个、当前径向顶点,与三角形数组版本的绕序相同
+            EllipticalMeshIndices[i * 3] = PositionOffset;
+            EllipticalMeshIndices[i * 3 + 1] = PositionOffset + (i + 1) % NumSegments + 1;
+            EllipticalMeshIndices[i * 3 + 2] = PositionOffset + i + 1;
+        }
+        PositionList.Append(MoveTemp(EllipticalMeshVertices));
+        NormalList.Append(MoveTemp(EllipticalMeshNormals));
+        IndexList.Append(MoveTemp(EllipticalMeshIndices));
     }
 
-    static const int32 NumSegments = 18;
-    float DeltaAngle = UE_TWO_PI / NumSegments;
+    void AppendCylinderMesh(const FVector3f& TopCenter, const FVector3f& BottomCenter, float Radius, int32 NumSegments,
+        TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
+    {
+        float DeltaAngle = UE_TWO_PI / NumSegments;
 
-    //[origin，xVector，yVector，radius]
-    FVector3f Origin(PrimitiveParamsBuffer[1] * 100, PrimitiveParamsBuffer[0] * 100, PrimitiveParamsBuffer[2] * 100);
-    FVector3f XVector(PrimitiveParamsBuffer[4], PrimitiveParamsBuffer[3], PrimitiveParamsBuffer[5]); //单位方向向量?
-    FVector3f YVector(PrimitiveParamsBuffer[7], PrimitiveParamsBuffer[6], PrimitiveParamsBuffer[8]);
-    float Radius = PrimitiveParamsBuffer[9] * 100;
+        //轴向
+        FVector3f UpDir = TopCenter - BottomCenter;
+        UpDir.Normalize();
 
-    FVector3f Normal = (XVector ^ YVector).GetSafeNormal();
+        //计算径向
+        FVector3f RightDir;
+        if (FMath::Abs(UpDir.Z) > UE_SQRT_3 / 3)
+            RightDir.Set(1, 0, 0);
+        else
+            RightDir.Set(0, 0, 1);
+        RightDir.Normalize();
+        FVector3f RadialDir = FVector3f::CrossProduct(RightDir, UpDir);
+        RadialDir.Normalize();
+
+        //沿径向的一圈向量
+        TArray<FVector3f> RadialVectors;
+        RadialVectors.SetNumUninitialized(NumSegments);
+        for (int32 i = 0; i < NumSegments; i++)
+        {
+            RadialVectors[i] = RadialDir.RotateAngleAxisRad(DeltaAngle * i, UpDir) * Radius;
+        }
 
-    //沿径向的一圈向量
-    TArray<FVector3f> RadialVectors;
-    RadialVectors.SetNumUninitialized(NumSegments);
-    for (int32 i = 0; i < NumSegments; i++)
-    {
-        RadialVectors[i] = XVector * Radius * FMath::Sin(DeltaAngle * i) + YVector * Radius * FMath::Cos(DeltaAngle * i);
+        uint32 PositionOffset = PositionList.Num();
+
+        //每个径向上顶面、底面各一个顶点,侧面每段两个三角形,与三角形数组版本的绕序相同
+        TArray<FVector3f> CylinderMeshVertices;
+        TArray<FPackedNormal> CylinderMeshNormals;
+        TArray<uint32> CylinderMeshIndices;
+        CylinderMeshVertices.SetNumUninitialized(NumSegments * 2);
+        CylinderMeshNormals.SetNumUninitialized(NumSegments * 2);
+        CylinderMeshIndices.SetNumUninitialized(NumSegments * 6);
+        for (int32 i = 0; i < NumSegments; i++)
+        {
+            CylinderMeshVertices[i * 2] = TopCenter + RadialVectors[i];
+            CylinderMeshVertices[i * 2 + 1] = BottomCenter + RadialVectors[i];
+            InOutBoundingBox += CylinderMeshVertices[i * 2];
+            InOutBoundingBox += CylinderMeshVertices[i * 2 + 1];
+
+            FVector3f Normal = RadialVectors[i].GetSafeNormal();
+            CylinderMeshNormals[i * 2] = Normal;
+            CylinderMeshNormals[i * 2 + 1] = Normal;
+
+            uint32 Top = PositionOffset + i * 2;
+            uint32 NextTop = PositionOffset + (i + 1) % NumSegments * 2;
+            CylinderMeshIndices[i * 6] = Top;
+            CylinderMeshIndices[i * 6 + 1] = NextTop + 1;
+            CylinderMeshIndices[i * 6 + 2] = Top + 1;
+            CylinderMeshIndices[i * 6 + 3] = NextTop + 1;
+            CylinderMeshIndices[i * 6 + 4] = Top;
+            CylinderMeshIndices[i * 6 + 5] = NextTop;
+        }
+
+        PositionList.Append(MoveTemp(CylinderMeshVertices));
+        NormalList.Append(MoveTemp(CylinderMeshNormals));
+        IndexList.Append(MoveTemp(CylinderMeshIndices));
     }
 
-    //椭圆面
-    TArray<FVector3f> EllipticalMeshVertices;
-    TArray<FPackedNormal> EllipticalMeshNormals;
-    TArray<uint32> EllipticalMeshIndices;
-    EllipticalMeshVertices.SetNumUninitialized(NumSegments + 1);
-    EllipticalMeshNormals.SetNumUninitialized(NumSegments + 1);
-    EllipticalMeshIndices.SetNumUninitialized(NumSegments * 3);
-    EllipticalMeshVertices[0] = Origin;
-    EllipticalMeshNormals[0] = Normal;
-    for (int32 i = 0; i < NumSegments; i++)
+    //圆心为Center、法线为Normal的圆的包围盒
+    FBox3f GetCircleBoundingBox(const FVector3f& Center, const FVector3f& Normal, float Radius)
     {
-        EllipticalMeshVertices[i+1] = Origin + RadialVectors[i];
-        EllipticalMeshNormals[i+1] = Normal;
-        InOutBoundingBox += EllipticalMeshVertices[i+1];
-
-        EllipticalMeshIndices[i] = 0;
-        EllipticalMeshIndices[i + 1] = (i + 2) % NumSegments;
-        EllipticalMeshIndices[i + 2] = i + 1;
+        FVector3f Extent(
+            Radius * FMath::Sqrt(FMath::Max(0.f, 1.f - Normal.X * Normal.X)),
+            Radius * FMath::Sqrt(FMath::Max(0.f, 1.f - Normal.Y * Normal.Y)),
+            Radius * FMath::Sqrt(FMath::Max(0.f, 1.f - Normal.Z * Normal.Z)));
+        return FBox3f(Center - Extent, Center + Extent);
     }
-    PositionList.Append(MoveTemp(EllipticalMeshVertices));
-    NormalList.Append(MoveTemp(EllipticalMeshNormals));
-    IndexList.Append(MoveTemp(EllipticalMeshIndices));
 }
 
 //圆柱体
@@ -448,7 +812,34 @@ bool AppendCylinderMesh(const std::vector<float>& vertices, TArray<FVector3f>& V
     return true;
 }
 
-bool AppendCylinderMesh(float* PrimitiveParamsBuffer, uint8 BufferLength, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
+int32 GetCylinderNumSegments(float Radius)
+{
+    return Radius > 1.f ? (Radius > 4.f ? (Radius > 10.f ? (Radius > 16.f ? 18 : 12) : 9) : 6) : 3;
+}
+
+bool MakeEllipticalInstance(const float* PrimitiveParamsBuffer, uint8 BufferLength, FXSPPrimitiveInstance& OutInstance)
+{
+    if (nullptr == PrimitiveParamsBuffer || BufferLength < 10)
+    {
+        checkNoEntry();
+        return false;
+    }
+
+    //[origin，xVector，yVector，radius],两轴按源数据保存(不要求为正交的单位向量)
+    FVector3f XVector(PrimitiveParamsBuffer[4], PrimitiveParamsBuffer[3], PrimitiveParamsBuffer[5]);
+    FVector3f YVector(PrimitiveParamsBuffer[7], PrimitiveParamsBuffer[6], PrimitiveParamsBuffer[8]);
+    OutInstance.Type = EXSPPrimitiveType::Elliptical;
+    OutInstance.NumSegments = XSPEllipticalNumSegments;
+    OutInstance.Center = FVector3f(PrimitiveParamsBuffer[1] * 100, PrimitiveParamsBuffer[0] * 100, PrimitiveParamsBuffer[2] * 100);
+    OutInstance.Axis = (XVector ^ YVector).GetSafeNormal();
+    OutInstance.Radius = PrimitiveParamsBuffer[9] * 100;
+    OutInstance.XVector = XVector * OutInstance.Radius;
+    OutInstance.YVector = YVector * OutInstance.Radius;
+    OutInstance.Length = 0;
+    return !OutInstance.Axis.IsZero() && OutInstance.Radius > 0;
+}
+
+bool MakeCylinderInstance(const float* PrimitiveParamsBuffer, uint8 BufferLength, FXSPPrimitiveInstance& OutInstance)
 {
     if (nullptr == PrimitiveParamsBuffer || BufferLength < 13)
     {
@@ -463,98 +854,87 @@ bool AppendCylinderMesh(float* PrimitiveParamsBuffer, uint8 BufferLength, TArray
     if (Radius < 0.01f)
         return false;
 
-    int32 NumSegments = Radius > 1.f ? (Radius > 4.f ? (Radius > 10.f ? (Radius > 16.f ? 18 : 12) : 9) : 6) : 3;
-    float DeltaAngle = UE_TWO_PI / NumSegments;
-
-    //轴向
-    FVector3f UpDir = TopCenter - BottomCenter;
-    float Height = UpDir.Length();
-    UpDir.Normalize();
+    FVector3f Axis = TopCenter - BottomCenter;
+    float Length = Axis.Length();
+    if (Length < UE_KINDA_SMALL_NUMBER)
+        return false;
 
-    //计算径向
-    FVector3f RightDir;
-    if (FMath::Abs(UpDir.Z) > UE_SQRT_3 / 3)
-        RightDir.Set(1, 0, 0);
-    else
-        RightDir.Set(0, 0, 1);
-    RightDir.Normalize();
-    FVector3f RadialDir = FVector3f::CrossProduct(RightDir, UpDir);
-    RadialDir.Normalize();
+    OutInstance.Type = EXSPPrimitiveType::Cylinder;
+    OutInstance.NumSegments = GetCylinderNumSegments(Radius);
+    OutInstance.Center = BottomCenter;
+    OutInstance.Axis = Axis / Length;
+    OutInstance.Radius = Radius;
+    OutInstance.Length = Length;
+    return true;
+}
 
-    //沿径向的一圈向量
-    TArray<FVector3f> RadialVectors;
-    RadialVectors.SetNumUninitialized(NumSegments);
-    for (int32 i = 0; i < NumSegments; i++)
+FTransform GetPrimitiveInstanceTransform(const FXSPPrimitiveInstance& Instance)
+{
+    if (Instance.Type == EXSPPrimitiveType::Cylinder)
     {
-        RadialVectors[i] = RadialDir.RotateAngleAxisRad(DeltaAngle * i, UpDir) * Radius;
+        //单位网格体的轴向为Z,旋转到实例的轴向;绕轴的旋转不影响形状
+        FQuat Rotation = FRotationMatrix::MakeFromZ(FVector(Instance.Axis)).ToQuat();
+        return FTransform(Rotation, FVector(Instance.Center), FVector(Instance.Radius, Instance.Radius, Instance.Length));
     }
 
-    TArray<FVector3f> CylinderMeshVertices;
-    TArray<FPackedNormal> CylinderMeshNormals;
-    TArray<uint32> CylinderMeshIndices;
-    CylinderMeshVertices.SetNumUninitialized(NumSegments * 2);
-    CylinderMeshNormals.SetNumUninitialized(NumSegments * 2);
-    CylinderMeshIndices.SetNumUninitialized(NumSegments * 6);
-    for (int32 i = 0; i < NumSegments; i++)
+    //单位圆盘的X、Y轴旋转到椭圆形的两轴(须正交,见CanInstance),按两轴长度非均匀缩放
+    FVector XAxis = FVector(Instance.XVector).GetSafeNormal();
+    FVector ZAxis = FVector(Instance.Axis);
+    FVector YAxis = ZAxis ^ XAxis;
+    FQuat Rotation(FMatrix(XAxis, YAxis, ZAxis, FVector::ZeroVector));
+    FVector Scale(Instance.XVector.Length(), Instance.YVector.Length(), Instance.Radius);
+    return FTransform(Rotation, FVector(Instance.Center), Scale);
+}
+
+FBox3f GetPrimitiveInstanceBoundingBox(const FXSPPrimitiveInstance& Instance)
+{
+    if (Instance.Type == EXSPPrimitiveType::Cylinder)
     {
-        CylinderMeshVertices[i * 2] = TopCenter + RadialVectors[i];
-        CylinderMeshVertices[i * 2 + 1] = BottomCenter + RadialVectors[i];
+        FBox3f BoundingBox = GetCircleBoundingBox(Instance.Center, Instance.Axis, Instance.Radius);
+        BoundingBox += GetCircleBoundingBox(Instance.Center + Instance.Axis * Instance.Length, Instance.Axis, Instance.Radius);
+        return BoundingBox;
+    }
 
-        FVector3f Normal = RadialVectors[i].GetSafeNormal();
-        Normal.Normalize();
-        CylinderMeshNormals[i * 2] = Normal;
-        CylinderMeshNormals[i * 2 + 1] = Normal;
+    //Center + XVector * sin + YVector * cos在各轴上的最大偏移为两轴分量的平方和开方
+    FVector3f Extent(
+        FMath::Sqrt(FMath::Square(Instance.XVector.X) + FMath::Square(Instance.YVector.X)),
+        FMath::Sqrt(FMath::Square(Instance.XVector.Y) + FMath::Square(Instance.YVector.Y)),
+        FMath::Sqrt(FMath::Square(Instance.XVector.Z) + FMath::Square(Instance.YVector.Z)));
+    return FBox3f(Instance.Center - Extent, Instance.Center + Extent);
+}
 
-        CylinderMeshIndices[i * 6] = i * 2;
-        CylinderMeshIndices[i * 6 + 1] = (i + 1) % NumSegments * 2 + 1;
-        CylinderMeshIndices[i * 6 + 2] = i * 2 + 1;
-        CylinderMeshIndices[i * 6 + 3] = (i + 1) % NumSegments * 2 + 1;
-        CylinderMeshIndices[i * 6 + 4] = i * 2;
-        CylinderMeshIndices[i * 6 + 5] = (i + 1) % NumSegments * 2;
+void AppendPrimitiveInstanceMesh(const FXSPPrimitiveInstance& Instance, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox)
+{
+    if (Instance.Type == EXSPPrimitiveType::Cylinder)
+    {
+        AppendCylinderMesh(Instance.Center + Instance.Axis * Instance.Length, Instance.Center, Instance.Radius, Instance.NumSegments,
+            PositionList, NormalList, IndexList, InOutBoundingBox);
     }
-
-    FVector3f Normal, Normal1;
-    int32 Index = 0;
-    for (int32 i = 0; i < NumSegments; i++)
+    else
     {
-        Normal = RadialVectors[i].GetSafeNormal();
-        Normal1 = RadialVectors[i+1].GetSafeNormal();
-
-        CylinderMeshNormals[Index] = Normal;
-        CylinderMeshVertices[Index] = BottomCenter + RadialVectors[i];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
-
-        CylinderMeshNormals[Index] = Normal;
-        CylinderMeshVertices[Index] = TopCenter + RadialVectors[i];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
-
-        CylinderMeshNormals[Index] = Normal1;
-        CylinderMeshVertices[Index] = BottomCenter + RadialVectors[i + 1];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
-
-        CylinderMeshNormals[Index] = Normal1;
-        CylinderMeshVertices[Index] = BottomCenter + RadialVectors[i + 1];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
-
-        CylinderMeshNormals[Index] = Normal;
-        CylinderMeshVertices[Index] = TopCenter + RadialVectors[i];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
-
-        CylinderMeshNormals[Index] = Normal1;
-        CylinderMeshVertices[Index] = TopCenter + RadialVectors[i + 1];
-        InOutBoundingBox += CylinderMeshVertices[Index];
-        Index++;
+        //两轴已乘以半径,按源数据的两轴生成,与逐片段生成的椭圆形一致
+        AppendEllipticalMesh(Instance.Center, Instance.XVector, Instance.YVector, 1.f, Instance.NumSegments,
+            PositionList, NormalList, IndexList, InOutBoundingBox);
     }
+}
 
-    PositionList.Append(MoveTemp(CylinderMeshVertices));
-    NormalList.Append(MoveTemp(CylinderMeshNormals));
+void BuildPrimitiveUnitMesh(EXSPPrimitiveType Type, int32 NumSegments, TArray<FStaticMeshBuildVertex>& OutVertices, TArray<uint32>& OutIndices, FBox3f& OutBoundingBox)
+{
+    TArray<FVector3f> Positions;
+    TArray<FPackedNormal> Normals;
+    OutIndices.Reset();
+    OutBoundingBox.Init();
+    if (Type == EXSPPrimitiveType::Cylinder)
+        AppendCylinderMesh(FVector3f::UnitZ(), FVector3f::ZeroVector, 1.f, NumSegments, Positions, Normals, OutIndices, OutBoundingBox);
+    else
+        AppendEllipticalMesh(FVector3f::ZeroVector, FVector3f::UnitX(), FVector3f::UnitY(), 1.f, NumSegments, Positions, Normals, OutIndices, OutBoundingBox);
 
-    return true;
+    OutVertices.SetNumZeroed(Positions.Num());
+    for (int32 i = 0; i < Positions.Num(); i++)
+    {
+        OutVertices[i].Position = Positions[i];
+        OutVertices[i].TangentZ = Normals[i].ToFVector3f();
+    }
 }
 
 void AppendNodeMesh(const Body_info& Node, TArray<FVector3f>& VertexList, TArray<FVector3f>* NormalList)
@@ -642,6 +1022,69 @@ void BuildStaticMesh(UStaticMesh* StaticMesh, const Body_info& Node)
     BuildStaticMesh(StaticMesh, VertexList, &NormalList);
 }
 
+void BuildStaticMeshRenderData(UStaticMesh* StaticMesh, const TArray<FStaticMeshBuildVertex>& Vertices, const TArray<uint32>& Indices, const FBox3f& BoundingBox, bool bKeepCPUData, bool bEnableCollision)
+{
+    TUniquePtr<FStaticMeshRenderData> StaticMeshRenderData = MakeUnique<FStaticMeshRenderData>();
+    StaticMeshRenderData->ScreenSize[0].Default = 1.0f;
+    StaticMeshRenderData->AllocateLODResources(1);
+
+    FStaticMeshLODResources& StaticMeshLODResources = StaticMeshRenderData->LODResources[0];
+    StaticMeshLODResources.VertexBuffers.PositionVertexBuffer.Init(Vertices, bKeepCPUData);
+    StaticMeshLODResources.VertexBuffers.StaticMeshVertexBuffer.Init(Vertices, 1, bKeepCPUData);
+    StaticMeshLODResources.IndexBuffer.SetIndices(Indices, (Vertices.Num() <= (int32)MAX_uint16 + 1) ? EIndexBufferStride::Type::Force16Bit : EIndexBufferStride::Type::Force32Bit);
+    StaticMeshLODResources.bHasDepthOnlyIndices = false;
+    StaticMeshLODResources.bHasReversedIndices = false;
+    StaticMeshLODResources.bHasReversedDepthOnlyIndices = false;
+
+    FStaticMeshSection& Section = StaticMeshLODResources.Sections.AddDefaulted_GetRef();
+    Section.bEnableCollision = bEnableCollision;
+    Section.NumTriangles = Indices.Num() / 3;
+    Section.FirstIndex = 0;
+    Section.MinVertexIndex = 0;
+    Section.MaxVertexIndex = Vertices.Num() - 1;
+    Section.MaterialIndex = 0;
+    Section.bForceOpaque = false;
+
+    StaticMeshRenderData->Bounds = FBoxSphereBounds(FBox(BoundingBox));
+
+    StaticMesh->SetRenderData(MoveTemp(StaticMeshRenderData));
+    StaticMesh->InitResources();
+
+    StaticMesh->CalculateExtendedBounds();
+}
+
+void BuildStaticMeshRenderData(UStaticMesh* StaticMesh, const Body_info& Node)
+{
+    TArray<FVector3f> VertexList, NormalList;
+    AppendNodeMesh(Node, VertexList, &NormalList);
+    if (VertexList.Num() < 3 || VertexList.Num() != NormalList.Num())
+    {
+        checkNoEntry();
+        return;
+    }
+
+    //三角形汤,索引即顶点序号
+    int32 NumVertices = VertexList.Num();
+    TArray<FStaticMeshBuildVertex> Vertices;
+    Vertices.SetNumZeroed(NumVertices);
+    TArray<uint32> Indices;
+    Indices.SetNumUninitialized(NumVertices);
+    FBox3f BoundingBox;
+    BoundingBox.Init();
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        Vertices[i].Position = VertexList[i];
+        Vertices[i].TangentZ = NormalList[i];
+        Indices[i] = i;
+        BoundingBox += VertexList[i];
+    }
+
+    StaticMesh->NeverStream = true;
+    StaticMesh->GetStaticMaterials().Add(FStaticMaterial());
+    //与FMeshDescription构建的结果一致开启碰撞,UStaticMesh::GetPhysicsTriMeshData只读取开启碰撞的Section
+    BuildStaticMeshRenderData(StaticMesh, Vertices, Indices, BoundingBox, StaticMesh->bAllowCPUAccess, true);
+}
+
 bool IsValidMaterial(float material[4])
 {
     if (!FMath::IsFinite(material[0]) || !FMath::IsFinite(material[1]) || !FMath::IsFinite(material[2]) || !FMath::IsFinite(material[3]))
@@ -777,7 +1220,7 @@ bool CheckNode(const Body_info& Node)
     return bValid;
 }
 
-void ResolveNodeData(FXSPNodeData& NodeData, FXSPNodeData* ParentNodeData)
+void ResolveNodeData(FXSPNodeData& NodeData, FXSPNodeData* ParentNodeData, EXSPMeshCodec MeshCodec)
 {
     check(NodeData.MeshPositionArray.IsEmpty());
     NodeData.MeshBoundingBox.Init();
@@ -791,31 +1234,96 @@ void ResolveNodeData(FXSPNodeData& NodeData, FXSPNodeData* ParentNodeData)
         case EXSPPrimitiveType::Mesh:
             if (!bXSPIgnoreRawMesh)
             {
+                int32 PositionOffset = NodeData.MeshPositionArray.Num();
+                int32 IndexOffset = NodeData.MeshIndexArray.Num();
                 AppendRawMesh(PrimitiveData.MeshVertexBuffer, PrimitiveData.MeshNormalBuffer, PrimitiveData.MeshVertexBufferLength,
                     NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, NodeData.MeshBoundingBox);
                 INC_DWORD_STAT(STAT_XSPLoader_NumRawMesh);
+
+                //没有法线数据时AppendRawMesh生成的是面法线;简化后的网格已共享顶点,不再处理
+                bool bTriangleSoup = NodeData.MeshPositionArray.Num() - PositionOffset == NodeData.MeshIndexArray.Num() - IndexOffset;
+                if (bXSPSmoothMeshNormals && nullptr == PrimitiveData.MeshNormalBuffer && bTriangleSoup)
+                {
+                    SmoothMeshNormals(NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, IndexOffset,
+                        XSPWeldMeshVerticesTolerance, FMath::Cos(FMath::DegreesToRadians(XSPSmoothMeshNormalsCreaseAngle)));
+                }
             }
             break;
         case EXSPPrimitiveType::Elliptical:
             if (!bXSPIgnoreEllipticalMesh)
             {
-                AppendEllipticalMesh(PrimitiveData.PrimitiveParamsBuffer, PrimitiveData.PrimitiveParamsBufferLength,
-                    NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, NodeData.MeshBoundingBox);
+                //只保留参数,网格在绘制时由实例或合批生成
+                FXSPPrimitiveInstance Instance;
+                if (MakeEllipticalInstance(PrimitiveData.PrimitiveParamsBuffer, PrimitiveData.PrimitiveParamsBufferLength, Instance))
+                {
+                    NodeData.MeshBoundingBox += GetPrimitiveInstanceBoundingBox(Instance);
+                    NodeData.PrimitiveInstanceArray.Add(Instance);
+                    INC_DWORD_STAT(STAT_XSPLoader_NumPrimitiveInstance);
+                }
                 INC_DWORD_STAT(STAT_XSPLoader_NumEllipticalMesh);
             }
             break;
         case EXSPPrimitiveType::Cylinder:
             if (!bXSPIgnoreCylinderMesh)
             {
-                AppendCylinderMesh(PrimitiveData.PrimitiveParamsBuffer, PrimitiveData.PrimitiveParamsBufferLength,
-                    NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, NodeData.MeshBoundingBox);
+                FXSPPrimitiveInstance Instance;
+                if (MakeCylinderInstance(PrimitiveData.PrimitiveParamsBuffer, PrimitiveData.PrimitiveParamsBufferLength, Instance))
+                {
+                    NodeData.MeshBoundingBox += GetPrimitiveInstanceBoundingBox(Instance);
+                    NodeData.PrimitiveInstanceArray.Add(Instance);
+                    INC_DWORD_STAT(STAT_XSPLoader_NumPrimitiveInstance);
+                }
                 INC_DWORD_STAT(STAT_XSPLoader_NumCylinderMesh);
             }
             break;
         }
     }
 
+    //合并三角形之间重复的顶点,生成共享顶点的索引网格
+    if (bXSPWeldMeshVertices && !NodeData.MeshPositionArray.IsEmpty())
+    {
+        int32 NumWeldedVertices = WeldMeshVertices(NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, XSPWeldMeshVerticesTolerance,
+            FMath::Cos(FMath::DegreesToRadians(XSPWeldMeshVerticesNormalAngle)), bXSPEnableMeshClean);
+        INC_DWORD_STAT_BY(STAT_XSPLoader_NumTotalVerticesWelded, NumWeldedVertices);
+    }
+
     //生成网格数据后释放原始Primitive数据
     NodeData.PrimitiveArray.Empty();
+
+    //按选择的编码方式压缩常驻内存的网格数据
+    EncodeNodeMesh(NodeData, MeshCodec);
 }
 
+uint32 GetResolveSettingsHash()
+{
+    uint32 Hash = 0;
+    Hash = HashCombine(Hash, GetTypeHash(bXSPEnableMeshClean));
+    Hash = HashCombine(Hash, GetTypeHash(bXSPIgnoreRawMesh));
+    Hash = HashCombine(Hash, GetTypeHash(bXSPIgnoreEllipticalMesh));
+    Hash = HashCombine(Hash, GetTypeHash(bXSPIgnoreCylinderMesh));
+    Hash = HashCombine(Hash, GetTypeHash(bXSPSimplyRawMesh));
+    if (bXSPSimplyRawMesh)
+    {
+        Hash = HashCombine(Hash, GetTypeHash(XSPSimplyRawMeshMinVertices));
+        Hash = HashCombine(Hash, GetTypeHash(XSPSimplyRawMeshPercentTriangles));
+        Hash = HashCombine(Hash, GetTypeHash(XSPSimplyRawMeshPercentVertices));
+    }
+    Hash = HashCombine(Hash, GetTypeHash(bXSPSmoothMeshNormals));
+    if (bXSPSmoothMeshNormals)
+    {
+        Hash = HashCombine(Hash, GetTypeHash(XSPSmoothMeshNormalsCreaseAngle));
+        Hash = HashCombine(Hash, GetTypeHash(XSPWeldMeshVerticesTolerance));
+    }
+    Hash = HashCombine(Hash, GetTypeHash(bXSPWeldMeshVertices));
+    if (bXSPWeldMeshVertices)
+    {
+        Hash = HashCombine(Hash, GetTypeHash(XSPWeldMeshVerticesTolerance));
+        Hash = HashCombine(Hash, GetTypeHash(XSPWeldMeshVerticesNormalAngle));
+    }
+    Hash = HashCombine(Hash, GetTypeHash((int32)GetMeshCodec()));
+    if (GetMeshCodec() != EXSPMeshCodec::Raw)
+    {
+        Hash = HashCombine(Hash, GetTypeHash(GetMeshCodecMaxError()));
+    }
+    return Hash;
+}
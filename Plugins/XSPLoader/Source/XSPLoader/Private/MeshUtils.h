@@ -4,20 +4,72 @@
 
 #include "CoreMinimal.h"
 #include "XSPFileUtils.h"
+#include "XSPMeshCodec.h"
 
 
 void AppendRawMesh(const std::vector<float>& vertices, TArray<FVector3f>& VertexList, TArray<FVector3f>* NormalList);
 
+/**
+ *	解码网格体的三角形数组(每个三角形9个float,源坐标系,单位米):交换X与Y并放大100倍,剔除退化三角形,
+ *	生成面法线(或转换MeshNormalBuffer中的法线)并扩展包围盒,一次遍历写入调用方按NumTriangles预留的输出
+ *	DecodeRawMeshTriangles使用VectorRegister(SSE/NEON,不支持时为标量实现),DecodeRawMeshTrianglesScalar为逐分量的参考实现
+ *	@param	BaseIndex	[in]	第一个输出顶点的索引
+ *	@return	写入的三角形数
+ */
+int32 DecodeRawMeshTriangles(const float* MeshVertexBuffer, const float* MeshNormalBuffer, int32 NumTriangles, bool bRejectDegenerate, uint32 BaseIndex,
+	FVector3f* OutPositions, FPackedNormal* OutNormals, uint32* OutIndices, FBox3f& InOutBoundingBox);
+int32 DecodeRawMeshTrianglesScalar(const float* MeshVertexBuffer, const float* MeshNormalBuffer, int32 NumTriangles, bool bRejectDegenerate, uint32 BaseIndex,
+	FVector3f* OutPositions, FPackedNormal* OutNormals, uint32* OutIndices, FBox3f& InOutBoundingBox);
+
+/**
+ *	合并位置距离不超过Tolerance且法线夹角余弦不小于MinNormalDot的顶点(空间哈希查找),将三角形数组转为共享顶点的索引网格
+ *	合并后的顶点保留首次出现的位置与法线,包围盒不变
+ *	@param	bRemoveDegenerate	[in]	是否剔除合并后有重复顶点的三角形
+ *	@return	合并掉的顶点数
+ */
+int32 WeldMeshVertices(TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, float Tolerance, float MinNormalDot, bool bRemoveDegenerate);
+
+/**
+ *	按角度加权生成平滑法线:同一位置(距离不超过Tolerance)的各个角,累加面法线夹角余弦不小于MinFaceNormalDot的相邻面的法线,
+ *	夹角更大的视为棱边,保持各自的法线
+ *	只处理从FirstIndex开始的三角形,这些三角形的每个角须使用独立的顶点(三角形数组)
+ */
+void SmoothMeshNormals(const TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, const TArray<uint32>& IndexList, int32 FirstIndex, float Tolerance, float MinFaceNormalDot);
+
 void AppendEllipticalMesh(const std::vector<float>& vertices, TArray<FVector3f>& VertexList, TArray<FVector3f>* NormalList);
 
 bool AppendCylinderMesh(const std::vector<float>& vertices, TArray<FVector3f>& VertexList, TArray<FVector3f>* NormalList);
 
+//圆柱体侧面的圆周分段数(按半径,厘米)
+int32 GetCylinderNumSegments(float Radius);
+
+//由参数化几何体的原始参数生成节点中保存的紧凑参数,参数无效时返回false
+bool MakeEllipticalInstance(const float* PrimitiveParamsBuffer, uint8 BufferLength, FXSPPrimitiveInstance& OutInstance);
+bool MakeCylinderInstance(const float* PrimitiveParamsBuffer, uint8 BufferLength, FXSPPrimitiveInstance& OutInstance);
+
+//实例相对单位网格体的变换与实例的包围盒
+FTransform GetPrimitiveInstanceTransform(const FXSPPrimitiveInstance& Instance);
+FBox3f GetPrimitiveInstanceBoundingBox(const FXSPPrimitiveInstance& Instance);
+
+//按参数生成网格追加到数组,顶点数与索引数同FXSPPrimitiveInstance::GetNumVertices/GetNumIndices
+void AppendPrimitiveInstanceMesh(const FXSPPrimitiveInstance& Instance, TArray<FVector3f>& PositionList, TArray<FPackedNormal>& NormalList, TArray<uint32>& IndexList, FBox3f& InOutBoundingBox);
+
+//生成实例共享的单位网格体:圆柱体为半径1、从原点沿Z轴高1,椭圆形为XY平面上圆心在原点、半径1的圆
+void BuildPrimitiveUnitMesh(EXSPPrimitiveType Type, int32 NumSegments, TArray<FStaticMeshBuildVertex>& OutVertices, TArray<uint32>& OutIndices, FBox3f& OutBoundingBox);
+
 void AppendNodeMesh(const Body_info& Node, TArray<FVector3f>& VertexList, TArray<FVector3f>* NormalList);
 
 void BuildStaticMesh(UStaticMesh* StaticMesh, const TArray<FVector3f>& VertexList, const TArray<FVector3f>* NormalList);
 
 void BuildStaticMesh(UStaticMesh* StaticMesh, const Body_info& Node);
 
+//直接生成单LOD的渲染数据并初始化渲染资源,不经过FMeshDescription,可在任意线程调用
+//bEnableCollision决定Section是否参与UStaticMesh的碰撞三角形数据,开启时须保留CPU数据
+void BuildStaticMeshRenderData(UStaticMesh* StaticMesh, const TArray<FStaticMeshBuildVertex>& Vertices, const TArray<uint32>& Indices, const FBox3f& BoundingBox, bool bKeepCPUData, bool bEnableCollision);
+
+//与BuildStaticMesh(UStaticMesh*, const Body_info&)结果相同(含碰撞),但直接生成渲染数据;是否保留CPU数据取决于StaticMesh->bAllowCPUAccess
+void BuildStaticMeshRenderData(UStaticMesh* StaticMesh, const Body_info& Node);
+
 bool IsValidMaterial(float material[4]);
 
 void GetMaterial(Body_info* ParentNode, Body_info& Node, FLinearColor& Color, float& Roughness);
@@ -31,6 +83,10 @@ UMaterialInstanceDynamic* CreateMaterialInstanceDynamic(UMaterialInterface* Sour
 bool CheckNode(const Body_info& Node);
 
 void InheritMaterial(FXSPNodeData& Node, FXSPNodeData& ParentNode);
-void ResolveNodeData(FXSPNodeData& NodeData, FXSPNodeData* ParentNodeData);
+//MeshCodec为常驻网格数据的编码方式,一般传入GetMeshCodec()
+void ResolveNodeData(FXSPNodeData& NodeData, FXSPNodeData* ParentNodeData, EXSPMeshCodec MeshCodec);
+
+//影响ResolveNodeData生成结果的控制台变量的哈希,用于判定几何缓存是否有效
+uint32 GetResolveSettingsHash();
 
 bool SimplyMesh(const TArray<FVector3f>& InPositions, float PercentTriangles, float PercentVertices, TArray<FVector3f>& OutPositions, TArray<FPackedNormal>& OutNormals, TArray<uint32>& OutIndices);
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "XSPDataStruct.h"
 #include "XSPStat.h"
 #include "MeshUtils.h"
+#include "XSPMeshCodec.h"
 
 #include "MeshDescription.h"
 #include "MeshDescriptionBuilder.h"
@@ -38,11 +39,13 @@ UXSPBatchMeshComponent::~UXSPBatchMeshComponent()
 {
 }
 
-void UXSPBatchMeshComponent::Init(AXSPModelActor* InOwnerActor, const TArray<int32>& InDbidArray, bool bAsyncBuild)
+void UXSPBatchMeshComponent::Init(AXSPModelActor* InOwnerActor, const TArray<int32>& InDbidArray, bool bAsyncBuild, bool bInInstancePrimitives)
 {
     OwnerActor = InOwnerActor;
     DbidArray = InDbidArray;
+    bInstancePrimitives = bInInstancePrimitives;
     NumVerticesTotal = 0;
+    NumIndicesTotal = 0;
 
     bHasNoStreamableTextures = true;
 
@@ -114,24 +117,26 @@ UBodySetup* UXSPBatchMeshComponent::GetBodySetup()
 bool UXSPBatchMeshComponent::GetPhysicsTriMeshData(FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
 {
     CollisionData->Vertices.SetNum(NumVerticesTotal);
-    CollisionData->Indices.SetNum(NumVerticesTotal / 3);
+    CollisionData->Indices.SetNum(NumIndicesTotal / 3);
 
     const TArray<FXSPNodeData*>& NodeDataArray = OwnerActor->GetNodeDataArray();
     int32 VerticesIndex = 0, IndicesIndex = 0;
     int32 VertexBase = 0;
+    FXSPMeshScratch& Scratch = GetThreadMeshScratch();
     for (int32 Dbid : DbidArray)
     {
-        int32 NumVertices = NodeDataArray[Dbid]->MeshPositionArray.Num();
+        FXSPNodeMeshView Mesh = GetNodeMeshView(*NodeDataArray[Dbid], Scratch, bInstancePrimitives);
+        int32 NumVertices = Mesh.Positions.Num();
         for (int32 i = 0; i < NumVertices; i++)
         {
-            CollisionData->Vertices[VerticesIndex++] = FVector3f(NodeDataArray[Dbid]->MeshPositionArray[i]);
+            CollisionData->Vertices[VerticesIndex++] = Mesh.Positions[i];
         }
-        int32 NumTriangles = NumVertices / 3;
+        int32 NumTriangles = Mesh.Indices.Num() / 3;
         for (int32 j = 0; j < NumTriangles; j++)
         {
-            CollisionData->Indices[IndicesIndex].v0 = VertexBase + j * 3 + 0;
-            CollisionData->Indices[IndicesIndex].v1 = VertexBase + j * 3 + 1;
-            CollisionData->Indices[IndicesIndex].v2 = VertexBase + j * 3 + 2;
+            CollisionData->Indices[IndicesIndex].v0 = VertexBase + Mesh.Indices[j * 3 + 0];
+            CollisionData->Indices[IndicesIndex].v1 = VertexBase + Mesh.Indices[j * 3 + 1];
+            CollisionData->Indices[IndicesIndex].v2 = VertexBase + Mesh.Indices[j * 3 + 2];
             IndicesIndex++;
         }
         VertexBase += NumVertices;
@@ -146,12 +151,11 @@ bool UXSPBatchMeshComponent::GetPhysicsTriMeshData(FTriMeshCollisionData* Collis
 
 void UXSPBatchMeshComponent::BuildStaticMesh_AnyThread()
 {
-    int32 NumIndicesTotal = 0;
     const TArray<FXSPNodeData*>& NodeDataArray = OwnerActor->GetNodeDataArray();
     for (int32 Dbid : DbidArray)
     {
-        NumVerticesTotal += NodeDataArray[Dbid]->MeshPositionArray.Num();
-        NumIndicesTotal += NodeDataArray[Dbid]->MeshIndexArray.Num();
+        NumVerticesTotal += GetNodeMeshNumVertices(*NodeDataArray[Dbid], bInstancePrimitives);
+        NumIndicesTotal += GetNodeMeshNumIndices(*NodeDataArray[Dbid], bInstancePrimitives);
         EndFaceIndexArray.Add(NumIndicesTotal / 3 - 1);
     }
 
@@ -160,12 +164,6 @@ void UXSPBatchMeshComponent::BuildStaticMesh_AnyThread()
     BuildingStaticMesh->bAllowCPUAccess = !bXSPDiscardCPUDataAfterUpload;
     BuildingStaticMesh->GetStaticMaterials().Add(FStaticMaterial());
 
-    TUniquePtr<FStaticMeshRenderData> StaticMeshRenderData = MakeUnique<FStaticMeshRenderData>();
-    StaticMeshRenderData->ScreenSize[0].Default = 1.0f;
-    StaticMeshRenderData->AllocateLODResources(1);
-
-    FStaticMeshLODResources& StaticMeshLODResources = StaticMeshRenderData->LODResources[0];
-
     TArray<FStaticMeshBuildVertex> StaticMeshBuildVertices;
     StaticMeshBuildVertices.SetNum(NumVerticesTotal);
     TArray<uint32> IndexArray;
@@ -174,47 +172,28 @@ void UXSPBatchMeshComponent::BuildStaticMesh_AnyThread()
     BoundingBox.Init();
     int32 VertexIndex = 0;
     int32 IndexIndex = 0;
+    FXSPMeshScratch& Scratch = GetThreadMeshScratch();
     for (int32 Dbid : DbidArray)
     {
         int32 VertexOffset = VertexIndex;
-        int32 NumVertices = NodeDataArray[Dbid]->MeshPositionArray.Num();
+        FXSPNodeMeshView Mesh = GetNodeMeshView(*NodeDataArray[Dbid], Scratch, bInstancePrimitives);
+        int32 NumVertices = Mesh.Positions.Num();
         for (int32 i = 0; i < NumVertices; i++)
         {
-            BoundingBox += NodeDataArray[Dbid]->MeshPositionArray[i];
-            StaticMeshBuildVertices[VertexIndex].Position = NodeDataArray[Dbid]->MeshPositionArray[i];
-            StaticMeshBuildVertices[VertexIndex].TangentZ = NodeDataArray[Dbid]->MeshNormalArray[i].ToFVector3f();
+            BoundingBox += Mesh.Positions[i];
+            StaticMeshBuildVertices[VertexIndex].Position = Mesh.Positions[i];
+            StaticMeshBuildVertices[VertexIndex].TangentZ = Mesh.Normals[i].ToFVector3f();
             StaticMeshBuildVertices[VertexIndex].UVs[0].Set(0, 0);
             VertexIndex++;
         }
-        int32 NumIndices = NodeDataArray[Dbid]->MeshIndexArray.Num();
+        int32 NumIndices = Mesh.Indices.Num();
         for (int32 i = 0; i < NumIndices; i++)
         {
-            IndexArray[IndexIndex] = NodeDataArray[Dbid]->MeshIndexArray[i] + VertexOffset;
+            IndexArray[IndexIndex] = Mesh.Indices[i] + VertexOffset;
             IndexIndex++;
         }
     }
-    StaticMeshLODResources.VertexBuffers.PositionVertexBuffer.Init(StaticMeshBuildVertices, !bXSPDiscardCPUDataAfterUpload);
-    StaticMeshLODResources.VertexBuffers.StaticMeshVertexBuffer.Init(StaticMeshBuildVertices, 1, !bXSPDiscardCPUDataAfterUpload);
-    StaticMeshLODResources.IndexBuffer.SetIndices(IndexArray, (IndexArray.Num() <= (int32)MAX_uint16 + 1) ? EIndexBufferStride::Type::Force16Bit : EIndexBufferStride::Type::Force32Bit);
-    StaticMeshLODResources.bHasDepthOnlyIndices = false;
-    StaticMeshLODResources.bHasReversedIndices = false;
-    StaticMeshLODResources.bHasReversedDepthOnlyIndices = false;
-
-    FStaticMeshSection& Section = StaticMeshLODResources.Sections.AddDefaulted_GetRef();
-    Section.bEnableCollision = false;
-    Section.NumTriangles = NumVerticesTotal / 3;
-    Section.FirstIndex = 0;
-    Section.MinVertexIndex = 0;
-    Section.MaxVertexIndex = NumVerticesTotal - 1;
-    Section.MaterialIndex = 0;
-    Section.bForceOpaque = false;
-
-    StaticMeshRenderData->Bounds = FBoxSphereBounds(FBox(BoundingBox));
-
-    BuildingStaticMesh->SetRenderData(MoveTemp(StaticMeshRenderData));
-    BuildingStaticMesh->InitResources();
-
-    BuildingStaticMesh->CalculateExtendedBounds();
+    BuildStaticMeshRenderData(BuildingStaticMesh, StaticMeshBuildVertices, IndexArray, BoundingBox, !bXSPDiscardCPUDataAfterUpload, false);
 }
 
 void UXSPBatchMeshComponent::BuildPhysicsData(bool bAsync)
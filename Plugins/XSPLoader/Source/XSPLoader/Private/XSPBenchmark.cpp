@@ -0,0 +1,715 @@
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "XSPFileUtils.h"
+#include "XSPMappedFile.h"
+#include "XSPDataStruct.h"
+#include "XSPMeshCodec.h"
+#include "MeshUtils.h"
+#include "Containers/Queue.h"
+#include "HAL/Thread.h"
+#include "Engine/StaticMesh.h"
+#include "UObject/Package.h"
+#include "XSPHeaderIndex.h"
+#include "XSPPrefetch.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPBenchmark, Log, All);
+
+/**
+性能测试命令,在控制台中执行,结果输出到日志:
+xsp.Benchmark.FileReader <文件路径> [重复次数]		--比较std::fstream与内存映射两种方式读取同一文件的耗时
+xsp.Benchmark.MeshCodec <文件路径>					--统计网格编码的压缩率、最大误差与编解码耗时
+xsp.Benchmark.RequestQueue [生产者线程数] [每线程请求数]	--比较加锁数组与无锁MPSC队列在多生产者竞争下的吞吐量
+xsp.Benchmark.BuildStaticMesh <文件路径> [节点数]		--比较FMeshDescription构建与直接生成渲染数据两种方式每秒构建的网格体数
+xsp.Benchmark.PrefetchReplay <轨迹文件> <文件路径...>	--回放xsp.LoaderTrace录制的视点轨迹,比较开启预取前后新请求节点的数据命中率
+xsp.Benchmark.RawMeshDecode [三角形数] [重复次数]		--比较网格体解码的标量实现与向量化实现的吞吐量,并校验两者结果一致
+*/
+
+namespace
+{
+    struct FFileReaderBenchmarkResult
+    {
+        double Seconds = 0;
+        int32 NumNodes = 0;
+        int32 NumPrimitives = 0;
+        int64 NumFloats = 0;
+    };
+
+    void AccumulateNodeData(const FXSPNodeData& NodeData, FFileReaderBenchmarkResult& Result)
+    {
+        Result.NumPrimitives += NodeData.PrimitiveArray.Num();
+        for (const FXSPPrimitiveData& PrimitiveData : NodeData.PrimitiveArray)
+        {
+            Result.NumFloats += PrimitiveData.MeshVertexBufferLength + PrimitiveData.PrimitiveParamsBufferLength;
+        }
+    }
+
+    //与旧版FXSPFileReader相同的读取方式: 逐字段read + seekg
+    bool BenchmarkStreamReader(const FString& FilePathName, FFileReaderBenchmarkResult& Result)
+    {
+        double BeginSeconds = FPlatformTime::Seconds();
+
+        std::fstream FileStream;
+        FileStream.open(std::wstring(*FilePathName), std::ios::in | std::ios::binary);
+        if (!FileStream.is_open())
+            return false;
+
+        int NumNodes = 0;
+        FileStream.read((char*)&NumNodes, sizeof(NumNodes));
+        short headlength;
+        FileStream.read((char*)&headlength, sizeof(headlength));
+        TArray<Header_info> HeaderList;
+        ReadHeaderInfo(FileStream, NumNodes, HeaderList);
+
+        for (int32 j = 0; j < NumNodes; j++)
+        {
+            FXSPNodeData NodeData;
+            NodeData.Dbid = j;
+            ReadNodeData(FileStream, HeaderList[j], NodeData);
+            AccumulateNodeData(NodeData, Result);
+        }
+        FileStream.close();
+
+        Result.NumNodes = NumNodes;
+        Result.Seconds = FPlatformTime::Seconds() - BeginSeconds;
+        return true;
+    }
+
+    //内存映射读取: 头信息直接从映射内存解码
+    bool BenchmarkMappedReader(const FString& FilePathName, FFileReaderBenchmarkResult& Result)
+    {
+        double BeginSeconds = FPlatformTime::Seconds();
+
+        FXSPMappedFile SourceFile;
+        if (!SourceFile.Open(FilePathName))
+            return false;
+
+        int32 NumNodes = ReadNumNodes(SourceFile);
+        for (int32 j = 0; j < NumNodes; j++)
+        {
+            FXSPNodeData NodeData;
+            NodeData.Dbid = j;
+            Header_info Header;
+            if (ReadHeaderInfo(SourceFile, XSPFileHeaderSize + j * XSPHeaderInfoSize, Header))
+            {
+                ReadNodeData(SourceFile, Header, NodeData);
+            }
+            AccumulateNodeData(NodeData, Result);
+        }
+        SourceFile.Close();
+
+        Result.NumNodes = NumNodes;
+        Result.Seconds = FPlatformTime::Seconds() - BeginSeconds;
+        return true;
+    }
+
+    void BenchmarkFileReader(const TArray<FString>& Args)
+    {
+        if (Args.Num() < 1)
+        {
+            UE_LOG(LogXSPBenchmark, Display, TEXT("用法: xsp.Benchmark.FileReader <文件路径> [重复次数]"));
+            return;
+        }
+
+        const FString& FilePathName = Args[0];
+        int32 NumRepeats = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 3;
+
+        //交替执行,取各自最短耗时,以减少系统文件缓存带来的先后差异
+        double BestStreamSeconds = DBL_MAX, BestMappedSeconds = DBL_MAX;
+        FFileReaderBenchmarkResult StreamResult, MappedResult;
+        for (int32 i = 0; i < NumRepeats; i++)
+        {
+            StreamResult = FFileReaderBenchmarkResult();
+            if (!BenchmarkStreamReader(FilePathName, StreamResult))
+            {
+                UE_LOG(LogXSPBenchmark, Error, TEXT("无法打开文件: %s"), *FilePathName);
+                return;
+            }
+            BestStreamSeconds = FMath::Min(BestStreamSeconds, StreamResult.Seconds);
+
+            MappedResult = FFileReaderBenchmarkResult();
+            if (!BenchmarkMappedReader(FilePathName, MappedResult))
+            {
+                UE_LOG(LogXSPBenchmark, Error, TEXT("无法映射文件: %s"), *FilePathName);
+                return;
+            }
+            BestMappedSeconds = FMath::Min(BestMappedSeconds, MappedResult.Seconds);
+        }
+
+        if (StreamResult.NumPrimitives != MappedResult.NumPrimitives || StreamResult.NumFloats != MappedResult.NumFloats)
+        {
+            UE_LOG(LogXSPBenchmark, Warning, TEXT("两种方式读取结果不一致: Primitive %d/%d, Float %lld/%lld"),
+                StreamResult.NumPrimitives, MappedResult.NumPrimitives, StreamResult.NumFloats, MappedResult.NumFloats);
+        }
+
+        double MegaBytes = MappedResult.NumFloats * sizeof(float) / (1024.0 * 1024.0);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("FileReader: %s, 节点数 %d, 几何体数 %d, 几何数据 %.1fMB, 重复 %d 次"),
+            *FilePathName, MappedResult.NumNodes, MappedResult.NumPrimitives, MegaBytes, NumRepeats);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  std::fstream: %.3f 秒 (%.1f MB/s)"), BestStreamSeconds, MegaBytes / FMath::Max(BestStreamSeconds, 1e-6));
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  内存映射:     %.3f 秒 (%.1f MB/s), 加速比 %.2fx"), BestMappedSeconds, MegaBytes / FMath::Max(BestMappedSeconds, 1e-6),
+            BestStreamSeconds / FMath::Max(BestMappedSeconds, 1e-6));
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkFileReaderCommand(
+    TEXT("xsp.Benchmark.FileReader"),
+    TEXT("比较std::fstream与内存映射两种方式读取同一XSP文件的耗时, 参数: 文件路径 [重复次数]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFileReader)
+);
+
+namespace
+{
+    void BenchmarkMeshCodec(const TArray<FString>& Args)
+    {
+        if (Args.Num() < 1)
+        {
+            UE_LOG(LogXSPBenchmark, Display, TEXT("用法: xsp.Benchmark.MeshCodec <文件路径>"));
+            return;
+        }
+
+        const FString& FilePathName = Args[0];
+        FXSPMappedFile SourceFile;
+        if (!SourceFile.Open(FilePathName))
+        {
+            UE_LOG(LogXSPBenchmark, Error, TEXT("无法映射文件: %s"), *FilePathName);
+            return;
+        }
+
+        //生成未编码的网格数据作为基准(显式指定不编码,不修改xsp.MeshCodec以免影响同时进行的加载)
+
+        TArray<FXSPNodeData> NodeDataArray;
+        int32 NumNodes = ReadNumNodes(SourceFile);
+        NodeDataArray.SetNum(NumNodes);
+        for (int32 j = 0; j < NumNodes; j++)
+        {
+            FXSPNodeData& NodeData = NodeDataArray[j];
+            NodeData.Dbid = j;
+            Header_info Header;
+            if (ReadHeaderInfo(SourceFile, XSPFileHeaderSize + j * XSPHeaderInfoSize, Header) &&
+                ReadNodeData(SourceFile, Header, NodeData) &&
+                NodeData.PrimitiveArray.Num() > 0)
+            {
+                ResolveNodeData(NodeData, nullptr, EXSPMeshCodec::Raw);
+            }
+            NodeData.PrimitiveArray.Empty();
+        }
+        SourceFile.Close();
+
+        int64 NumVertices = 0, NumIndices = 0, RawBytes = 0, EncodedBytes = 0;
+        int32 NumMeshes = 0, NumRejected = 0;
+        float MaxPositionError = 0.0f, MaxNormalError = 0.0f;
+        double EncodeSeconds = 0, DecodeSeconds = 0;
+        FXSPMeshScratch Scratch;
+        for (const FXSPNodeData& NodeData : NodeDataArray)
+        {
+            if (NodeData.MeshPositionArray.IsEmpty())
+                continue;
+
+            NumMeshes++;
+            NumVertices += NodeData.MeshPositionArray.Num();
+            NumIndices += NodeData.MeshIndexArray.Num();
+            int64 NodeRawBytes = NodeData.MeshPositionArray.Num() * (sizeof(FVector3f) + sizeof(FPackedNormal)) + NodeData.MeshIndexArray.Num() * sizeof(uint32);
+            RawBytes += NodeRawBytes;
+
+            FXSPEncodedMesh EncodedMesh;
+            double BeginSeconds = FPlatformTime::Seconds();
+            bool bEncoded = EncodeMesh(NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, GetMeshCodecMaxError(), EncodedMesh);
+            EncodeSeconds += FPlatformTime::Seconds() - BeginSeconds;
+            if (!bEncoded)
+            {
+                NumRejected++;
+                EncodedBytes += NodeRawBytes;
+                continue;
+            }
+            EncodedBytes += EncodedMesh.Positions.Num() * sizeof(uint16) + EncodedMesh.Normals.Num() * sizeof(uint16) + EncodedMesh.Indices.Num();
+
+            BeginSeconds = FPlatformTime::Seconds();
+            DecodeMesh(EncodedMesh, Scratch.Positions, Scratch.Normals, Scratch.Indices);
+            DecodeSeconds += FPlatformTime::Seconds() - BeginSeconds;
+
+            for (int32 i = 0; i < NodeData.MeshPositionArray.Num(); i++)
+            {
+                MaxPositionError = FMath::Max(MaxPositionError, FVector3f::Distance(NodeData.MeshPositionArray[i], Scratch.Positions[i]));
+                MaxNormalError = FMath::Max(MaxNormalError, FVector3f::Distance(NodeData.MeshNormalArray[i].ToFVector3f(), Scratch.Normals[i].ToFVector3f()));
+            }
+            if (Scratch.Indices != NodeData.MeshIndexArray)
+            {
+                UE_LOG(LogXSPBenchmark, Error, TEXT("索引解码结果不一致: %d"), NodeData.Dbid);
+            }
+        }
+
+        double RawMegaBytes = RawBytes / (1024.0 * 1024.0);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("MeshCodec: %s, 网格体数 %d, 顶点数 %lld, 索引数 %lld, 误差上限 %.3f 厘米"),
+            *FilePathName, NumMeshes, NumVertices, NumIndices, GetMeshCodecMaxError());
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  大小: %.1fMB -> %.1fMB (%.1f%%), 超出误差未编码 %d"),
+            RawMegaBytes, EncodedBytes / (1024.0 * 1024.0), 100.0 * EncodedBytes / FMath::Max<int64>(RawBytes, 1), NumRejected);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  最大误差: 位置 %.4f 厘米, 法线 %.4f"), MaxPositionError, MaxNormalError);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  编码: %.3f 秒 (%.1f MB/s), 解码: %.3f 秒 (%.1f MB/s)"),
+            EncodeSeconds, RawMegaBytes / FMath::Max(EncodeSeconds, 1e-6), DecodeSeconds, RawMegaBytes / FMath::Max(DecodeSeconds, 1e-6));
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkMeshCodecCommand(
+    TEXT("xsp.Benchmark.MeshCodec"),
+    TEXT("统计XSP文件网格数据编码的压缩率、最大误差与编解码耗时, 参数: 文件路径"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkMeshCodec)
+);
+
+namespace
+{
+    //旧版CachedRequestArray的方式: 生产者加锁追加,消费者加锁整体取走
+    struct FLockedArrayQueue
+    {
+        TArray<void*> Items;
+        FCriticalSection ItemsCS;
+
+        void Push(void* Item)
+        {
+            FScopeLock Lock(&ItemsCS);
+            Items.Emplace(Item);
+        }
+
+        int32 Drain()
+        {
+            TArray<void*> DrainedItems;
+            {
+                FScopeLock Lock(&ItemsCS);
+                DrainedItems = MoveTemp(Items);
+            }
+            return DrainedItems.Num();
+        }
+    };
+
+    struct FMpscQueue
+    {
+        TQueue<void*, EQueueMode::Mpsc> Items;
+
+        void Push(void* Item)
+        {
+            Items.Enqueue(Item);
+        }
+
+        int32 Drain()
+        {
+            int32 NumItems = 0;
+            void* Item = nullptr;
+            while (Items.Dequeue(Item))
+            {
+                NumItems++;
+            }
+            return NumItems;
+        }
+    };
+
+    //全部生产者同时开始投递,消费者在调用线程上持续取出,直到取完全部请求
+    template<typename QueueType>
+    double RunRequestQueueBenchmark(int32 NumProducers, int32 NumItemsPerProducer)
+    {
+        QueueType Queue;
+        std::atomic<bool> bStart = false;
+        TArray<TUniquePtr<FThread>> Producers;
+        for (int32 i = 0; i < NumProducers; i++)
+        {
+            Producers.Emplace(MakeUnique<FThread>(*FString::Printf(TEXT("XSPBenchmarkProducer_%d"), i), [&Queue, &bStart, NumItemsPerProducer]() {
+                while (!bStart.load())
+                {
+                    FPlatformProcess::Yield();
+                }
+                for (int32 j = 0; j < NumItemsPerProducer; j++)
+                {
+                    Queue.Push((void*)(UPTRINT)(j + 1));
+                }
+            }));
+        }
+
+        int64 NumItemsTotal = (int64)NumProducers * NumItemsPerProducer;
+        int64 NumItemsDrained = 0;
+        double BeginSeconds = FPlatformTime::Seconds();
+        bStart.store(true);
+        while (NumItemsDrained < NumItemsTotal)
+        {
+            NumItemsDrained += Queue.Drain();
+        }
+        double Seconds = FPlatformTime::Seconds() - BeginSeconds;
+
+        for (TUniquePtr<FThread>& Producer : Producers)
+        {
+            Producer->Join();
+        }
+        return Seconds;
+    }
+
+    void BenchmarkRequestQueue(const TArray<FString>& Args)
+    {
+        int32 NumProducers = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 16;
+        int32 NumItemsPerProducer = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 100000;
+        double NumItemsTotal = (double)NumProducers * NumItemsPerProducer;
+
+        double LockedSeconds = RunRequestQueueBenchmark<FLockedArrayQueue>(NumProducers, NumItemsPerProducer);
+        double MpscSeconds = RunRequestQueueBenchmark<FMpscQueue>(NumProducers, NumItemsPerProducer);
+
+        UE_LOG(LogXSPBenchmark, Display, TEXT("RequestQueue: 生产者线程 %d, 每线程请求 %d"), NumProducers, NumItemsPerProducer);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  加锁数组: %.3f 秒 (%.2f M/s)"), LockedSeconds, NumItemsTotal / FMath::Max(LockedSeconds, 1e-6) / 1e6);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  MPSC队列: %.3f 秒 (%.2f M/s), 加速比 %.2fx"), MpscSeconds, NumItemsTotal / FMath::Max(MpscSeconds, 1e-6) / 1e6,
+            LockedSeconds / FMath::Max(MpscSeconds, 1e-6));
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkRequestQueueCommand(
+    TEXT("xsp.Benchmark.RequestQueue"),
+    TEXT("比较加锁数组与无锁MPSC队列在多生产者竞争下的吞吐量, 参数: [生产者线程数] [每线程请求数]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRequestQueue)
+);
+
+namespace
+{
+    //依次构建全部节点,返回耗时;OutNumWithoutCollision为没有碰撞三角形数据的网格体数(不计入耗时)
+    double RunBuildStaticMeshBenchmark(const TArray<Body_info>& Nodes, bool bDirect, int32& OutNumWithoutCollision)
+    {
+        TArray<UStaticMesh*> StaticMeshes;
+        StaticMeshes.Reserve(Nodes.Num());
+        double BeginSeconds = FPlatformTime::Seconds();
+        for (const Body_info& Node : Nodes)
+        {
+            UStaticMesh* StaticMesh = NewObject<UStaticMesh>(GetTransientPackage(), NAME_None, RF_Transient);
+            StaticMesh->bAllowCPUAccess = true;
+            if (bDirect)
+                BuildStaticMeshRenderData(StaticMesh, Node);
+            else
+                BuildStaticMesh(StaticMesh, Node);
+            StaticMeshes.Add(StaticMesh);
+        }
+        double Seconds = FPlatformTime::Seconds() - BeginSeconds;
+
+        //加载器以CTF_UseComplexAsSimple创建碰撞,依赖网格体的碰撞三角形数据
+        OutNumWithoutCollision = 0;
+        for (UStaticMesh* StaticMesh : StaticMeshes)
+        {
+            if (!StaticMesh->ContainsPhysicsTriMeshData(false))
+                OutNumWithoutCollision++;
+        }
+        return Seconds;
+    }
+
+    void BenchmarkBuildStaticMesh(const TArray<FString>& Args)
+    {
+        if (Args.Num() < 1)
+        {
+            UE_LOG(LogXSPBenchmark, Display, TEXT("用法: xsp.Benchmark.BuildStaticMesh <文件路径> [节点数]"));
+            return;
+        }
+
+        const FString& FilePathName = Args[0];
+        int32 MaxNumNodes = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 500;
+
+        FXSPMappedFile SourceFile;
+        if (!SourceFile.Open(FilePathName))
+        {
+            UE_LOG(LogXSPBenchmark, Error, TEXT("无法映射文件: %s"), *FilePathName);
+            return;
+        }
+
+        //读取前MaxNumNodes个有网格体的节点,与FXSPLoader的读取方式相同
+        TArray<Body_info> Nodes;
+        int64 NumVertices = 0;
+        int32 NumNodes = ReadNumNodes(SourceFile);
+        for (int32 j = 0; j < NumNodes && Nodes.Num() < MaxNumNodes; j++)
+        {
+            Header_info Header;
+            Body_info Node;
+            if (ReadHeaderInfo(SourceFile, XSPFileHeaderSize + j * XSPHeaderInfoSize, Header) &&
+                ReadBodyInfo(SourceFile, Header, false, Node) &&
+                CheckNode(Node))
+            {
+                TArray<FVector3f> VertexList;
+                AppendNodeMesh(Node, VertexList, nullptr);
+                NumVertices += VertexList.Num();
+                Nodes.Emplace(MoveTemp(Node));
+            }
+        }
+        SourceFile.Close();
+
+        if (Nodes.IsEmpty())
+        {
+            UE_LOG(LogXSPBenchmark, Warning, TEXT("文件中没有网格体: %s"), *FilePathName);
+            return;
+        }
+
+        int32 MeshDescriptionNumWithoutCollision = 0, DirectNumWithoutCollision = 0;
+        double MeshDescriptionSeconds = RunBuildStaticMeshBenchmark(Nodes, false, MeshDescriptionNumWithoutCollision);
+        double DirectSeconds = RunBuildStaticMeshBenchmark(Nodes, true, DirectNumWithoutCollision);
+        CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+        UE_LOG(LogXSPBenchmark, Display, TEXT("BuildStaticMesh: %s, 网格体数 %d, 顶点数 %lld"), *FilePathName, Nodes.Num(), NumVertices);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  FMeshDescription: %.3f 秒 (%.1f 个/秒)"), MeshDescriptionSeconds, Nodes.Num() / FMath::Max(MeshDescriptionSeconds, 1e-6));
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  直接生成渲染数据: %.3f 秒 (%.1f 个/秒), 加速比 %.2fx"), DirectSeconds, Nodes.Num() / FMath::Max(DirectSeconds, 1e-6),
+            MeshDescriptionSeconds / FMath::Max(DirectSeconds, 1e-6));
+        if (MeshDescriptionNumWithoutCollision > 0 || DirectNumWithoutCollision > 0)
+        {
+            UE_LOG(LogXSPBenchmark, Error, TEXT("  缺少碰撞数据的网格体: FMeshDescription %d 个, 直接生成渲染数据 %d 个"), MeshDescriptionNumWithoutCollision, DirectNumWithoutCollision);
+        }
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkBuildStaticMeshCommand(
+    TEXT("xsp.Benchmark.BuildStaticMesh"),
+    TEXT("比较FMeshDescription构建与直接生成渲染数据两种方式每秒构建的网格体数, 参数: 文件路径 [节点数]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkBuildStaticMesh)
+);
+
+namespace
+{
+    struct FPrefetchReplayResult
+    {
+        int32 NumNewRequests = 0;
+        int32 NumHits = 0;
+        int32 NumPrefetched = 0;
+        int32 NumPrefetchUsed = 0;
+    };
+
+    /**
+     *	按轨迹逐帧模拟加载器的数据读取:请求的节点在当帧读入,开启预取时再按预测视锥读入节点
+     *	上一帧未请求、本帧新请求的节点若此前已读入则记为命中
+     */
+    FPrefetchReplayResult RunPrefetchReplay(const TArray<FXSPLoaderTraceFrame>& Frames, const TArray<TUniquePtr<FXSPHeaderIndex>>& HeaderIndices, const TArray<int32>& StartDbids, bool bPrefetch)
+    {
+        IConsoleManager& ConsoleManager = IConsoleManager::Get();
+        float PrefetchSeconds = ConsoleManager.FindConsoleVariable(TEXT("xsp.LoaderPrefetchSeconds"))->GetFloat();
+        int32 MaxPrefetchPerTick = FMath::Max(ConsoleManager.FindConsoleVariable(TEXT("xsp.LoaderMaxPrefetchPerTick"))->GetInt(), 1);
+        float MinScreenSize = ConsoleManager.FindConsoleVariable(TEXT("xsp.LoaderPrefetchMinScreenSize"))->GetFloat();
+
+        FPrefetchReplayResult Result;
+        FXSPCameraPredictor CameraPredictor;
+        TSet<int32> FetchedDbidSet;
+        TSet<int32> PrefetchedDbidSet;
+        TSet<int32> LastRequestedDbidSet;
+        TSet<int32> RequestedDbidSet;
+        TArray<FXSPViewState> PredictedViewStates;
+        TArray<FXSPPrefetchCandidate> Candidates;
+        for (const FXSPLoaderTraceFrame& Frame : Frames)
+        {
+            RequestedDbidSet.Reset();
+            for (int32 Dbid : Frame.RequestedDbids)
+            {
+                RequestedDbidSet.Add(Dbid);
+                if (LastRequestedDbidSet.Contains(Dbid))
+                    continue;
+
+                Result.NumNewRequests++;
+                if (FetchedDbidSet.Contains(Dbid))
+                    Result.NumHits++;
+                if (PrefetchedDbidSet.Remove(Dbid) > 0)
+                    Result.NumPrefetchUsed++;
+            }
+            FetchedDbidSet.Append(RequestedDbidSet);
+            Swap(LastRequestedDbidSet, RequestedDbidSet);
+
+            if (!bPrefetch || Frame.Views.IsEmpty())
+                continue;
+
+            CameraPredictor.Update(Frame.Views[0].Origin, Frame.Seconds);
+            if (!CameraPredictor.Predict(Frame.Views, PrefetchSeconds, PredictedViewStates))
+                continue;
+
+            Candidates.Reset();
+            for (int32 i = 0; i < HeaderIndices.Num(); i++)
+            {
+                SelectPrefetchNodes(*HeaderIndices[i], StartDbids[i], PredictedViewStates, MinScreenSize, MaxPrefetchPerTick * 4, Candidates);
+            }
+            Candidates.Sort([](const FXSPPrefetchCandidate& Lhs, const FXSPPrefetchCandidate& Rhs) { return Lhs.ScreenSize > Rhs.ScreenSize; });
+
+            int32 NumPrefetched = 0;
+            for (const FXSPPrefetchCandidate& Candidate : Candidates)
+            {
+                if (NumPrefetched >= MaxPrefetchPerTick)
+                    break;
+                if (FetchedDbidSet.Contains(Candidate.Dbid))
+                    continue;
+                FetchedDbidSet.Add(Candidate.Dbid);
+                PrefetchedDbidSet.Add(Candidate.Dbid);
+                NumPrefetched++;
+            }
+            Result.NumPrefetched += NumPrefetched;
+        }
+        return Result;
+    }
+
+    void BenchmarkPrefetchReplay(const TArray<FString>& Args)
+    {
+        if (Args.Num() < 2)
+        {
+            UE_LOG(LogXSPBenchmark, Display, TEXT("用法: xsp.Benchmark.PrefetchReplay <轨迹文件> <文件路径...>"));
+            return;
+        }
+
+        TArray<FXSPLoaderTraceFrame> Frames;
+        if (!ReadTrace(Args[0], Frames) || Frames.IsEmpty())
+        {
+            UE_LOG(LogXSPBenchmark, Warning, TEXT("无法读取视点轨迹: %s"), *Args[0]);
+            return;
+        }
+
+        //数据源按dbid顺序排列,与FXSPLoader::Init一致
+        TArray<TUniquePtr<FXSPHeaderIndex>> HeaderIndices;
+        TArray<int32> StartDbids;
+        int32 StartDbid = 0;
+        for (int32 i = 1; i < Args.Num(); i++)
+        {
+            TUniquePtr<FXSPHeaderIndex> HeaderIndex = MakeUnique<FXSPHeaderIndex>();
+            if (!HeaderIndex->Open(Args[i]))
+            {
+                UE_LOG(LogXSPBenchmark, Warning, TEXT("无法打开头信息索引: %s"), *Args[i]);
+                return;
+            }
+            StartDbids.Add(StartDbid);
+            StartDbid += HeaderIndex->Num();
+            HeaderIndices.Add(MoveTemp(HeaderIndex));
+        }
+
+        FPrefetchReplayResult Baseline = RunPrefetchReplay(Frames, HeaderIndices, StartDbids, false);
+        FPrefetchReplayResult Prefetch = RunPrefetchReplay(Frames, HeaderIndices, StartDbids, true);
+
+        auto HitRate = [](const FPrefetchReplayResult& Result) { return 100.0 * Result.NumHits / FMath::Max(Result.NumNewRequests, 1); };
+        UE_LOG(LogXSPBenchmark, Display, TEXT("PrefetchReplay: %s, 帧数 %d, 节点数 %d, 新请求数 %d"), *Args[0], Frames.Num(), StartDbid, Baseline.NumNewRequests);
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  不预取: 命中率 %.1f%%"), HitRate(Baseline));
+        UE_LOG(LogXSPBenchmark, Display, TEXT("  预取:   命中率 %.1f%%, 预取节点数 %d, 其中被请求 %d (%.1f%%)"), HitRate(Prefetch), Prefetch.NumPrefetched, Prefetch.NumPrefetchUsed,
+            100.0 * Prefetch.NumPrefetchUsed / FMath::Max(Prefetch.NumPrefetched, 1));
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkPrefetchReplayCommand(
+    TEXT("xsp.Benchmark.PrefetchReplay"),
+    TEXT("回放视点轨迹,比较开启预取前后新请求节点的数据命中率, 参数: 轨迹文件 文件路径..."),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPrefetchReplay)
+);
+
+namespace
+{
+    //模拟的三角形数组(源坐标系,单位米)
+    struct FRawMeshSoup
+    {
+        const TCHAR* Name;
+        TArray<float> Vertices;
+        TArray<float> Normals;
+    };
+
+    void AddSoupTriangle(TArray<float>& Vertices, TArray<float>& Normals, const FVector3f& A, const FVector3f& B, const FVector3f& C)
+    {
+        for (const FVector3f& P : { A, B, C })
+        {
+            Vertices.Append({ P.X, P.Y, P.Z });
+        }
+        FVector3f TriNormal = ((B - C) ^ (A - C)).GetSafeNormal();
+        for (int32 i = 0; i < 3; i++)
+        {
+            Normals.Append({ TriNormal.X, TriNormal.Y, TriNormal.Z });
+        }
+    }
+
+    //网格曲面(管道等模型的典型数据)、随机三角形、含约5%退化三角形的曲面
+    void MakeRawMeshSoups(int32 NumTriangles, TArray<FRawMeshSoup>& OutSoups)
+    {
+        FRandomStream Random(0x585350);
+        int32 NumColumns = 64;
+        OutSoups.Reserve(OutSoups.Num() + 3);
+
+        FRawMeshSoup& Surface = OutSoups.Add_GetRef({ TEXT("曲面") });
+        FRawMeshSoup& Degenerate = OutSoups.Add_GetRef({ TEXT("曲面(含退化)") });
+        for (int32 i = 0; Surface.Vertices.Num() < NumTriangles * 9; i++)
+        {
+            int32 Row = i / NumColumns, Column = i % NumColumns;
+            auto GetPoint = [NumColumns](int32 InRow, int32 InColumn) {
+                float Angle = 2.f * PI * InColumn / NumColumns;
+                return FVector3f(FMath::Cos(Angle) * 0.5f, FMath::Sin(Angle) * 0.5f, InRow * 0.1f) + FVector3f(1000.f, 2000.f, 10.f);
+            };
+            FVector3f A = GetPoint(Row, Column), B = GetPoint(Row, Column + 1), C = GetPoint(Row + 1, Column);
+            AddSoupTriangle(Surface.Vertices, Surface.Normals, A, B, C);
+            AddSoupTriangle(Degenerate.Vertices, Degenerate.Normals, A, Random.FRand() < 0.05f ? A : B, C);
+        }
+
+        FRawMeshSoup& RandomSoup = OutSoups.Add_GetRef({ TEXT("随机") });
+        for (int32 i = 0; i < NumTriangles; i++)
+        {
+            FVector3f Center(Random.FRandRange(-500.f, 500.f), Random.FRandRange(-500.f, 500.f), Random.FRandRange(0.f, 50.f));
+            AddSoupTriangle(RandomSoup.Vertices, RandomSoup.Normals, Center + FVector3f(Random.VRand()), Center + FVector3f(Random.VRand()), Center + FVector3f(Random.VRand()));
+        }
+    }
+
+    struct FRawMeshDecodeOutput
+    {
+        TArray<FVector3f> Positions;
+        TArray<FPackedNormal> Normals;
+        TArray<uint32> Indices;
+        FBox3f BoundingBox;
+        int32 NumTriangles = 0;
+    };
+
+    typedef int32(*FRawMeshDecodeFunction)(const float*, const float*, int32, bool, uint32, FVector3f*, FPackedNormal*, uint32*, FBox3f&);
+
+    //重复解码到预留好的输出中,返回耗时
+    double RunRawMeshDecodeBenchmark(FRawMeshDecodeFunction DecodeFunction, const FRawMeshSoup& Soup, bool bWithNormals, int32 NumRepeats, FRawMeshDecodeOutput& Output)
+    {
+        int32 NumTriangles = Soup.Vertices.Num() / 9;
+        Output.Positions.SetNumUninitialized(NumTriangles * 3);
+        Output.Normals.SetNumUninitialized(NumTriangles * 3);
+        Output.Indices.SetNumUninitialized(NumTriangles * 3);
+
+        double BeginSeconds = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumRepeats; i++)
+        {
+            Output.BoundingBox.Init();
+            Output.NumTriangles = DecodeFunction(Soup.Vertices.GetData(), bWithNormals ? Soup.Normals.GetData() : nullptr, NumTriangles, true, 0,
+                Output.Positions.GetData(), Output.Normals.GetData(), Output.Indices.GetData(), Output.BoundingBox);
+        }
+        return FPlatformTime::Seconds() - BeginSeconds;
+    }
+
+    //位置、索引与包围盒应完全相同,法线允许量化后相差1
+    bool IsRawMeshDecodeOutputEqual(const FRawMeshDecodeOutput& A, const FRawMeshDecodeOutput& B)
+    {
+        if (A.NumTriangles != B.NumTriangles || !A.BoundingBox.Equals(B.BoundingBox, 0.f))
+            return false;
+
+        for (int32 i = 0; i < A.NumTriangles * 3; i++)
+        {
+            if (A.Positions[i] != B.Positions[i] || A.Indices[i] != B.Indices[i])
+                return false;
+            const FPackedNormal& NormalA = A.Normals[i];
+            const FPackedNormal& NormalB = B.Normals[i];
+            if (FMath::Abs(NormalA.Vector.X - NormalB.Vector.X) > 1 || FMath::Abs(NormalA.Vector.Y - NormalB.Vector.Y) > 1 || FMath::Abs(NormalA.Vector.Z - NormalB.Vector.Z) > 1)
+                return false;
+        }
+        return true;
+    }
+
+    void BenchmarkRawMeshDecode(const TArray<FString>& Args)
+    {
+        int32 NumTriangles = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100000;
+        int32 NumRepeats = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 20;
+
+        TArray<FRawMeshSoup> Soups;
+        MakeRawMeshSoups(NumTriangles, Soups);
+
+        UE_LOG(LogXSPBenchmark, Display, TEXT("RawMeshDecode: 三角形 %d, 重复 %d 次"), NumTriangles, NumRepeats);
+        double NumTrianglesTotal = (double)NumTriangles * NumRepeats;
+        for (const FRawMeshSoup& Soup : Soups)
+        {
+            for (bool bWithNormals : { true, false })
+            {
+                FRawMeshDecodeOutput ScalarOutput, VectorOutput;
+                double ScalarSeconds = RunRawMeshDecodeBenchmark(&DecodeRawMeshTrianglesScalar, Soup, bWithNormals, NumRepeats, ScalarOutput);
+                double VectorSeconds = RunRawMeshDecodeBenchmark(&DecodeRawMeshTriangles, Soup, bWithNormals, NumRepeats, VectorOutput);
+
+                UE_LOG(LogXSPBenchmark, Display, TEXT("  %s, %s: 剔除退化三角形 %d 个"), Soup.Name, bWithNormals ? TEXT("带法线") : TEXT("计算法线"), NumTriangles - ScalarOutput.NumTriangles);
+                UE_LOG(LogXSPBenchmark, Display, TEXT("    标量: %.3f 秒 (%.2f M三角形/s)"), ScalarSeconds, NumTrianglesTotal / FMath::Max(ScalarSeconds, 1e-6) / 1e6);
+                UE_LOG(LogXSPBenchmark, Display, TEXT("    向量: %.3f 秒 (%.2f M三角形/s), 加速比 %.2fx, 结果%s"), VectorSeconds, NumTrianglesTotal / FMath::Max(VectorSeconds, 1e-6) / 1e6,
+                    ScalarSeconds / FMath::Max(VectorSeconds, 1e-6), IsRawMeshDecodeOutputEqual(ScalarOutput, VectorOutput) ? TEXT("一致") : TEXT("不一致"));
+            }
+        }
+    }
+}
+
+FAutoConsoleCommand XSPBenchmarkRawMeshDecodeCommand(
+    TEXT("xsp.Benchmark.RawMeshDecode"),
+    TEXT("比较网格体解码的标量实现与向量化实现的吞吐量, 参数: [三角形数] [重复次数]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRawMeshDecode)
+);
@@ -0,0 +1,35 @@
+#include "XSPBuildHeaderIndexCommandlet.h"
+#include "XSPHeaderIndex.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPBuildHeaderIndex, Log, All);
+
+UXSPBuildHeaderIndexCommandlet::UXSPBuildHeaderIndexCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 UXSPBuildHeaderIndexCommandlet::Main(const FString& Params)
+{
+    TArray<FString> Tokens, Switches;
+    ParseCommandLine(*Params, Tokens, Switches);
+    if (Tokens.IsEmpty())
+    {
+        UE_LOG(LogXSPBuildHeaderIndex, Display, TEXT("用法: -run=XSPBuildHeaderIndex <文件路径> [<文件路径> ...]"));
+        return 1;
+    }
+
+    int32 NumFailed = 0;
+    for (const FString& SourceFilePathName : Tokens)
+    {
+        TArray<FXSPHeaderIndexEntry> Entries;
+        if (!FXSPHeaderIndex::Build(SourceFilePathName, Entries) || !FXSPHeaderIndex::Save(SourceFilePathName, Entries))
+        {
+            UE_LOG(LogXSPBuildHeaderIndex, Error, TEXT("生成头信息索引失败: %s"), *SourceFilePathName);
+            NumFailed++;
+        }
+    }
+    return NumFailed > 0 ? 1 : 0;
+}
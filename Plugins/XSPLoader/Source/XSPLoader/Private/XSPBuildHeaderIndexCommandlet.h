@@ -0,0 +1,20 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "XSPBuildHeaderIndexCommandlet.generated.h"
+
+/**
+为XSP文件预先生成头信息索引(.xspidx),用法:
+UnrealEditor-Cmd.exe <项目> -run=XSPBuildHeaderIndex <文件路径> [<文件路径> ...]
+*/
+UCLASS()
+class UXSPBuildHeaderIndexCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UXSPBuildHeaderIndexCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
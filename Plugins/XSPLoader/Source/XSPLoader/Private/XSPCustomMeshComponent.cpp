@@ -3,6 +3,7 @@
 #include "XSPDataStruct.h"
 #include "XSPStat.h"
 #include "MeshUtils.h"
+#include "XSPMeshCodec.h"
 #include "XSPVertexFactory.h"
 #include "RHI.h"
 #include "XSPPositionVertexBuffer.h"
@@ -64,6 +65,7 @@ public:
         , MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
     {
         NumVertices = Component->NumVerticesTotal;
+        NumIndices = Component->NumIndicesTotal;
         if (Material == NULL)
         {
             Material = UMaterial::GetDefaultMaterial(MD_Surface);
@@ -119,7 +121,7 @@ public:
         FMeshBatchElement& BatchElement = OutMeshBatch.Elements[0];
         BatchElement.IndexBuffer = &CustomMesh->IndexBuffer;
         BatchElement.FirstIndex = 0;
-        BatchElement.NumPrimitives = NumVertices / 3;
+        BatchElement.NumPrimitives = NumIndices / 3;
         BatchElement.MinVertexIndex = 0;
         BatchElement.MaxVertexIndex = NumVertices-1;
     }
@@ -143,6 +145,7 @@ private:
     UXSPCustomMeshComponent* XSPCustomMeshComponent;
     FXSPCustomMesh* CustomMesh;
     uint32 NumVertices;
+    uint32 NumIndices;
     UMaterialInterface* Material;
     FMaterialRelevance MaterialRelevance;
 };
@@ -156,11 +159,13 @@ UXSPCustomMeshComponent::~UXSPCustomMeshComponent()
 {
 }
 
-void UXSPCustomMeshComponent::Init(AXSPModelActor* InOwnerActor, const TArray<int32>& InDbidArray, bool bAsyncBuild)
+void UXSPCustomMeshComponent::Init(AXSPModelActor* InOwnerActor, const TArray<int32>& InDbidArray, bool bAsyncBuild, bool bInInstancePrimitives)
 {
     OwnerActor = InOwnerActor;
     DbidArray = InDbidArray;
+    bInstancePrimitives = bInInstancePrimitives;
     NumVerticesTotal = 0;
+    NumIndicesTotal = 0;
 
     bHasNoStreamableTextures = true;
 
@@ -264,24 +269,26 @@ UBodySetup* UXSPCustomMeshComponent::GetBodySetup()
 bool UXSPCustomMeshComponent::GetPhysicsTriMeshData(FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
 {
     CollisionData->Vertices.SetNum(NumVerticesTotal);
-    CollisionData->Indices.SetNum(NumVerticesTotal / 3);
+    CollisionData->Indices.SetNum(NumIndicesTotal / 3);
 
     const TArray<FXSPNodeData*>& NodeDataArray = OwnerActor->GetNodeDataArray();
     int32 VerticesIndex = 0, IndicesIndex = 0;
     int32 VertexBase = 0;
+    FXSPMeshScratch& Scratch = GetThreadMeshScratch();
     for (int32 Dbid : DbidArray)
     {
-        int32 NumVertices = NodeDataArray[Dbid]->MeshPositionArray.Num();
+        FXSPNodeMeshView Mesh = GetNodeMeshView(*NodeDataArray[Dbid], Scratch, bInstancePrimitives);
+        int32 NumVertices = Mesh.Positions.Num();
         for (int32 i = 0; i < NumVertices; i++)
         {
-            CollisionData->Vertices[VerticesIndex++] = FVector3f(NodeDataArray[Dbid]->MeshPositionArray[i]);
+            CollisionData->Vertices[VerticesIndex++] = Mesh.Positions[i];
         }
-        int32 NumTriangles = NumVertices / 3;
+        int32 NumTriangles = Mesh.Indices.Num() / 3;
         for (int32 j = 0; j < NumTriangles; j++)
         {
-            CollisionData->Indices[IndicesIndex].v0 = VertexBase + j * 3 + 0;
-            CollisionData->Indices[IndicesIndex].v1 = VertexBase + j * 3 + 1;
-            CollisionData->Indices[IndicesIndex].v2 = VertexBase + j * 3 + 2;
+            CollisionData->Indices[IndicesIndex].v0 = VertexBase + Mesh.Indices[j * 3 + 0];
+            CollisionData->Indices[IndicesIndex].v1 = VertexBase + Mesh.Indices[j * 3 + 1];
+            CollisionData->Indices[IndicesIndex].v2 = VertexBase + Mesh.Indices[j * 3 + 2];
             IndicesIndex++;
         }
         VertexBase += NumVertices;
@@ -301,12 +308,11 @@ bool UXSPCustomMeshComponent::ContainsPhysicsTriMeshData(bool InUseAllTriData) c
 
 void UXSPCustomMeshComponent::BuildMesh_AnyThread()
 {
-    int32 NumIndicesTotal = 0;
     const TArray<FXSPNodeData*>& NodeDataArray = OwnerActor->GetNodeDataArray();
     for (int32 Dbid : DbidArray)
     {
-        NumVerticesTotal += NodeDataArray[Dbid]->MeshPositionArray.Num();
-        NumIndicesTotal += NodeDataArray[Dbid]->MeshIndexArray.Num();
+        NumVerticesTotal += GetNodeMeshNumVertices(*NodeDataArray[Dbid], bInstancePrimitives);
+        NumIndicesTotal += GetNodeMeshNumIndices(*NodeDataArray[Dbid], bInstancePrimitives);
         EndFaceIndexArray.Add(NumIndicesTotal / 3 - 1);
     }
 
@@ -326,24 +332,26 @@ void UXSPCustomMeshComponent::BuildMesh_AnyThread()
     int32 VertexIndex = 0;
     int32 IndexIndex = 0;
     uint32 Offset = 0;
+    FXSPMeshScratch& Scratch = GetThreadMeshScratch();
     for (int32 Dbid : DbidArray)
     {
         int32 VertexOffset = VertexIndex;
-        int32 NumVertices = NodeDataArray[Dbid]->MeshPositionArray.Num();
+        FXSPNodeMeshView Mesh = GetNodeMeshView(*NodeDataArray[Dbid], Scratch, bInstancePrimitives);
+        int32 NumVertices = Mesh.Positions.Num();
 
-        FMemory::Memcpy(&((uint8*)PositionData)[Offset * PositionStride], NodeDataArray[Dbid]->MeshPositionArray.GetData(), PositionStride * NumVertices);
+        FMemory::Memcpy(&((uint8*)PositionData)[Offset * PositionStride], Mesh.Positions.GetData(), PositionStride * NumVertices);
         Offset += NumVertices;
 
         for (int32 i = 0; i < NumVertices; i++)
         {
-            BoundingBox += NodeDataArray[Dbid]->MeshPositionArray[i];
-            CustomMesh->StaticMeshVertexBuffer.SetVertexTangents(VertexIndex, FVector3f::ZeroVector, FVector3f::ZeroVector, NodeDataArray[Dbid]->MeshNormalArray[i].ToFVector3f());
+            BoundingBox += Mesh.Positions[i];
+            CustomMesh->StaticMeshVertexBuffer.SetVertexTangents(VertexIndex, FVector3f::ZeroVector, FVector3f::ZeroVector, Mesh.Normals[i].ToFVector3f());
             VertexIndex++;
         }
-        int32 NumIndices = NodeDataArray[Dbid]->MeshIndexArray.Num();
+        int32 NumIndices = Mesh.Indices.Num();
         for (int32 i = 0; i < NumIndices; i++)
         {
-            IndexArray[IndexIndex] = NodeDataArray[Dbid]->MeshIndexArray[i] + VertexOffset;
+            IndexArray[IndexIndex] = Mesh.Indices[i] + VertexOffset;
             IndexIndex++;
         }
     }
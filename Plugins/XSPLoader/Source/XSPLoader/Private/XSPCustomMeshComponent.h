@@ -15,7 +15,8 @@ public:
     UXSPCustomMeshComponent();
     virtual ~UXSPCustomMeshComponent();
 
-    void Init(AXSPModelActor* OwnerActor, const TArray<int32>& DbidArray, bool bAsyncBuild);
+    //节点中不以实例绘制的参数化几何体(bInstancePrimitives为false时为全部)在构建时生成网格,一起合批
+    void Init(AXSPModelActor* OwnerActor, const TArray<int32>& DbidArray, bool bAsyncBuild, bool bInstancePrimitives);
 
     const TArray<int32>& GetNodes() const;
 
@@ -63,8 +64,12 @@ private:
     //包中各节点的最大三角形索引
     TArray<int32> EndFaceIndexArray;
 
-    //顶点总数
+    //顶点总数与索引总数
     int32 NumVerticesTotal = 0;
+    int32 NumIndicesTotal = 0;
+
+    //可以实例绘制的参数化几何体由实例化组件绘制,不生成网格
+    bool bInstancePrimitives = true;
 
     FBoxSphereBounds LocalBounds;
 
@@ -23,14 +23,17 @@ struct FXSPPrimitiveData
 	float Material[4];
 	
 	//参数化几何体的参数
-	float* PrimitiveParamsBuffer;
+	const float* PrimitiveParamsBuffer;
 	uint8 PrimitiveParamsBufferLength;
 
 	//网格体的顶点数据
-	float* MeshVertexBuffer;
-	float* MeshNormalBuffer;
+	const float* MeshVertexBuffer;
+	const float* MeshNormalBuffer;
 	int32 MeshVertexBufferLength;
 
+	//为false时以上缓冲区是指向映射文件的只读视图(不拷贝),由映射文件保证在ResolveNodeData完成前有效
+	bool bOwnsBuffers;
+
 	FXSPPrimitiveData()
 		: Type(EXSPPrimitiveType::Unknown)
 		, PrimitiveParamsBuffer(nullptr)
@@ -38,9 +41,12 @@ struct FXSPPrimitiveData
 		, MeshVertexBuffer(nullptr)
 		, MeshNormalBuffer(nullptr)
 		, MeshVertexBufferLength(0)
+		, bOwnsBuffers(true)
 	{}
 	~FXSPPrimitiveData()
 	{
+		if (!bOwnsBuffers)
+			return;
 		if (PrimitiveParamsBuffer != nullptr)
 			delete[] PrimitiveParamsBuffer;
 		if (MeshVertexBuffer != nullptr)
@@ -50,6 +56,69 @@ struct FXSPPrimitiveData
 	}
 };
 
+//参数化几何体,以共享的单位网格体经GetPrimitiveInstanceTransform变换绘制,或在合批时由AppendPrimitiveInstanceMesh生成网格
+struct FXSPPrimitiveInstance
+{
+	//圆柱体为底面圆心,椭圆形为圆心
+	FVector3f Center = FVector3f::ZeroVector;
+	//圆柱体为从底面指向顶面的轴向,椭圆形为法线(单位向量)
+	FVector3f Axis = FVector3f::UnitZ();
+	//椭圆形源数据的xVector、yVector乘以半径,圆周上的点为Center + XVector * sin + YVector * cos;圆柱体不使用
+	FVector3f XVector = FVector3f::ZeroVector;
+	FVector3f YVector = FVector3f::ZeroVector;
+	float Radius = 0;
+	//圆柱体的高度,椭圆形为0
+	float Length = 0;
+	EXSPPrimitiveType Type = EXSPPrimitiveType::Unknown;
+	//圆周分段数,与Type一起决定使用的单位网格体
+	uint8 NumSegments = 0;
+
+	//生成网格的顶点数与索引数:圆柱体侧面每段两个顶点、两个三角形,椭圆形为中心加一圈顶点
+	int32 GetNumVertices() const
+	{
+		return Type == EXSPPrimitiveType::Cylinder ? NumSegments * 2 : NumSegments + 1;
+	}
+
+	int32 GetNumIndices() const
+	{
+		return Type == EXSPPrimitiveType::Cylinder ? NumSegments * 6 : NumSegments * 3;
+	}
+
+	//能否以单位网格体的旋转与缩放绘制:两轴不正交的椭圆形需要错切变换,只能生成网格
+	bool CanInstance() const
+	{
+		return Type == EXSPPrimitiveType::Cylinder || FMath::Abs(XVector.GetSafeNormal() | YVector.GetSafeNormal()) < 1e-3f;
+	}
+};
+
+//编码存储的网格体数据(编码与解码见XSPMeshCodec.h)
+struct FXSPEncodedMesh
+{
+	int32 NumVertices = 0;
+	int32 NumIndices = 0;
+
+	//位置量化的原点与步长(取网格体包围盒,每轴65535级)
+	FVector3f QuantizationMin = FVector3f::ZeroVector;
+	FVector3f QuantizationStep = FVector3f::ZeroVector;
+
+	//每顶点3个16位量化坐标
+	TArray<uint16> Positions;
+	//每顶点一个八面体编码的法线(两个8位分量)
+	TArray<uint16> Normals;
+	//索引与前一索引之差的zigzag变长编码
+	TArray<uint8> Indices;
+
+	bool IsEmpty() const
+	{
+		return NumVertices == 0;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Positions.GetAllocatedSize() + Normals.GetAllocatedSize() + Indices.GetAllocatedSize();
+	}
+};
+
 //节点数据
 struct FXSPNodeData
 {
@@ -79,6 +148,12 @@ struct FXSPNodeData
 	TArray<FPackedNormal> MeshNormalArray;
 	TArray<uint32> MeshIndexArray;
 
+	//编码存储的网格体数据,编码成功后上面三个数组被释放
+	FXSPEncodedMesh EncodedMesh;
+
+	//参数化几何体,只保存参数,不生成网格数据
+	TArray<FXSPPrimitiveInstance> PrimitiveInstanceArray;
+
 	//包围盒
 	FBox3f MeshBoundingBox;
 
@@ -90,6 +165,69 @@ struct FXSPNodeData
 		, MeshBoundingBox(ForceInit)
 	{
 	}
+
+	//网格体顶点数与索引数(无论是否编码)
+	int32 GetNumVertices() const
+	{
+		return EncodedMesh.IsEmpty() ? MeshPositionArray.Num() : EncodedMesh.NumVertices;
+	}
+
+	int32 GetNumIndices() const
+	{
+		return EncodedMesh.IsEmpty() ? MeshIndexArray.Num() : EncodedMesh.NumIndices;
+	}
+
+	bool HasMesh() const
+	{
+		return GetNumVertices() > 0;
+	}
+
+	bool HasPrimitiveInstance() const
+	{
+		return !PrimitiveInstanceArray.IsEmpty();
+	}
+
+	//含有可以实例绘制的参数化几何体
+	bool HasInstanceablePrimitive() const
+	{
+		return PrimitiveInstanceArray.ContainsByPredicate([](const FXSPPrimitiveInstance& Instance) { return Instance.CanInstance(); });
+	}
+
+	//参数化几何体在合批时生成的顶点数与索引数,bInstancePrimitives为true时不计可以实例绘制的
+	int32 GetNumPrimitiveVertices(bool bInstancePrimitives) const
+	{
+		int32 NumVertices = 0;
+		for (const FXSPPrimitiveInstance& Instance : PrimitiveInstanceArray)
+		{
+			if (!bInstancePrimitives || !Instance.CanInstance())
+				NumVertices += Instance.GetNumVertices();
+		}
+		return NumVertices;
+	}
+
+	int32 GetNumPrimitiveIndices(bool bInstancePrimitives) const
+	{
+		int32 NumIndices = 0;
+		for (const FXSPPrimitiveInstance& Instance : PrimitiveInstanceArray)
+		{
+			if (!bInstancePrimitives || !Instance.CanInstance())
+				NumIndices += Instance.GetNumIndices();
+		}
+		return NumIndices;
+	}
+
+	//网格数据或实例至少有一种
+	bool HasGeometry() const
+	{
+		return HasMesh() || HasPrimitiveInstance();
+	}
+
+	//网格体数据占用的内存
+	SIZE_T GetMeshAllocatedSize() const
+	{
+		return MeshPositionArray.GetAllocatedSize() + MeshNormalArray.GetAllocatedSize() + MeshIndexArray.GetAllocatedSize() + EncodedMesh.GetAllocatedSize() +
+			PrimitiveInstanceArray.GetAllocatedSize();
+	}
 };
 
 struct Header_info
@@ -3,6 +3,24 @@
 #include "XSPFileUtils.h"
 #include "MeshUtils.h"
 #include "XSPStat.h"
+#include "XSPGeometryCache.h"
+#include "Async/ParallelFor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPFileReader, Log, All);
+
+int32 XSPParseChunkSize = 4096;
+FAutoConsoleVariableRef CVarXSPParseChunkSize(
+    TEXT("xsp.ParseChunkSize"),
+    XSPParseChunkSize,
+    TEXT("单个文件并行解析时每个分块的节点数，缺省为4096")
+);
+
+bool bXSPEnableGeometryCache = true;
+FAutoConsoleVariableRef CVarXSPEnableGeometryCache(
+    TEXT("xsp.EnableGeometryCache"),
+    bXSPEnableGeometryCache,
+    TEXT("是否使用预处理几何缓存(.xspc)加速再次加载，缺省为true")
+);
 
 
 FXSPFileReader::FXSPFileReader(AXSPModelActor* InOwner)
@@ -25,23 +43,18 @@ FXSPFileReader::~FXSPFileReader()
         Thread = nullptr;
     }
 
-    if (FileStream.is_open())
-    {
-        FileStream.close();
-    }
+    SourceFile.Close();
 }
 
 int32 FXSPFileReader::Start(const FString& FilePathName, int32 InOffset)
 {
     Offset = InOffset;
 
-    FileStream.open(std::wstring(*FilePathName), std::ios::in | std::ios::binary);
-    if (!FileStream.is_open())
+    if (!SourceFile.Open(FilePathName))
         return false;
 
     //读取源文件的节点数
-    FileStream.seekg(0, std::ios::beg);
-    FileStream.read((char*)&NumNodes, sizeof(NumNodes));
+    NumNodes = ReadNumNodes(SourceFile);
 
     if (NumNodes > 0)
     {
@@ -61,63 +74,90 @@ uint32 FXSPFileReader::Run()
 {
     int64 Ticks1 = FDateTime::Now().GetTicks();
 
-    short headlength;
-    FileStream.read((char*)&headlength, sizeof(headlength));
-    TArray<Header_info> HeaderList;
-    ReadHeaderInfo(FileStream, NumNodes, HeaderList);
-
-    TArray<FAsyncTask<FResolveNodeDataTask>*> ResolveNodeDataTaskArray;
-    NodeDataArray.SetNumUninitialized(NumNodes);
-    for (int32 j = 0; bRunning && j < NumNodes; j++)
+    //0.几何缓存命中时直接拷贝缓存中的最终数据,跳过解析与网格生成
+    uint64 SourceHash = 0;
+    FString CacheFilePathName;
+    if (bXSPEnableGeometryCache)
     {
-        FXSPNodeData* NodeData = NodeDataArray[j] = new FXSPNodeData;
-        NodeData->Dbid = Offset + j;
-        ReadNodeData(FileStream, HeaderList[j], *NodeData);
-
-        if (NodeData->Level == 1)
-            LevelOneNodeIdArray.Emplace(NodeData->Dbid);
+        CacheFilePathName = GetGeometryCacheFilePathName(SourceFile.GetFilePathName());
+        SourceHash = ComputeGeometryCacheSourceHash(SourceFile);
+        TBitArray<> LeafFlags;
+        if (LoadGeometryCache(CacheFilePathName, SourceHash, Offset, NumNodes, NodeDataArray, LeafFlags))
+        {
+            for (int32 j = 0; j < NumNodes; j++)
+            {
+                RegisterNode(j, LeafFlags[j]);
+            }
+            FinishRead(Ticks1, true);
+            return 0;
+        }
+    }
 
-        if (NodeData->PrimitiveArray.Num() > 0)
+    //1.将节点范围分块并行解析,各块以自己的偏移直接从映射内存解码,互不共享状态
+    NodeDataArray.SetNumZeroed(NumNodes);
+    const int32 ChunkSize = FMath::Max(XSPParseChunkSize, 1);
+    const int32 NumChunks = FMath::DivideAndRoundUp(NumNodes, ChunkSize);
+    ParallelFor(NumChunks, [this, ChunkSize](int32 ChunkIndex) {
+        int32 Begin = ChunkIndex * ChunkSize;
+        int32 End = FMath::Min(Begin + ChunkSize, NumNodes);
+        Header_info Header;
+        for (int32 j = Begin; bRunning && j < End; j++)
         {
-            LeafNodeIdArray.Emplace(NodeData->Dbid);
+            FXSPNodeData* NodeData = NodeDataArray[j] = new FXSPNodeData;
+            NodeData->Dbid = Offset + j;
+
+            //头信息直接从映射内存解码
+            if (!ReadHeaderInfo(SourceFile, XSPFileHeaderSize + j * XSPHeaderInfoSize, Header) ||
+                !ReadNodeData(SourceFile, Header, *NodeData))
+            {
+                UE_LOG(LogXSPFileReader, Warning, TEXT("节点数据越界: %d"), NodeData->Dbid);
+                NodeData->PrimitiveArray.Empty();
+            }
+        }
+    }, EParallelForFlags::Unbalanced);
 
-            FXSPNodeData* ParentNodeData = nullptr;
-            if (NodeData->ParentDbid >= Offset)
-                ParentNodeData = NodeDataArray[NodeData->ParentDbid - Offset];
-            else
-                LackParentNodeIdArray.Emplace(NodeData->Dbid);
+    if (!bRunning)
+        return 0;
 
-            FAsyncTask<FResolveNodeDataTask>* Task = new FAsyncTask<FResolveNodeDataTask>(NodeData, ParentNodeData);
-            Task->StartBackgroundTask();
-            ResolveNodeDataTaskArray.Emplace(Task);
-        }
+    //2.按dbid顺序收集节点索引,保证各数组的顺序与串行解析时一致
+    TArray<FXSPNodeData*> ParentNodeDataArray;
+    for (int32 j = 0; j < NumNodes; j++)
+    {
+        bool bLeaf = NodeDataArray[j]->PrimitiveArray.Num() > 0;
+        FXSPNodeData* ParentNodeData = RegisterNode(j, bLeaf);
+        if (bLeaf)
+            ParentNodeDataArray.Emplace(ParentNodeData);
     }
-    TArray<FAsyncTask<FResolveNodeDataTask>*> RemainTasks;
-    for (auto Task : ResolveNodeDataTaskArray)
+
+    //3.并行生成网格数据(只读取父节点的原始材质,父节点已全部解析完毕),编码方式在开始前取一次
+    EXSPMeshCodec MeshCodec = GetMeshCodec();
+    ParallelFor(LeafNodeIdArray.Num(), [this, &ParentNodeDataArray, MeshCodec](int32 i) {
+        if (bRunning)
+            ResolveNodeData(*NodeDataArray[LeafNodeIdArray[i] - Offset], ParentNodeDataArray[i], MeshCodec);
+    }, EParallelForFlags::Unbalanced);
+
+    if (!bRunning)
+        return 0;
+
+    //4.写入几何缓存供下次加载使用
+    if (bXSPEnableGeometryCache)
     {
-        if (Task->IsDone())
+        TBitArray<> LeafFlags(false, NumNodes);
+        for (int32 Dbid : LeafNodeIdArray)
         {
-            NumVerticesTotal += Task->GetTask().NodeData->MeshPositionArray.Num();
-            delete Task;
+            LeafFlags[Dbid - Offset] = true;
         }
-        else
+        int64 SaveBeginTicks = FDateTime::Now().GetTicks();
+        if (SaveGeometryCache(CacheFilePathName, SourceHash, NodeDataArray, LeafFlags))
         {
-            RemainTasks.Emplace(Task);
+            UE_LOG(LogXSPFileReader, Display, TEXT("写入几何缓存: %s, 耗时%.2f秒"), *CacheFilePathName,
+                (float)(FDateTime::Now().GetTicks() - SaveBeginTicks) / ETimespan::TicksPerSecond);
         }
+        //缓存写入时间不计入读取时间
+        Ticks1 += FDateTime::Now().GetTicks() - SaveBeginTicks;
     }
-    ResolveNodeDataTaskArray.Empty();
 
-    //等待所有计算任务完成
-    for (auto Task : RemainTasks)
-    {
-        Task->EnsureCompletion();
-        NumVerticesTotal += Task->GetTask().NodeData->MeshPositionArray.Num();
-        delete Task;
-    }
-    RemainTasks.Empty();
-
-    bComplete = true;
-    INC_FLOAT_STAT_BY(STAT_XSPLoader_ReadFileTime, (float)(FDateTime::Now().GetTicks() - Ticks1) / ETimespan::TicksPerSecond);
+    FinishRead(Ticks1, false);
 
     return 0;
 }
@@ -166,13 +206,48 @@ int32 FXSPFileReader::GetNumVerticesTotal()
     return NumVerticesTotal;
 }
 
-FResolveNodeDataTask::FResolveNodeDataTask(FXSPNodeData* InNodeData, FXSPNodeData* InParentNodeData)
-    : NodeData(InNodeData)
-    , ParentNodeData(InParentNodeData)
+FXSPNodeData* FXSPFileReader::RegisterNode(int32 LocalDbid, bool bLeaf)
 {
+    FXSPNodeData* NodeData = NodeDataArray[LocalDbid];
+    if (NodeData->Level == 1)
+        LevelOneNodeIdArray.Emplace(NodeData->Dbid);
+
+    if (!bLeaf)
+        return nullptr;
+
+    LeafNodeIdArray.Emplace(NodeData->Dbid);
+
+    //父节点在本文件中的直接继承材质,否则留待所有文件读完后再继承
+    if (NodeData->ParentDbid >= Offset && NodeData->ParentDbid - Offset < NumNodes)
+        return NodeDataArray[NodeData->ParentDbid - Offset];
+
+    LackParentNodeIdArray.Emplace(NodeData->Dbid);
+    return nullptr;
 }
 
-void FResolveNodeDataTask::DoWork()
+void FXSPFileReader::FinishRead(int64 BeginTicks, bool bFromGeometryCache)
 {
-    ResolveNodeData(*NodeData, ParentNodeData);
+    SIZE_T MeshMemory = 0;
+    for (int32 Dbid : LeafNodeIdArray)
+    {
+        NumVerticesTotal += NodeDataArray[Dbid - Offset]->GetNumVertices();
+        MeshMemory += NodeDataArray[Dbid - Offset]->GetMeshAllocatedSize();
+    }
+    INC_MEMORY_STAT_BY(STAT_XSPLoader_NodeDataMeshMemory, MeshMemory);
+
+    float Seconds = (float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond;
+    INC_FLOAT_STAT_BY(STAT_XSPLoader_ReadFileTime, Seconds);
+    if (bFromGeometryCache)
+    {
+        INC_FLOAT_STAT_BY(STAT_XSPLoader_ReadFileTimeWarm, Seconds);
+        INC_DWORD_STAT(STAT_XSPLoader_NumGeometryCacheHit);
+    }
+    else
+    {
+        INC_FLOAT_STAT_BY(STAT_XSPLoader_ReadFileTimeCold, Seconds);
+    }
+    UE_LOG(LogXSPFileReader, Display, TEXT("读取文件%s: %s, 节点数%d, 耗时%.2f秒"), bFromGeometryCache ? TEXT("(几何缓存)") : TEXT(""),
+        *SourceFile.GetFilePathName(), NumNodes, Seconds);
+
+    bComplete = true;
 }
@@ -1,10 +1,10 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include <fstream>
 #include "HAL/Runnable.h"
 #include "HAL/RunnableThread.h"
 #include "HAL/ThreadSafeBool.h"
+#include "XSPMappedFile.h"
 
 
 class FXSPFileReader : public FRunnable
@@ -29,9 +29,15 @@ public:
 	TArray<int32>& GetLackParentNodeIdArray();
 	int32 GetNumVerticesTotal();
 
+private:
+	//按dbid顺序登记节点,返回本文件中的父节点(叶子节点且父节点不在本文件时返回nullptr)
+	struct FXSPNodeData* RegisterNode(int32 LocalDbid, bool bLeaf);
+	void FinishRead(int64 BeginTicks, bool bFromGeometryCache);
+
 private:
 	class AXSPModelActor* Owner;
-    std::fstream FileStream;
+	//零拷贝读入的几何体数据引用此映射,必须在所有解析任务完成后才能关闭
+	FXSPMappedFile SourceFile;
 	int32 Offset;
 	int32 NumNodes;
 
@@ -46,21 +52,3 @@ private:
 
 	int32 NumVerticesTotal = 0;
 };
-
-class FResolveNodeDataTask : public FNonAbandonableTask
-{
-public:
-	FResolveNodeDataTask(FXSPNodeData* NodeData, FXSPNodeData* ParentNodeData);
-
-	void DoWork();
-
-	TStatId GetStatId() const
-	{
-		return TStatId();
-	}
-
-private:
-	friend class FXSPFileReader;
-	FXSPNodeData* NodeData;
-	FXSPNodeData* ParentNodeData;
-};
\ No newline at end of file
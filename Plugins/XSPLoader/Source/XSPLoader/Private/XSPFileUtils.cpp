@@ -1,4 +1,13 @@
 #include "XSPFileUtils.h"
+#include "XSPMappedFile.h"
+#include "HAL/IConsoleManager.h"
+
+bool bXSPZeroCopyPrimitiveData = true;
+FAutoConsoleVariableRef CVarXSPZeroCopyPrimitiveData(
+    TEXT("xsp.ZeroCopyPrimitiveData"),
+    bXSPZeroCopyPrimitiveData,
+    TEXT("内存映射读取时几何体数据是否直接引用映射内存而不拷贝，缺省为true")
+);
 
 void ReadHeaderInfo(std::fstream& file, Header_info& info)
 {
@@ -108,12 +117,14 @@ void ReadNodeData(std::fstream& file, const Header_info& header, FXSPNodeData& N
 static const std::string GXSPPrimitiveTypeStringMesh = "Mesh";
 static const std::string GXSPPrimitiveTypeStringElliptical = "Elliptical";
 static const std::string GXSPPrimitiveTypeStringCylinder = "Cylinder";
-static char NameBuffer[128];
 void ReadPrimitiveData(std::fstream& file, const Header_info& header, FXSPPrimitiveData& PrimitiveData)
 {
+    //名称缓冲区在栈上,允许多个线程同时解析
+    char NameBuffer[128];
+    int32 NameLength = FMath::Clamp(header.namelength, 0, (int32)sizeof(NameBuffer) - 1);
     file.seekg(header.startname, std::ios::beg);
-    file.read(NameBuffer, header.namelength);
-    NameBuffer[header.namelength] = '\0';
+    file.read(NameBuffer, NameLength);
+    NameBuffer[NameLength] = '\0';
     if (GXSPPrimitiveTypeStringMesh == NameBuffer)
     {
         PrimitiveData.Type = EXSPPrimitiveType::Mesh;
@@ -136,15 +147,229 @@ void ReadPrimitiveData(std::fstream& file, const Header_info& header, FXSPPrimit
         if (PrimitiveData.Type == EXSPPrimitiveType::Elliptical || PrimitiveData.Type == EXSPPrimitiveType::Cylinder)
         {
             PrimitiveData.PrimitiveParamsBufferLength = header.verticeslength / 4;
-            PrimitiveData.PrimitiveParamsBuffer = new float[PrimitiveData.PrimitiveParamsBufferLength];
-            file.read((char*)PrimitiveData.PrimitiveParamsBuffer, sizeof(float) * PrimitiveData.PrimitiveParamsBufferLength);
+            float* Buffer = new float[PrimitiveData.PrimitiveParamsBufferLength];
+            file.read((char*)Buffer, sizeof(float) * PrimitiveData.PrimitiveParamsBufferLength);
+            PrimitiveData.PrimitiveParamsBuffer = Buffer;
         }
         else if (PrimitiveData.Type == EXSPPrimitiveType::Mesh)
         {
             PrimitiveData.MeshVertexBufferLength = header.verticeslength / 4;
-            PrimitiveData.MeshVertexBuffer = new float[PrimitiveData.MeshVertexBufferLength];
-            file.read((char*)PrimitiveData.MeshVertexBuffer, sizeof(float) * PrimitiveData.MeshVertexBufferLength);
+            float* Buffer = new float[PrimitiveData.MeshVertexBufferLength];
+            file.read((char*)Buffer, sizeof(float) * PrimitiveData.MeshVertexBufferLength);
+            PrimitiveData.MeshVertexBuffer = Buffer;
             //TODO:MeshNormalBuffer
         }
     }
-}
\ No newline at end of file
+}
+
+namespace
+{
+    //名称字段可能以'\0'补齐,只取有效部分
+    int32 GetNameLength(const uint8* Name, int32 Length)
+    {
+        int32 Index = 0;
+        while (Index < Length && Name[Index] != 0)
+            Index++;
+        return Index;
+    }
+
+    bool IsNameEqual(const uint8* Name, int32 Length, const std::string& Expected)
+    {
+        return Length == (int32)Expected.size() && FMemory::Memcmp(Name, Expected.data(), Length) == 0;
+    }
+
+    template<typename T>
+    void DecodeField(const uint8* Ptr, int32 FieldOffset, T& OutValue)
+    {
+        FMemory::Memcpy(&OutValue, Ptr + FieldOffset, sizeof(T));
+    }
+}
+
+int32 ReadNumNodes(const FXSPMappedFile& File)
+{
+    int32 NumNodes = 0;
+    if (!File.Read(0, NumNodes) || NumNodes < 0)
+        return 0;
+    //头信息表必须完整
+    if (!File.IsValidRange(XSPFileHeaderSize, NumNodes * XSPHeaderInfoSize))
+        return 0;
+    return NumNodes;
+}
+
+bool ReadHeaderInfo(const FXSPMappedFile& File, int64 Offset, Header_info& info)
+{
+    if (!File.IsValidRange(Offset, XSPHeaderInfoSize))
+        return false;
+
+    //字段布局与ReadHeaderInfo(std::fstream&, Header_info&)的读取顺序一致
+    const uint8* Ptr = File.GetData() + Offset;
+    DecodeField(Ptr, 0, info.empty_fragment);
+    DecodeField(Ptr, 2, info.parentdbid);
+    DecodeField(Ptr, 6, info.level);
+    DecodeField(Ptr, 8, info.startname);
+    DecodeField(Ptr, 12, info.namelength);
+    DecodeField(Ptr, 16, info.startproperty);
+    DecodeField(Ptr, 20, info.propertylength);
+    DecodeField(Ptr, 24, info.startmaterial);
+    DecodeField(Ptr, 28, info.startbox);
+    DecodeField(Ptr, 32, info.startvertices);
+    DecodeField(Ptr, 36, info.verticeslength);
+    DecodeField(Ptr, 40, info.offset);
+    return true;
+}
+
+bool ReadHeaderInfo(const FXSPMappedFile& File, int64 Offset, int nsize, TArray<Header_info>& header_list)
+{
+    if (nsize < 0 || !File.IsValidRange(Offset, nsize * XSPHeaderInfoSize))
+        return false;
+
+    header_list.SetNum(nsize);
+    for (int i = 0; i < nsize; i++)
+    {
+        ReadHeaderInfo(File, Offset + i * XSPHeaderInfoSize, header_list[i]);
+    }
+    return true;
+}
+
+bool ReadBodyInfo(const FXSPMappedFile& File, const Header_info& header, bool is_fragment, Body_info& body)
+{
+    body.parentdbid = header.parentdbid;
+    body.level = header.level;
+
+    //node name
+    if (!File.IsValidRange(header.startname, header.namelength))
+        return false;
+    const uint8* Name = File.GetData() + header.startname;
+    body.name.assign((const char*)Name, GetNameLength(Name, header.namelength));
+
+    //node property
+    if (!File.IsValidRange(header.startproperty, header.propertylength))
+        return false;
+    const uint8* Property = File.GetData() + header.startproperty;
+    body.property.assign((const char*)Property, GetNameLength(Property, header.propertylength));
+
+    if (!File.Read(header.startmaterial, body.material))
+        return false;
+
+    if (!is_fragment && !File.Read(header.startbox, body.box))
+        return false;
+
+    if (is_fragment)
+    {
+        //fragment vertices
+        int32 NumFloats = header.verticeslength / 4;
+        if (!File.IsValidRange(header.startvertices, (int64)NumFloats * sizeof(float)))
+            return false;
+        body.vertices.resize(NumFloats);
+        FMemory::Memcpy(body.vertices.data(), File.GetData() + header.startvertices, NumFloats * sizeof(float));
+    }
+    else if (header.verticeslength > 0)
+    {
+        TArray<Header_info> fragment_headerList;
+        if (!ReadHeaderInfo(File, header.startvertices, header.verticeslength / XSPHeaderInfoSize, fragment_headerList))
+            return false;
+        int num_fragments = fragment_headerList.Num();
+        body.fragment.SetNum(num_fragments);
+        for (int k = 0; k < num_fragments; k++)
+        {
+            if (!ReadBodyInfo(File, fragment_headerList[k], true, body.fragment[k]))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool ReadNodeData(const FXSPMappedFile& File, const Header_info& header, FXSPNodeData& NodeData)
+{
+    NodeData.Level = header.level;
+    NodeData.ParentDbid = header.parentdbid;
+    NodeData.NumChildren = header.offset - NodeData.Dbid + 1;
+
+    //读材质
+    if (!File.Read(header.startmaterial, NodeData.Material))
+        return false;
+
+    //读fragments
+    if (header.verticeslength > 0)
+    {
+        int32 NumFragments = header.verticeslength / XSPHeaderInfoSize;
+        if (!File.IsValidRange(header.startvertices, NumFragments * XSPHeaderInfoSize))
+            return false;
+
+        NodeData.PrimitiveArray.SetNum(NumFragments);
+        Header_info FragmentHeader;
+        for (int32 k = 0; k < NumFragments; k++)
+        {
+            ReadHeaderInfo(File, header.startvertices + k * XSPHeaderInfoSize, FragmentHeader);
+            if (FragmentHeader.verticeslength > 0)
+            {
+                if (!ReadPrimitiveData(File, FragmentHeader, NodeData.PrimitiveArray[k]))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ReadPrimitiveData(const FXSPMappedFile& File, const Header_info& header, FXSPPrimitiveData& PrimitiveData)
+{
+    //直接与映射内存中的名称比较,不需要中间缓冲
+    if (!File.IsValidRange(header.startname, header.namelength))
+        return false;
+    const uint8* Name = File.GetData() + header.startname;
+    int32 NameLength = GetNameLength(Name, header.namelength);
+    if (IsNameEqual(Name, NameLength, GXSPPrimitiveTypeStringMesh))
+    {
+        PrimitiveData.Type = EXSPPrimitiveType::Mesh;
+    }
+    else if (IsNameEqual(Name, NameLength, GXSPPrimitiveTypeStringElliptical))
+    {
+        PrimitiveData.Type = EXSPPrimitiveType::Elliptical;
+    }
+    else if (IsNameEqual(Name, NameLength, GXSPPrimitiveTypeStringCylinder))
+    {
+        PrimitiveData.Type = EXSPPrimitiveType::Cylinder;
+    }
+
+    if (!File.Read(header.startmaterial, PrimitiveData.Material))
+        return false;
+
+    int32 NumFloats = header.verticeslength / 4;
+    if (!File.IsValidRange(header.startvertices, (int64)NumFloats * sizeof(float)))
+        return false;
+    const uint8* Vertices = File.GetData() + header.startvertices;
+
+    //零拷贝模式下直接引用映射内存,数据在文件中未按float对齐时仍然拷贝
+    PrimitiveData.bOwnsBuffers = !bXSPZeroCopyPrimitiveData || !IsAligned(Vertices, alignof(float));
+
+    if (PrimitiveData.Type == EXSPPrimitiveType::Elliptical || PrimitiveData.Type == EXSPPrimitiveType::Cylinder)
+    {
+        PrimitiveData.PrimitiveParamsBufferLength = NumFloats;
+        if (PrimitiveData.bOwnsBuffers)
+        {
+            float* Buffer = new float[PrimitiveData.PrimitiveParamsBufferLength];
+            FMemory::Memcpy(Buffer, Vertices, sizeof(float) * PrimitiveData.PrimitiveParamsBufferLength);
+            PrimitiveData.PrimitiveParamsBuffer = Buffer;
+        }
+        else
+        {
+            PrimitiveData.PrimitiveParamsBuffer = (const float*)Vertices;
+        }
+    }
+    else if (PrimitiveData.Type == EXSPPrimitiveType::Mesh)
+    {
+        PrimitiveData.MeshVertexBufferLength = NumFloats;
+        if (PrimitiveData.bOwnsBuffers)
+        {
+            float* Buffer = new float[PrimitiveData.MeshVertexBufferLength];
+            FMemory::Memcpy(Buffer, Vertices, sizeof(float) * PrimitiveData.MeshVertexBufferLength);
+            PrimitiveData.MeshVertexBuffer = Buffer;
+        }
+        else
+        {
+            PrimitiveData.MeshVertexBuffer = (const float*)Vertices;
+        }
+        //TODO:MeshNormalBuffer
+    }
+    return true;
+}
@@ -6,6 +6,13 @@
 #include "XSPDataStruct.h"
 #include <fstream>
 
+class FXSPMappedFile;
+
+//文件头: 节点数(4) + 头信息长度(2), 之后是按dbid顺序排列的节点头信息
+static constexpr int64 XSPFileHeaderSize = 6;
+//每个头信息(节点或fragment)的字节数,其中末尾16字节保留
+static constexpr int64 XSPHeaderInfoSize = 60;
+
 
 void ReadHeaderInfo(std::fstream& file, Header_info& info);
 
@@ -17,4 +24,16 @@ void ReadNodeData(std::fstream& file, const Header_info& header, FXSPNodeData& N
 
 void ReadPrimitiveData(std::fstream& file, const Header_info& header, FXSPPrimitiveData& PrimitiveData);
 
+//以下为基于内存映射的读取,直接从映射内存解码,越界的数据返回false
+
+int32 ReadNumNodes(const FXSPMappedFile& File);
+
+bool ReadHeaderInfo(const FXSPMappedFile& File, int64 Offset, Header_info& info);
+
+bool ReadHeaderInfo(const FXSPMappedFile& File, int64 Offset, int nsize, TArray<Header_info>& header_list);
+
+bool ReadBodyInfo(const FXSPMappedFile& File, const Header_info& header, bool is_fragment, Body_info& body);
+
+bool ReadNodeData(const FXSPMappedFile& File, const Header_info& header, FXSPNodeData& NodeData);
 
+bool ReadPrimitiveData(const FXSPMappedFile& File, const Header_info& header, FXSPPrimitiveData& PrimitiveData);
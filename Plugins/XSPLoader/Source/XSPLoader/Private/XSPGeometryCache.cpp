@@ -0,0 +1,286 @@
+#include "XSPGeometryCache.h"
+#include "XSPMappedFile.h"
+#include "XSPFileUtils.h"
+#include "MeshUtils.h"
+#include "XSPMeshCodec.h"
+#include "Hash/CityHash.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Async/ParallelFor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPGeometryCache, Log, All);
+
+
+namespace
+{
+    static const uint32 GeometryCacheMagic = 0x43505358;   //'XSPC'
+    static const uint32 GeometryCacheVersion = 4;
+
+    struct FXSPGeometryCacheHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        uint64 SourceHash;
+        uint32 SettingsHash;
+        int32 NumNodes;
+    };
+
+    enum EXSPGeometryCacheNodeFlags : uint32
+    {
+        GCNF_Leaf = 1 << 0,
+        //几何数据为FXSPEncodedMesh的编码格式
+        GCNF_Encoded = 1 << 1,
+    };
+
+    struct FXSPGeometryCacheNode
+    {
+        int32 ParentDbid;
+        int32 Level;
+        //最后一个子节点的dbid(即头信息中的offset),加载时据此重新计算NumChildren
+        int32 LastChildDbid;
+        uint32 Flags;
+        float Material[4];
+        float MeshMaterial[4];
+        float BoundingBoxMin[3];
+        float BoundingBoxMax[3];
+        int32 NumVertices;
+        int32 NumIndices;
+        //编码的位置量化参数与索引字节数(GCNF_Encoded)
+        float QuantizationMin[3];
+        float QuantizationStep[3];
+        int32 NumIndexBytes;
+        //网格数据之后的FXSPPrimitiveInstance数
+        int32 NumPrimitiveInstances;
+        //几何数据在文件中的偏移
+        int64 DataOffset;
+    };
+
+    int64 GetNodeDataSize(const FXSPGeometryCacheNode& CacheNode)
+    {
+        int64 InstanceDataSize = (int64)CacheNode.NumPrimitiveInstances * sizeof(FXSPPrimitiveInstance);
+        if (CacheNode.Flags & GCNF_Encoded)
+            return (int64)CacheNode.NumVertices * 4 * sizeof(uint16) + CacheNode.NumIndexBytes + InstanceDataSize;
+        return (int64)CacheNode.NumVertices * (sizeof(FVector3f) + sizeof(FPackedNormal)) + (int64)CacheNode.NumIndices * sizeof(uint32) + InstanceDataSize;
+    }
+
+    template<typename ElementType>
+    const uint8* CopyToArray(const uint8* Data, int32 Num, TArray<ElementType>& OutArray)
+    {
+        OutArray.SetNumUninitialized(Num);
+        FMemory::Memcpy(OutArray.GetData(), Data, Num * sizeof(ElementType));
+        return Data + Num * sizeof(ElementType);
+    }
+
+    template<typename ElementType>
+    void WriteArray(FArchive& Writer, const TArray<ElementType>& Array)
+    {
+        Writer.Serialize((void*)Array.GetData(), Array.Num() * sizeof(ElementType));
+    }
+}
+
+FString GetGeometryCacheFilePathName(const FString& SourceFilePathName)
+{
+    //不同目录下的同名文件通过完整路径的哈希区分
+    FString FullPathName = FPaths::ConvertRelativePathToFull(SourceFilePathName);
+    FTCHARToUTF8 PathUTF8(*FullPathName);
+    uint64 PathHash = CityHash64(PathUTF8.Get(), PathUTF8.Length());
+    FString CacheFileName = FString::Printf(TEXT("%s_%016llx.xspc"), *FPaths::GetBaseFilename(SourceFilePathName), PathHash);
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("XSPCache"), CacheFileName);
+}
+
+uint64 ComputeGeometryCacheSourceHash(const FXSPMappedFile& SourceFile)
+{
+    //只对头信息表做内容哈希,几何数据的变化由文件大小与修改时间反映,避免热启动时通读整个源文件
+    int64 Values[2];
+    Values[0] = SourceFile.GetSize();
+    Values[1] = IFileManager::Get().GetTimeStamp(*SourceFile.GetFilePathName()).GetTicks();
+    uint64 Hash = CityHash64((const char*)Values, sizeof(Values));
+
+    int64 HeaderTableSize = (int64)ReadNumNodes(SourceFile) * XSPHeaderInfoSize + XSPFileHeaderSize;
+    const char* Data = (const char*)SourceFile.GetData();
+    for (int64 Position = 0; Position < HeaderTableSize; )
+    {
+        uint32 Length = (uint32)FMath::Min<int64>(HeaderTableSize - Position, MAX_int32);
+        Hash = CityHash64WithSeed(Data + Position, Length, Hash);
+        Position += Length;
+    }
+    return Hash;
+}
+
+bool LoadGeometryCache(const FString& CacheFilePathName, uint64 SourceHash, int32 Offset, int32 NumNodes, TArray<FXSPNodeData*>& OutNodeDataArray, TBitArray<>& OutLeafFlags)
+{
+    if (!IFileManager::Get().FileExists(*CacheFilePathName))
+        return false;
+
+    FXSPMappedFile CacheFile;
+    if (!CacheFile.Open(CacheFilePathName))
+        return false;
+
+    FXSPGeometryCacheHeader Header;
+    if (!CacheFile.Read(0, Header) ||
+        Header.Magic != GeometryCacheMagic ||
+        Header.Version != GeometryCacheVersion ||
+        Header.SourceHash != SourceHash ||
+        Header.SettingsHash != GetResolveSettingsHash() ||
+        Header.NumNodes != NumNodes)
+    {
+        UE_LOG(LogXSPGeometryCache, Display, TEXT("几何缓存已失效: %s"), *CacheFilePathName);
+        return false;
+    }
+
+    const int64 NodeTableOffset = sizeof(FXSPGeometryCacheHeader);
+    if (!CacheFile.IsValidRange(NodeTableOffset, (int64)NumNodes * sizeof(FXSPGeometryCacheNode)))
+        return false;
+
+    //先校验全部节点的数据范围,保证后续拷贝不会越界
+    const FXSPGeometryCacheNode* CacheNodes = (const FXSPGeometryCacheNode*)(CacheFile.GetData() + NodeTableOffset);
+    for (int32 j = 0; j < NumNodes; j++)
+    {
+        const FXSPGeometryCacheNode& CacheNode = CacheNodes[j];
+        if (CacheNode.NumVertices < 0 || CacheNode.NumIndices < 0 || CacheNode.NumIndexBytes < 0 || CacheNode.NumPrimitiveInstances < 0 ||
+            !CacheFile.IsValidRange(CacheNode.DataOffset, GetNodeDataSize(CacheNode)))
+        {
+            UE_LOG(LogXSPGeometryCache, Warning, TEXT("几何缓存已损坏: %s"), *CacheFilePathName);
+            return false;
+        }
+    }
+
+    OutNodeDataArray.SetNumZeroed(NumNodes);
+    OutLeafFlags.Init(false, NumNodes);
+    for (int32 j = 0; j < NumNodes; j++)
+    {
+        OutLeafFlags[j] = (CacheNodes[j].Flags & GCNF_Leaf) != 0;
+    }
+
+    ParallelFor(NumNodes, [&](int32 j) {
+        const FXSPGeometryCacheNode& CacheNode = CacheNodes[j];
+        FXSPNodeData* NodeData = OutNodeDataArray[j] = new FXSPNodeData;
+        NodeData->Dbid = Offset + j;
+        NodeData->ParentDbid = CacheNode.ParentDbid;
+        NodeData->Level = CacheNode.Level;
+        NodeData->NumChildren = CacheNode.LastChildDbid - NodeData->Dbid + 1;
+        FMemory::Memcpy(NodeData->Material, CacheNode.Material, sizeof(NodeData->Material));
+        NodeData->MeshMaterial = FLinearColor(CacheNode.MeshMaterial[0], CacheNode.MeshMaterial[1], CacheNode.MeshMaterial[2], CacheNode.MeshMaterial[3]);
+        if (CacheNode.NumVertices > 0 || CacheNode.NumPrimitiveInstances > 0)
+        {
+            NodeData->MeshBoundingBox = FBox3f(
+                FVector3f(CacheNode.BoundingBoxMin[0], CacheNode.BoundingBoxMin[1], CacheNode.BoundingBoxMin[2]),
+                FVector3f(CacheNode.BoundingBoxMax[0], CacheNode.BoundingBoxMax[1], CacheNode.BoundingBoxMax[2]));
+        }
+
+        //编码的数据原样拷贝,不在加载时解码
+        const uint8* Data = CacheFile.GetData() + CacheNode.DataOffset;
+        if (CacheNode.Flags & GCNF_Encoded)
+        {
+            FXSPEncodedMesh& EncodedMesh = NodeData->EncodedMesh;
+            EncodedMesh.NumVertices = CacheNode.NumVertices;
+            EncodedMesh.NumIndices = CacheNode.NumIndices;
+            EncodedMesh.QuantizationMin = FVector3f(CacheNode.QuantizationMin[0], CacheNode.QuantizationMin[1], CacheNode.QuantizationMin[2]);
+            EncodedMesh.QuantizationStep = FVector3f(CacheNode.QuantizationStep[0], CacheNode.QuantizationStep[1], CacheNode.QuantizationStep[2]);
+            Data = CopyToArray(Data, CacheNode.NumVertices * 3, EncodedMesh.Positions);
+            Data = CopyToArray(Data, CacheNode.NumVertices, EncodedMesh.Normals);
+            Data = CopyToArray(Data, CacheNode.NumIndexBytes, EncodedMesh.Indices);
+        }
+        else
+        {
+            Data = CopyToArray(Data, CacheNode.NumVertices, NodeData->MeshPositionArray);
+            Data = CopyToArray(Data, CacheNode.NumVertices, NodeData->MeshNormalArray);
+            Data = CopyToArray(Data, CacheNode.NumIndices, NodeData->MeshIndexArray);
+        }
+        if (CacheNode.NumPrimitiveInstances > 0)
+        {
+            CopyToArray(Data, CacheNode.NumPrimitiveInstances, NodeData->PrimitiveInstanceArray);
+        }
+    }, EParallelForFlags::Unbalanced);
+
+    return true;
+}
+
+bool SaveGeometryCache(const FString& CacheFilePathName, uint64 SourceHash, const TArray<FXSPNodeData*>& NodeDataArray, const TBitArray<>& LeafFlags)
+{
+    int32 NumNodes = NodeDataArray.Num();
+    check(LeafFlags.Num() == NumNodes);
+
+    FXSPGeometryCacheHeader Header;
+    Header.Magic = GeometryCacheMagic;
+    Header.Version = GeometryCacheVersion;
+    Header.SourceHash = SourceHash;
+    Header.SettingsHash = GetResolveSettingsHash();
+    Header.NumNodes = NumNodes;
+
+    TArray<FXSPGeometryCacheNode> CacheNodes;
+    CacheNodes.SetNumZeroed(NumNodes);
+    int64 DataOffset = sizeof(FXSPGeometryCacheHeader) + (int64)NumNodes * sizeof(FXSPGeometryCacheNode);
+    for (int32 j = 0; j < NumNodes; j++)
+    {
+        const FXSPNodeData* NodeData = NodeDataArray[j];
+        FXSPGeometryCacheNode& CacheNode = CacheNodes[j];
+        CacheNode.ParentDbid = NodeData->ParentDbid;
+        CacheNode.Level = NodeData->Level;
+        CacheNode.LastChildDbid = NodeData->Dbid + NodeData->NumChildren - 1;
+        CacheNode.Flags = LeafFlags[j] ? GCNF_Leaf : 0;
+        FMemory::Memcpy(CacheNode.Material, NodeData->Material, sizeof(CacheNode.Material));
+        CacheNode.MeshMaterial[0] = NodeData->MeshMaterial.R;
+        CacheNode.MeshMaterial[1] = NodeData->MeshMaterial.G;
+        CacheNode.MeshMaterial[2] = NodeData->MeshMaterial.B;
+        CacheNode.MeshMaterial[3] = NodeData->MeshMaterial.A;
+        for (int32 Axis = 0; Axis < 3; Axis++)
+        {
+            CacheNode.BoundingBoxMin[Axis] = NodeData->MeshBoundingBox.Min[Axis];
+            CacheNode.BoundingBoxMax[Axis] = NodeData->MeshBoundingBox.Max[Axis];
+        }
+        CacheNode.NumVertices = NodeData->GetNumVertices();
+        CacheNode.NumIndices = NodeData->GetNumIndices();
+        CacheNode.NumPrimitiveInstances = NodeData->PrimitiveInstanceArray.Num();
+        if (!NodeData->EncodedMesh.IsEmpty())
+        {
+            const FXSPEncodedMesh& EncodedMesh = NodeData->EncodedMesh;
+            CacheNode.Flags |= GCNF_Encoded;
+            for (int32 Axis = 0; Axis < 3; Axis++)
+            {
+                CacheNode.QuantizationMin[Axis] = EncodedMesh.QuantizationMin[Axis];
+                CacheNode.QuantizationStep[Axis] = EncodedMesh.QuantizationStep[Axis];
+            }
+            CacheNode.NumIndexBytes = EncodedMesh.Indices.Num();
+        }
+        CacheNode.DataOffset = DataOffset;
+        DataOffset += GetNodeDataSize(CacheNode);
+    }
+
+    FString TempFilePathName = CacheFilePathName + TEXT(".tmp");
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempFilePathName));
+    if (!Writer.IsValid())
+    {
+        UE_LOG(LogXSPGeometryCache, Warning, TEXT("无法写入几何缓存: %s"), *TempFilePathName);
+        return false;
+    }
+
+    Writer->Serialize(&Header, sizeof(Header));
+    Writer->Serialize(CacheNodes.GetData(), (int64)NumNodes * sizeof(FXSPGeometryCacheNode));
+    for (const FXSPNodeData* NodeData : NodeDataArray)
+    {
+        if (!NodeData->EncodedMesh.IsEmpty())
+        {
+            WriteArray(*Writer, NodeData->EncodedMesh.Positions);
+            WriteArray(*Writer, NodeData->EncodedMesh.Normals);
+            WriteArray(*Writer, NodeData->EncodedMesh.Indices);
+        }
+        else
+        {
+            WriteArray(*Writer, NodeData->MeshPositionArray);
+            WriteArray(*Writer, NodeData->MeshNormalArray);
+            WriteArray(*Writer, NodeData->MeshIndexArray);
+        }
+        WriteArray(*Writer, NodeData->PrimitiveInstanceArray);
+    }
+    bool bSuccess = Writer->Close() && !Writer->IsError();
+    Writer.Reset();
+
+    if (!bSuccess || !IFileManager::Get().Move(*CacheFilePathName, *TempFilePathName, true, true))
+    {
+        UE_LOG(LogXSPGeometryCache, Warning, TEXT("无法写入几何缓存: %s"), *CacheFilePathName);
+        IFileManager::Get().Delete(*TempFilePathName);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "XSPDataStruct.h"
+
+class FXSPMappedFile;
+
+/**
+预处理几何缓存(.xspc): 保存源文件每个节点经ResolveNodeData生成的最终数据,再次加载同一文件时直接拷贝到FXSPNodeData
+文件布局:
+	FXSPGeometryCacheHeader
+	FXSPGeometryCacheNode[NumNodes]		--按局部dbid顺序排列
+	几何数据区							--各节点的顶点、法线、索引依次紧密排列,已编码的节点保存编码后的数据(见XSPMeshCodec.h)
+缓存以源文件哈希与影响网格生成的xsp.*控制台变量哈希为键,任一不匹配则缓存失效
+*/
+
+//源文件对应的缓存文件路径(位于Saved/XSPCache目录)
+FString GetGeometryCacheFilePathName(const FString& SourceFilePathName);
+
+//源文件哈希(文件大小、修改时间与完整的节点头信息表)
+uint64 ComputeGeometryCacheSourceHash(const FXSPMappedFile& SourceFile);
+
+//读取缓存,成功时输出全部节点数据与叶子节点标记
+bool LoadGeometryCache(const FString& CacheFilePathName, uint64 SourceHash, int32 Offset, int32 NumNodes, TArray<FXSPNodeData*>& OutNodeDataArray, TBitArray<>& OutLeafFlags);
+
+//写入缓存(先写临时文件再替换,避免留下不完整的缓存)
+bool SaveGeometryCache(const FString& CacheFilePathName, uint64 SourceHash, const TArray<FXSPNodeData*>& NodeDataArray, const TBitArray<>& LeafFlags);
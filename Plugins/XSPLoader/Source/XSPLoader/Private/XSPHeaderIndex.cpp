@@ -0,0 +1,184 @@
+#include "XSPHeaderIndex.h"
+#include "XSPFileUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Async/ParallelFor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPHeaderIndex, Log, All);
+
+
+namespace
+{
+    static const uint32 HeaderIndexMagic = 0x49505358;   //'XSPI'
+    static const uint32 HeaderIndexVersion = 1;
+
+    struct FXSPHeaderIndexFileHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        int64 SourceSize;
+        int64 SourceTimeStamp;
+        int32 NumNodes;
+        int32 Padding;
+    };
+
+    void GetSourceKey(const FString& SourceFilePathName, int64& OutSize, int64& OutTimeStamp)
+    {
+        OutSize = IFileManager::Get().FileSize(*SourceFilePathName);
+        OutTimeStamp = IFileManager::Get().GetTimeStamp(*SourceFilePathName).GetTicks();
+    }
+
+    void DecodeEntry(const FXSPMappedFile& SourceFile, const Header_info& Header, FXSPHeaderIndexEntry& Entry)
+    {
+        Entry.ParentDbid = Header.parentdbid;
+        Entry.Level = Header.level;
+        Entry.EmptyFragment = Header.empty_fragment;
+        Entry.LastChildDbid = Header.offset;
+        Entry.StartName = Header.startname;
+        Entry.NameLength = Header.namelength;
+        Entry.StartProperty = Header.startproperty;
+        Entry.PropertyLength = Header.propertylength;
+        Entry.StartMaterial = Header.startmaterial;
+        Entry.StartBox = Header.startbox;
+        Entry.StartVertices = Header.startvertices;
+        Entry.VerticesLength = Header.verticeslength;
+
+        //与网格数据相同的坐标转换: 交换X、Y并由米转为厘米
+        float Box[6];
+        if (SourceFile.Read(Header.startbox, Box))
+        {
+            Entry.BoxMin[0] = Box[1] * 100; Entry.BoxMin[1] = Box[0] * 100; Entry.BoxMin[2] = Box[2] * 100;
+            Entry.BoxMax[0] = Box[4] * 100; Entry.BoxMax[1] = Box[3] * 100; Entry.BoxMax[2] = Box[5] * 100;
+        }
+        else
+        {
+            for (int32 Axis = 0; Axis < 3; Axis++)
+            {
+                Entry.BoxMin[Axis] = MAX_flt;
+                Entry.BoxMax[Axis] = -MAX_flt;
+            }
+        }
+    }
+}
+
+void FXSPHeaderIndexEntry::GetHeaderInfo(Header_info& OutHeader) const
+{
+    OutHeader.empty_fragment = EmptyFragment;
+    OutHeader.parentdbid = ParentDbid;
+    OutHeader.level = Level;
+    OutHeader.startname = StartName;
+    OutHeader.namelength = NameLength;
+    OutHeader.startproperty = StartProperty;
+    OutHeader.propertylength = PropertyLength;
+    OutHeader.startmaterial = StartMaterial;
+    OutHeader.startbox = StartBox;
+    OutHeader.startvertices = StartVertices;
+    OutHeader.verticeslength = VerticesLength;
+    OutHeader.offset = LastChildDbid;
+}
+
+FString FXSPHeaderIndex::GetIndexFilePathName(const FString& SourceFilePathName)
+{
+    return FPaths::ChangeExtension(SourceFilePathName, TEXT("xspidx"));
+}
+
+bool FXSPHeaderIndex::Open(const FString& SourceFilePathName)
+{
+    Close();
+
+    int64 SourceSize, SourceTimeStamp;
+    GetSourceKey(SourceFilePathName, SourceSize, SourceTimeStamp);
+    if (SourceSize < 0)
+        return false;
+
+    FString IndexFilePathName = GetIndexFilePathName(SourceFilePathName);
+    if (IFileManager::Get().FileExists(*IndexFilePathName) && IndexFile.Open(IndexFilePathName))
+    {
+        FXSPHeaderIndexFileHeader Header;
+        if (IndexFile.Read(0, Header) &&
+            Header.Magic == HeaderIndexMagic &&
+            Header.Version == HeaderIndexVersion &&
+            Header.SourceSize == SourceSize &&
+            Header.SourceTimeStamp == SourceTimeStamp &&
+            Header.NumNodes >= 0 &&
+            IndexFile.IsValidRange(sizeof(Header), (int64)Header.NumNodes * sizeof(FXSPHeaderIndexEntry)))
+        {
+            Entries = (const FXSPHeaderIndexEntry*)(IndexFile.GetData() + sizeof(Header));
+            NumEntries = Header.NumNodes;
+            return true;
+        }
+
+        UE_LOG(LogXSPHeaderIndex, Display, TEXT("头信息索引已失效: %s"), *IndexFilePathName);
+        IndexFile.Close();
+    }
+
+    //首次使用时生成
+    if (!Build(SourceFilePathName, BuiltEntries))
+        return false;
+
+    Save(SourceFilePathName, BuiltEntries);
+    Entries = BuiltEntries.GetData();
+    NumEntries = BuiltEntries.Num();
+    return true;
+}
+
+void FXSPHeaderIndex::Close()
+{
+    IndexFile.Close();
+    BuiltEntries.Empty();
+    Entries = nullptr;
+    NumEntries = 0;
+}
+
+bool FXSPHeaderIndex::Build(const FString& SourceFilePathName, TArray<FXSPHeaderIndexEntry>& OutEntries)
+{
+    FXSPMappedFile SourceFile;
+    if (!SourceFile.Open(SourceFilePathName))
+        return false;
+
+    int64 BeginTicks = FDateTime::Now().GetTicks();
+
+    int32 NumNodes = ReadNumNodes(SourceFile);
+    OutEntries.SetNumUninitialized(NumNodes);
+    ParallelFor(NumNodes, [&](int32 j) {
+        Header_info Header;
+        verify(ReadHeaderInfo(SourceFile, XSPFileHeaderSize + j * XSPHeaderInfoSize, Header));
+        DecodeEntry(SourceFile, Header, OutEntries[j]);
+    });
+
+    UE_LOG(LogXSPHeaderIndex, Display, TEXT("生成头信息索引: %s, 节点数%d, 耗时%.2f秒"), *SourceFilePathName, NumNodes,
+        (float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond);
+    return true;
+}
+
+bool FXSPHeaderIndex::Save(const FString& SourceFilePathName, const TArray<FXSPHeaderIndexEntry>& InEntries)
+{
+    FXSPHeaderIndexFileHeader Header;
+    Header.Magic = HeaderIndexMagic;
+    Header.Version = HeaderIndexVersion;
+    GetSourceKey(SourceFilePathName, Header.SourceSize, Header.SourceTimeStamp);
+    Header.NumNodes = InEntries.Num();
+    Header.Padding = 0;
+
+    FString IndexFilePathName = GetIndexFilePathName(SourceFilePathName);
+    FString TempFilePathName = IndexFilePathName + TEXT(".tmp");
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempFilePathName));
+    if (!Writer.IsValid())
+    {
+        UE_LOG(LogXSPHeaderIndex, Warning, TEXT("无法写入头信息索引: %s"), *TempFilePathName);
+        return false;
+    }
+
+    Writer->Serialize(&Header, sizeof(Header));
+    Writer->Serialize((void*)InEntries.GetData(), (int64)InEntries.Num() * sizeof(FXSPHeaderIndexEntry));
+    bool bSuccess = Writer->Close() && !Writer->IsError();
+    Writer.Reset();
+
+    if (!bSuccess || !IFileManager::Get().Move(*IndexFilePathName, *TempFilePathName, true, true))
+    {
+        UE_LOG(LogXSPHeaderIndex, Warning, TEXT("无法写入头信息索引: %s"), *IndexFilePathName);
+        IFileManager::Get().Delete(*TempFilePathName);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "XSPDataStruct.h"
+#include "XSPMappedFile.h"
+
+/**
+节点头信息索引(.xspidx): 源文件头信息表解码后的紧凑副本,加上每个节点的包围盒,与源文件放在同一目录
+文件布局:
+	FXSPHeaderIndexFileHeader
+	FXSPHeaderIndexEntry[NumNodes]		--按局部dbid顺序排列
+以源文件大小与修改时间为键,不匹配时重新生成;打开时只映射索引文件,不需要打开源文件
+*/
+
+struct FXSPHeaderIndexEntry
+{
+	//父节点全局dbid
+	int32 ParentDbid;
+	int16 Level;
+	//1为有fragment 2为没有fragment
+	int16 EmptyFragment;
+	//子树中最后一个节点的全局dbid(即头信息中的offset)
+	int32 LastChildDbid;
+
+	//源文件中各数据段的字节范围
+	int32 StartName;
+	int32 NameLength;
+	int32 StartProperty;
+	int32 PropertyLength;
+	int32 StartMaterial;
+	int32 StartBox;
+	int32 StartVertices;
+	int32 VerticesLength;
+
+	//包围盒(已转换到引擎坐标),源文件中没有包围盒时Min大于Max
+	float BoxMin[3];
+	float BoxMax[3];
+
+	void GetHeaderInfo(Header_info& OutHeader) const;
+
+	bool HasBoundingBox() const
+	{
+		return BoxMin[0] <= BoxMax[0];
+	}
+
+	FBox3f GetBoundingBox() const
+	{
+		return FBox3f(FVector3f(BoxMin[0], BoxMin[1], BoxMin[2]), FVector3f(BoxMax[0], BoxMax[1], BoxMax[2]));
+	}
+};
+
+class FXSPHeaderIndex
+{
+public:
+	FXSPHeaderIndex() = default;
+
+	FXSPHeaderIndex(const FXSPHeaderIndex&) = delete;
+	FXSPHeaderIndex& operator=(const FXSPHeaderIndex&) = delete;
+
+	//打开源文件对应的索引,不存在或已失效时由源文件生成;索引文件无法写入时在内存中保留生成的结果
+	bool Open(const FString& SourceFilePathName);
+	void Close();
+
+	bool IsOpen() const { return nullptr != Entries; }
+	int32 Num() const { return NumEntries; }
+
+	const FXSPHeaderIndexEntry& operator[](int32 LocalDbid) const
+	{
+		check(LocalDbid >= 0 && LocalDbid < NumEntries);
+		return Entries[LocalDbid];
+	}
+
+	//源文件对应的索引文件路径
+	static FString GetIndexFilePathName(const FString& SourceFilePathName);
+
+	//由源文件生成索引数据
+	static bool Build(const FString& SourceFilePathName, TArray<FXSPHeaderIndexEntry>& OutEntries);
+
+	//生成并写入索引文件(先写临时文件再替换)
+	static bool Save(const FString& SourceFilePathName, const TArray<FXSPHeaderIndexEntry>& Entries);
+
+private:
+	FXSPMappedFile IndexFile;
+	TArray<FXSPHeaderIndexEntry> BuiltEntries;
+	const FXSPHeaderIndexEntry* Entries = nullptr;
+	int32 NumEntries = 0;
+};
@@ -0,0 +1,62 @@
+#include "XSPInstancedPrimitiveComponent.h"
+
+UXSPInstancedPrimitiveComponent::UXSPInstancedPrimitiveComponent()
+{
+    PrimaryComponentTick.bCanEverTick = false;
+    bHasNoStreamableTextures = true;
+    //移除时以末尾实例填补空位,避免移动其后的全部实例
+    bSupportRemoveAtSwap = true;
+}
+
+UXSPInstancedPrimitiveComponent::~UXSPInstancedPrimitiveComponent()
+{
+}
+
+void UXSPInstancedPrimitiveComponent::AddNodeInstances(const TArray<int32>& InInstanceDbidArray, const TArray<FTransform>& InstanceTransforms)
+{
+    check(InInstanceDbidArray.Num() == InstanceTransforms.Num());
+    TArray<int32> InstanceIndices = AddInstances(InstanceTransforms, true);
+    check(InstanceIndices.Num() == InInstanceDbidArray.Num());
+    InstanceDbidArray.SetNumUninitialized(GetInstanceCount());
+    for (int32 i = 0; i < InstanceIndices.Num(); i++)
+    {
+        InstanceDbidArray[InstanceIndices[i]] = InInstanceDbidArray[i];
+        NodeInstanceMap.FindOrAdd(InInstanceDbidArray[i]).Add(InstanceIndices[i]);
+    }
+}
+
+void UXSPInstancedPrimitiveComponent::RemoveNodeInstances(const TArray<int32>& DbidArray)
+{
+    TArray<int32> InstancesToRemove;
+    for (int32 Dbid : DbidArray)
+    {
+        TArray<int32> InstanceIndices;
+        if (NodeInstanceMap.RemoveAndCopyValue(Dbid, InstanceIndices))
+        {
+            InstancesToRemove.Append(InstanceIndices);
+        }
+    }
+    if (InstancesToRemove.Num() == 0)
+        return;
+
+    RemoveInstances(InstancesToRemove);
+
+    //与引擎相同,按序号从大到小以末尾实例填补空位,同步更新被移动实例的序号
+    InstancesToRemove.Sort(TGreater<int32>());
+    for (int32 InstanceIndex : InstancesToRemove)
+    {
+        int32 LastIndex = InstanceDbidArray.Num() - 1;
+        if (InstanceIndex != LastIndex)
+        {
+            int32 MovedDbid = InstanceDbidArray[LastIndex];
+            NodeInstanceMap[MovedDbid][NodeInstanceMap[MovedDbid].Find(LastIndex)] = InstanceIndex;
+        }
+        InstanceDbidArray.RemoveAtSwap(InstanceIndex, 1, false);
+    }
+    check(InstanceDbidArray.Num() == GetInstanceCount());
+}
+
+int32 UXSPInstancedPrimitiveComponent::GetNode(int32 InstanceIndex) const
+{
+    return InstanceDbidArray.IsValidIndex(InstanceIndex) ? InstanceDbidArray[InstanceIndex] : -1;
+}
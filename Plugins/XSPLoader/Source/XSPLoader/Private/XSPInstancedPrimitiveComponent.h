@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "XSPInstancedPrimitiveComponent.generated.h"
+
+//以共享的单位网格体绘制一组圆柱体或椭圆形实例,每个实例记录所属节点以便拾取
+UCLASS()
+class UXSPInstancedPrimitiveComponent : public UInstancedStaticMeshComponent
+{
+    GENERATED_BODY()
+
+public:
+    UXSPInstancedPrimitiveComponent();
+    virtual ~UXSPInstancedPrimitiveComponent();
+
+    //批量添加实例,InstanceDbidArray为各实例所属的节点
+    void AddNodeInstances(const TArray<int32>& InstanceDbidArray, const TArray<FTransform>& InstanceTransforms);
+
+    //批量移除节点的全部实例,不含实例的节点忽略
+    void RemoveNodeInstances(const TArray<int32>& DbidArray);
+
+    //由实例序号(拾取结果的FHitResult::Item)查询节点
+    int32 GetNode(int32 InstanceIndex) const;
+
+private:
+    //各实例所属的节点,与实例数组同序
+    TArray<int32> InstanceDbidArray;
+
+    //节点到其实例序号的表
+    TMap<int32, TArray<int32>> NodeInstanceMap;
+};
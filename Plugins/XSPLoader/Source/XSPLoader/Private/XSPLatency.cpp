@@ -0,0 +1,130 @@
+#include "XSPLatency.h"
+
+namespace
+{
+    static const TCHAR* LatencyIntervalNames[NumXSPLatencyIntervals] =
+    {
+        TEXT("QueueWait"),
+        TEXT("FileOpen"),
+        TEXT("Decode"),
+        TEXT("BuildWait"),
+        TEXT("Build"),
+        TEXT("MergeWait"),
+        TEXT("Total"),
+    };
+
+    static const double ReportPercentiles[] = { 50, 95, 99 };
+}
+
+void FXSPLatencyHistogram::Add(double Milliseconds)
+{
+    int32 BucketIndex = 0;
+    if (Milliseconds >= MinMilliseconds)
+    {
+        BucketIndex = FMath::FloorToInt32(FMath::Log2(Milliseconds / MinMilliseconds) * NumBucketsPerOctave) + 1;
+        BucketIndex = FMath::Clamp(BucketIndex, 1, NumBuckets - 1);
+    }
+    Counts[BucketIndex]++;
+    NumSamples++;
+    MaxMilliseconds = FMath::Max(MaxMilliseconds, Milliseconds);
+}
+
+void FXSPLatencyHistogram::Reset()
+{
+    FMemory::Memzero(Counts);
+    NumSamples = 0;
+    MaxMilliseconds = 0;
+}
+
+double FXSPLatencyHistogram::GetBucketLowerBound(int32 BucketIndex)
+{
+    return BucketIndex == 0 ? 0 : MinMilliseconds * FMath::Pow(2.0, (double)(BucketIndex - 1) / NumBucketsPerOctave);
+}
+
+double FXSPLatencyHistogram::GetBucketUpperBound(int32 BucketIndex)
+{
+    return MinMilliseconds * FMath::Pow(2.0, (double)BucketIndex / NumBucketsPerOctave);
+}
+
+double FXSPLatencyHistogram::GetPercentile(double Percentile) const
+{
+    if (NumSamples == 0)
+        return 0;
+
+    double Target = FMath::Clamp(Percentile, 0.0, 100.0) / 100.0 * NumSamples;
+    uint32 Cumulative = 0;
+    for (int32 BucketIndex = 0; BucketIndex < NumBuckets; BucketIndex++)
+    {
+        if (Counts[BucketIndex] == 0)
+            continue;
+        if (Cumulative + Counts[BucketIndex] >= Target)
+        {
+            double Alpha = (Target - Cumulative) / Counts[BucketIndex];
+            double Value = FMath::Lerp(GetBucketLowerBound(BucketIndex), GetBucketUpperBound(BucketIndex), Alpha);
+            return FMath::Min(Value, MaxMilliseconds);
+        }
+        Cumulative += Counts[BucketIndex];
+    }
+    return MaxMilliseconds;
+}
+
+void FXSPRequestLatencyStats::AddRequest(const FXSPRequestStageCycles& StageCycles)
+{
+    //相邻阶段的间隔,最后一项为总延迟
+    for (int32 i = 0; i < NumXSPLatencyIntervals - 1; i++)
+    {
+        Histograms[i].Add(FPlatformTime::ToMilliseconds64(StageCycles[i + 1] - StageCycles[i]));
+    }
+    Histograms[NumXSPLatencyIntervals - 1].Add(FPlatformTime::ToMilliseconds64(StageCycles[(int32)EXSPRequestStage::Merged] - StageCycles[(int32)EXSPRequestStage::Enqueued]));
+}
+
+void FXSPRequestLatencyStats::Reset()
+{
+    for (FXSPLatencyHistogram& Histogram : Histograms)
+    {
+        Histogram.Reset();
+    }
+}
+
+const TCHAR* FXSPRequestLatencyStats::GetIntervalName(int32 IntervalIndex)
+{
+    return LatencyIntervalNames[IntervalIndex];
+}
+
+FString FXSPRequestLatencyStats::GetCsvHeader()
+{
+    FString Header = TEXT("Seconds,NumRequests");
+    for (int32 i = 0; i < NumXSPLatencyIntervals; i++)
+    {
+        for (double Percentile : ReportPercentiles)
+        {
+            Header += FString::Printf(TEXT(",%s_p%d"), LatencyIntervalNames[i], (int32)Percentile);
+        }
+    }
+    return Header;
+}
+
+FString FXSPRequestLatencyStats::GetCsvRow(double Seconds) const
+{
+    FString Row = FString::Printf(TEXT("%.3f,%d"), Seconds, GetNumRequests());
+    for (const FXSPLatencyHistogram& Histogram : Histograms)
+    {
+        for (double Percentile : ReportPercentiles)
+        {
+            Row += FString::Printf(TEXT(",%.3f"), Histogram.GetPercentile(Percentile));
+        }
+    }
+    return Row;
+}
+
+FString FXSPRequestLatencyStats::GetSummary() const
+{
+    const FXSPLatencyHistogram& Total = Histograms[NumXSPLatencyIntervals - 1];
+    FString Summary = FString::Printf(TEXT("完成加载 %d 个, 总延迟(ms) p50 %.1f p95 %.1f p99 %.1f, 各阶段p95:"),
+        Total.Num(), Total.GetPercentile(50), Total.GetPercentile(95), Total.GetPercentile(99));
+    for (int32 i = 0; i < NumXSPLatencyIntervals - 1; i++)
+    {
+        Summary += FString::Printf(TEXT(" %s %.1f"), LatencyIntervalNames[i], Histograms[i].GetPercentile(95));
+    }
+    return Summary;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+加载请求流水线的延迟统计:
+	请求在生命周期的各阶段记录时刻(见FXSPLoader中Request生命周期的说明),完成时将相邻阶段的间隔加入直方图
+	直方图按对数分桶,只保存计数,可随时取p50/p95/p99
+*/
+
+//请求生命周期中记录时刻的阶段
+enum class EXSPRequestStage : uint8
+{
+	Enqueued,		//投入读取队列
+	Taken,			//被读取线程取出
+	FileOpened,		//源文件已映射
+	Decoded,		//ReadBodyInfo完成(映射页面的实际读取发生在此阶段)
+	BuildStarted,	//构建任务开始执行
+	Built,			//网格体构建完成
+	Merged,			//Game线程设置给组件
+	Num
+};
+
+//相邻阶段之间的间隔,最后一项为从投入队列到设置给组件的总延迟
+constexpr int32 NumXSPLatencyIntervals = (int32)EXSPRequestStage::Num;
+
+typedef uint64 FXSPRequestStageCycles[(int32)EXSPRequestStage::Num];
+
+//对数分桶的延迟直方图(毫秒)
+class FXSPLatencyHistogram
+{
+public:
+	void Add(double Milliseconds);
+
+	void Reset();
+
+	int32 Num() const { return NumSamples; }
+
+	//第Percentile(0~100)百分位的延迟,在桶内线性插值;没有样本时返回0
+	double GetPercentile(double Percentile) const;
+
+	double GetMax() const { return MaxMilliseconds; }
+
+private:
+	//每个2倍区间分为4个桶,覆盖0.01毫秒到约80秒,超出的计入最后一个桶
+	static constexpr int32 NumBucketsPerOctave = 4;
+	static constexpr int32 NumBuckets = 23 * NumBucketsPerOctave + 1;
+	static constexpr double MinMilliseconds = 0.01;
+
+	static double GetBucketLowerBound(int32 BucketIndex);
+	static double GetBucketUpperBound(int32 BucketIndex);
+
+	uint32 Counts[NumBuckets] = {};
+	int32 NumSamples = 0;
+	double MaxMilliseconds = 0;
+};
+
+//各阶段间隔的直方图,只在Game线程使用
+class FXSPRequestLatencyStats
+{
+public:
+	//请求完成时加入其各阶段的间隔
+	void AddRequest(const FXSPRequestStageCycles& StageCycles);
+
+	void Reset();
+
+	int32 GetNumRequests() const { return Histograms[NumXSPLatencyIntervals - 1].Num(); }
+
+	const FXSPLatencyHistogram& GetHistogram(int32 IntervalIndex) const { return Histograms[IntervalIndex]; }
+
+	static const TCHAR* GetIntervalName(int32 IntervalIndex);
+
+	//CSV的表头与一行数据(各间隔的p50/p95/p99)
+	static FString GetCsvHeader();
+	FString GetCsvRow(double Seconds) const;
+
+	//一行摘要,用于日志与屏幕输出
+	FString GetSummary() const;
+
+private:
+	FXSPLatencyHistogram Histograms[NumXSPLatencyIntervals];
+};
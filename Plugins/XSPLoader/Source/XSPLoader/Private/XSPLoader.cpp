@@ -1,9 +1,100 @@
 #include "XSPLoader.h"
 #include "XSPFileUtils.h"
 #include "MeshUtils.h"
+#include "XSPStat.h"
+#include "Algo/BinarySearch.h"
+#include "XSPLoaderModule.h"
+#include "HAL/FileManager.h"
+#include "UObject/Package.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogXSPLoader, Log, All);
 
+int32 XSPNumIOThreads = 4;
+FAutoConsoleVariableRef CVarXSPNumIOThreads(
+    TEXT("xsp.NumIOThreads"),
+    XSPNumIOThreads,
+    TEXT("FXSPLoader读取线程池的线程数(在Init时生效)，缺省为4")
+);
+
+int32 XSPMaxOpenFiles = 64;
+FAutoConsoleVariableRef CVarXSPMaxOpenFiles(
+    TEXT("xsp.MaxOpenFiles"),
+    XSPMaxOpenFiles,
+    TEXT("FXSPLoader同时映射的源文件数上限，缺省为64")
+);
+
+int32 XSPLoaderBodyCacheBudgetMB = 512;
+FAutoConsoleVariableRef CVarXSPLoaderBodyCacheBudgetMB(
+    TEXT("xsp.LoaderBodyCacheBudgetMB"),
+    XSPLoaderBodyCacheBudgetMB,
+    TEXT("FXSPLoader缓存的节点数据总量上限(MB)，超出时淘汰最久未使用的节点数据，0为不限制，缺省为512")
+);
+
+int32 XSPLoaderMeshBudgetMB = 1024;
+FAutoConsoleVariableRef CVarXSPLoaderMeshBudgetMB(
+    TEXT("xsp.LoaderMeshBudgetMB"),
+    XSPLoaderMeshBudgetMB,
+    TEXT("FXSPLoader设置给组件的网格体显存总量上限(MB)，超出时从组件上移除最久未被请求的网格体，0为不限制，缺省为1024")
+);
+
+int32 XSPLoaderMaxReprioritizePerTick = 256;
+FAutoConsoleVariableRef CVarXSPLoaderMaxReprioritizePerTick(
+    TEXT("xsp.LoaderMaxReprioritizePerTick"),
+    XSPLoaderMaxReprioritizePerTick,
+    TEXT("设置视点后FXSPLoader每帧按视点重新计算优先级的请求数上限，缺省为256")
+);
+
+bool bXSPLoaderPrefetch = false;
+FAutoConsoleVariableRef CVarXSPLoaderPrefetch(
+    TEXT("xsp.LoaderPrefetch"),
+    bXSPLoaderPrefetch,
+    TEXT("设置视点后FXSPLoader是否按相机运动预取前方节点的数据，缺省为false")
+);
+
+float XSPLoaderPrefetchSeconds = 1.0f;
+FAutoConsoleVariableRef CVarXSPLoaderPrefetchSeconds(
+    TEXT("xsp.LoaderPrefetchSeconds"),
+    XSPLoaderPrefetchSeconds,
+    TEXT("预取时按相机速度外推的秒数，缺省为1")
+);
+
+int32 XSPLoaderMaxPrefetchPerTick = 64;
+FAutoConsoleVariableRef CVarXSPLoaderMaxPrefetchPerTick(
+    TEXT("xsp.LoaderMaxPrefetchPerTick"),
+    XSPLoaderMaxPrefetchPerTick,
+    TEXT("每帧最多发出的预取请求数，缺省为64")
+);
+
+float XSPLoaderPrefetchMinScreenSize = 0.02f;
+FAutoConsoleVariableRef CVarXSPLoaderPrefetchMinScreenSize(
+    TEXT("xsp.LoaderPrefetchMinScreenSize"),
+    XSPLoaderPrefetchMinScreenSize,
+    TEXT("预取节点在预测视点屏幕上的最小投影大小，缺省为0.02")
+);
+
+float XSPLoaderLatencyReportSeconds = 5.0f;
+FAutoConsoleVariableRef CVarXSPLoaderLatencyReportSeconds(
+    TEXT("xsp.LoaderLatencyReportSeconds"),
+    XSPLoaderLatencyReportSeconds,
+    TEXT("FXSPLoader输出加载延迟统计(stat与摘要日志)的间隔秒数，0为不输出，缺省为5")
+);
+
+bool bXSPLoaderLatencyCsv = false;
+FAutoConsoleVariableRef CVarXSPLoaderLatencyCsv(
+    TEXT("xsp.LoaderLatencyCsv"),
+    bXSPLoaderLatencyCsv,
+    TEXT("输出加载延迟统计时是否同时追加到Saved/Profiling/XSPLoaderLatency.csv，缺省为false")
+);
+
+bool bXSPLoaderBuildRenderDataDirectly = true;
+FAutoConsoleVariableRef CVarXSPLoaderBuildRenderDataDirectly(
+    TEXT("xsp.LoaderBuildRenderDataDirectly"),
+    bXSPLoaderBuildRenderDataDirectly,
+    TEXT("FXSPLoader是否直接生成渲染数据(否则经由FMeshDescription构建)，缺省为true")
+);
+
 
 void FStaticMeshRequest::Invalidate()
 {
@@ -15,53 +106,295 @@ bool FStaticMeshRequest::IsRequestCurrent(uint64 FrameNumber)
     return bValid && (FrameNumber - LastUpdateFrameNumber < 10);
 }
 
+namespace
+{
+    //每次出队时顺带检查是否过期的元素数
+    static const int32 NumExpireChecksPerTake = 4;
+
+    //视锥外节点的优先级系数,使视锥内的节点先加载,视锥外的近处节点仍先于远处节点
+    static const float OutOfViewPriorityScale = 0.1f;
+
+    //预取请求的优先级系数,使其排在同一帧的普通请求之后
+    static const float PrefetchPriorityScale = 0.01f;
+    //预取候选数相对每帧预取数的倍数,使仍在预测视锥内的已发出预取请求得以保留
+    static const int32 PrefetchCandidateMultiplier = 4;
+    //同一节点两次预取之间的最少帧数
+    static const uint64 PrefetchReissueFrames = 300;
+
+    //优先级变化小于该比例时不重新排序,减少队列加锁
+    static const float ReprioritizeTolerance = 0.05f;
+
+    //超出预算时淘汰到预算的比例,避免每次请求都触发淘汰
+    static const int64 BudgetTrimPercent = 90;
+
+    int64 GetBudgetBytes(int32 BudgetMB)
+    {
+        return BudgetMB > 0 ? (int64)BudgetMB * 1024 * 1024 : MAX_int64;
+    }
+
+    int64 GetBodyInfoDataSize(const Body_info& Body)
+    {
+        int64 Size = Body.name.capacity() + Body.property.capacity() + Body.vertices.capacity() * sizeof(float) + Body.fragment.GetAllocatedSize();
+        for (const Body_info& Fragment : Body.fragment)
+        {
+            Size += GetBodyInfoDataSize(Fragment);
+        }
+        return Size;
+    }
+
+    //按渲染资源的顶点与索引数估算显存: 位置12字节,切线8字节,一套UV4字节
+    int64 GetStaticMeshGPUBytes(UStaticMesh* StaticMesh)
+    {
+        const FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData();
+        if (nullptr == RenderData || RenderData->LODResources.IsEmpty())
+            return 0;
+
+        const FStaticMeshLODResources& LODResources = RenderData->LODResources[0];
+        int64 NumVertices = LODResources.GetNumVertices();
+        int64 NumIndices = (int64)LODResources.GetNumTriangles() * 3;
+        return NumVertices * (12 + 8 + 4) + NumIndices * (NumVertices > MAX_uint16 + 1 ? 4 : 2);
+    }
+}
+
 void FRequestQueue::Add(FStaticMeshRequest* Request)
 {
-    FScopeLock Lock(&RequestListCS);
-    AddNoLock(Request);
+    Add(TArrayView<FStaticMeshRequest* const>(&Request, 1));
+}
+
+void FRequestQueue::Add(TArrayView<FStaticMeshRequest* const> Requests)
+{
+    bool bFirstChanged;
+    {
+        FScopeLock Lock(&RequestListCS);
+        FStaticMeshRequest* PrevFirst = RequestList.IsEmpty() ? nullptr : RequestList[0];
+        AddNoLock(Requests);
+        bFirstChanged = !RequestList.IsEmpty() && RequestList[0] != PrevFirst;
+    }
+
+    //在队列锁外更新就绪堆,与UpdateReadySource的加锁顺序一致
+    if (bFirstChanged && SourceData)
+        Loader->UpdateReadySource(*SourceData);
+
+    if (WorkEvent)
+        WorkEvent->Trigger();
 }
 
-void FRequestQueue::AddNoLock(FStaticMeshRequest* Request)
+void FRequestQueue::AddNoLock(TArrayView<FStaticMeshRequest* const> Requests)
 {
-    RequestList.Emplace(Request);
+    int32 FirstIndex = RequestList.Num();
+    {
+        //与UpdateRequest互斥,保证入堆时读到的排序键是最新的
+        FScopeLock RequestLock(&Loader->RequestCS);
+        for (FStaticMeshRequest* Request : Requests)
+        {
+            check(Request->OwnerQueue.load() == nullptr);
+            Request->OwnerQueue.store(this);
+            Request->HeapIndex = RequestList.Emplace(Request);
+        }
+    }
+    //依次上滤新加入的元素,效果与逐个入堆相同
+    for (int32 Index = FirstIndex; Index < RequestList.Num(); Index++)
+    {
+        SiftUp(Index);
+    }
 }
 
 void FRequestQueue::TakeFirst(FStaticMeshRequest*& Request)
 {
     FScopeLock Lock(&RequestListCS);
+    FindFirst(Request, true);
+}
 
+bool FRequestQueue::PeekFirst(uint64& OutLastUpdateFrameNumber, float& OutPriority)
+{
+    FScopeLock Lock(&RequestListCS);
+    FStaticMeshRequest* Request = nullptr;
+    FindFirst(Request, false);
+    if (nullptr == Request)
+        return false;
+
+    OutLastUpdateFrameNumber = Request->LastUpdateFrameNumber;
+    OutPriority = Request->Priority;
+    return true;
+}
+
+void FRequestQueue::FindFirst(FStaticMeshRequest*& Request, bool bRemove)
+{
     Request = nullptr;
-    if (!RequestList.IsEmpty())
+    uint64 FrameNumber = Loader->FrameNumber.load();
+
+    //增量检查少量元素,使长期未被更新的请求最终被移除
+    for (int32 i = 0; i < NumExpireChecksPerTake && RequestList.Num() > 1; i++)
     {
-        FSortRequestFunctor HighPriority;
+        ExpireCursor = ExpireCursor % RequestList.Num();
+        bool bCurrent;
+        {
+            FScopeLock RequestLock(&Loader->RequestCS);
+            bCurrent = RequestList[ExpireCursor]->IsRequestCurrent(FrameNumber);
+        }
+        if (bCurrent)
+            ExpireCursor++;
+        else
+            ExpireRequestAt(ExpireCursor);
+    }
 
-        uint64 FrameNumber = Loader->FrameNumber.load();
+    //堆顶的时间戳最新,堆顶过期时其余元素大多也已过期
+    while (!RequestList.IsEmpty())
+    {
+        bool bCurrent;
+        {
+            FScopeLock RequestLock(&Loader->RequestCS);
+            bCurrent = RequestList[0]->IsRequestCurrent(FrameNumber);
+        }
+        if (bCurrent)
+        {
+            Request = RequestList[0];
+            if (bRemove)
+                RemoveAt(0);
+            return;
+        }
+        ExpireRequestAt(0);
+    }
+}
+
+void FRequestQueue::ExpireRequestAt(int32 Index)
+{
+    FStaticMeshRequest* Request = RequestList[Index];
+    RemoveAt(Index);
+
+    //过期请求,标记为失效,并从队列中移除
+    {
+        FScopeLock RequestLock(&Loader->RequestCS);
+        Request->Invalidate();
+    }
+    Request->SetReleasable();
+}
+
+void FRequestQueue::SiftUp(int32 Index)
+{
+    FSortRequestFunctor HighPriority;
+    FStaticMeshRequest* Request = RequestList[Index];
+    while (Index > 0)
+    {
+        int32 ParentIndex = (Index - 1) / 2;
+        if (!HighPriority(Request, RequestList[ParentIndex]))
+            break;
+        RequestList[Index] = RequestList[ParentIndex];
+        RequestList[Index]->HeapIndex = Index;
+        Index = ParentIndex;
+    }
+    RequestList[Index] = Request;
+    Request->HeapIndex = Index;
+}
+
+void FRequestQueue::SiftDown(int32 Index)
+{
+    FSortRequestFunctor HighPriority;
+    FStaticMeshRequest* Request = RequestList[Index];
+    int32 Num = RequestList.Num();
+    while (true)
+    {
+        int32 ChildIndex = Index * 2 + 1;
+        if (ChildIndex >= Num)
+            break;
+        if (ChildIndex + 1 < Num && HighPriority(RequestList[ChildIndex + 1], RequestList[ChildIndex]))
+            ChildIndex++;
+        if (!HighPriority(RequestList[ChildIndex], Request))
+            break;
+        RequestList[Index] = RequestList[ChildIndex];
+        RequestList[Index]->HeapIndex = Index;
+        Index = ChildIndex;
+    }
+    RequestList[Index] = Request;
+    Request->HeapIndex = Index;
+}
+
+void FRequestQueue::RemoveAt(int32 Index)
+{
+    FStaticMeshRequest* Request = RequestList[Index];
+    FStaticMeshRequest* Last = RequestList.Pop(false);
+    if (Last != Request)
+    {
+        //用末尾元素填补空位,再向上或向下调整
+        RequestList[Index] = Last;
+        Last->HeapIndex = Index;
+        SiftUp(Index);
+        SiftDown(Last->HeapIndex);
+    }
+    Request->HeapIndex = INDEX_NONE;
+    Request->OwnerQueue.store(nullptr);
+}
 
-        for (FRequestList::TIterator Itr(RequestList); Itr; ++Itr)
+void FRequestQueue::UpdateRequest(FXSPLoader* Loader, FStaticMeshRequest* Request, uint64 LastUpdateFrameNumber, float Priority)
+{
+    while (true)
+    {
+        FRequestQueue* Queue = Request->OwnerQueue.load();
+        if (nullptr == Queue)
         {
+            //不在队列中: 持有RequestCS时确认仍不在队列中,之后入队的一方会读到新的排序键
             FScopeLock RequestLock(&Loader->RequestCS);
-            if ((*Itr)->IsRequestCurrent(FrameNumber))
+            if (nullptr != Request->OwnerQueue.load())
+                continue;
+            Request->bValid = true;
+            Request->LastUpdateFrameNumber = LastUpdateFrameNumber;
+            Request->Priority = Priority;
+            return;
+        }
+
+        bool bFirstChanged;
+        {
+            FScopeLock Lock(&Queue->RequestListCS);
+            //加锁前请求已被移到其他队列时重试
+            if (Request->OwnerQueue.load() != Queue)
+                continue;
             {
-                if (nullptr == Request || HighPriority(*Itr, Request))
-                {
-                    Request = *Itr;
-                }
+                FScopeLock RequestLock(&Loader->RequestCS);
+                Request->bValid = true;
+                Request->LastUpdateFrameNumber = LastUpdateFrameNumber;
+                Request->Priority = Priority;
             }
-            else
-            {
-                FStaticMeshRequest* TheRequest = *Itr;
+            bool bWasFirst = Request->HeapIndex == 0;
+            Queue->SiftUp(Request->HeapIndex);
+            Queue->SiftDown(Request->HeapIndex);
+            bFirstChanged = bWasFirst || Request->HeapIndex == 0;
+        }
+        if (bFirstChanged && Queue->SourceData)
+            Loader->UpdateReadySource(*Queue->SourceData);
+        return;
+    }
+}
 
-                //过期请求,标记为失效,并从队列中移除
-                (*Itr)->Invalidate();
-                (*Itr)->SetReleasable();
-                Itr.RemoveCurrent();
-            }
+bool FRequestQueue::CancelRequest(FXSPLoader* Loader, FStaticMeshRequest* Request)
+{
+    while (true)
+    {
+        FRequestQueue* Queue = Request->OwnerQueue.load();
+        if (nullptr == Queue)
+        {
+            //已被取出或尚未入队: 只置为无效,由处理它的线程放弃
+            FScopeLock RequestLock(&Loader->RequestCS);
+            if (nullptr != Request->OwnerQueue.load())
+                continue;
+            Request->Invalidate();
+            return false;
         }
 
-        if (Request != nullptr)
+        bool bWasFirst;
         {
-            RequestList.Remove(Request);
+            FScopeLock Lock(&Queue->RequestListCS);
+            if (Request->OwnerQueue.load() != Queue)
+                continue;
+            bWasFirst = Request->HeapIndex == 0;
+            Queue->RemoveAt(Request->HeapIndex);
+            {
+                FScopeLock RequestLock(&Loader->RequestCS);
+                Request->Invalidate();
+            }
         }
+        if (bWasFirst && Queue->SourceData)
+            Loader->UpdateReadySource(*Queue->SourceData);
+        return true;
     }
 }
 
@@ -74,121 +407,213 @@ bool FRequestQueue::IsEmpty()
 void FRequestQueue::Empty()
 {
     FScopeLock Lock(&RequestListCS);
+    for (FStaticMeshRequest* Request : RequestList)
+    {
+        Request->HeapIndex = INDEX_NONE;
+        Request->OwnerQueue.store(nullptr);
+    }
     RequestList.Empty();
 }
 
 void FRequestQueue::Swap(FRequestList& OutRequestList)
 {
     FScopeLock Lock(&RequestListCS);
+    for (FStaticMeshRequest* Request : RequestList)
+    {
+        Request->HeapIndex = INDEX_NONE;
+        Request->OwnerQueue.store(nullptr);
+    }
     OutRequestList = MoveTemp(RequestList);
 }
 
 void FBuildStaticMeshTask::DoWork()
 {
-    BuildStaticMesh(Request->StaticMesh.Get(), *NodeData);
-    MergeRequestQueue.Add(Request);
-}
+    Request->MarkStage(EXSPRequestStage::BuildStarted);
 
-FXSPFileLoadRunnalbe::~FXSPFileLoadRunnalbe()
-{
-    for (auto Pair : BodyMap)
+    //排队期间被取消的请求不再构建,仍交给Game线程释放
+    if (Loader->IsRequestAlive(Request))
+    {
+        if (bXSPLoaderBuildRenderDataDirectly)
+            BuildStaticMeshRenderData(Request->StaticMesh.Get(), *NodeData);
+        else
+            BuildStaticMesh(Request->StaticMesh.Get(), *NodeData);
+        Request->bBuilt = true;
+        Request->MarkStage(EXSPRequestStage::Built);
+    }
+    else
     {
-        delete Pair.Value;
+        INC_DWORD_STAT(STAT_XSPLoader_NumLoadRequestAbandoned);
     }
+    Loader->MergeRequestQueue.Enqueue(Request);
 }
 
 uint32 FXSPFileLoadRunnalbe::Run()
 {
-    //读节点头信息
-    FileStream.seekg(0, std::ios::beg);
-    int NumNodes;
-    FileStream.read((char*)&NumNodes, sizeof(NumNodes));
-    check(Count == NumNodes);
-    short headlength;
-    FileStream.read((char*)&headlength, sizeof(headlength));
-    ReadHeaderInfo(FileStream, Count, HeaderList);
-    check(HeaderList.Num() == Count);
-
     //循环等待并执行加载请求
     while (!bStopRequested)
     {
+        FXSPSourceData* SourceData = Loader->ClaimReadySource();
+        if (nullptr == SourceData)
+        {
+            //没有可处理的请求时挂起,直到有新请求加入或线程被停止(在检查之后加入的请求已触发事件,不会错过)
+            Loader->LoadWorkEvent->Wait();
+            continue;
+        }
+
         FStaticMeshRequest* Request = nullptr;
-        LoadRequestQueue.TakeFirst(Request);
+        SourceData->LoadRequestQueue.TakeFirst(Request);
         if (nullptr != Request)
         {
-            //计算全局dbid在本文件中的局部dbid
-            int32 LocalDbid = Request->Dbid - StartDbid;
-            check(LocalDbid >= 0 && LocalDbid < Count);
+            //多次触发自动重置事件只唤醒一个线程,由取到请求的线程继续唤醒下一个线程处理其余请求
+            Loader->LoadWorkEvent->Trigger();
+            ProcessRequest(*SourceData, Request);
+        }
+        Loader->ReleaseSource(*SourceData);
+    }
 
-            //读取Body数据
-            bool bHasCache = true;
-            Body_info* NodeDataPtr = nullptr;
-            if (!BodyMap.Contains(LocalDbid))
-            {
-                bHasCache = false;
-                //读过的节点数据就缓存在内存中
-                NodeDataPtr = new Body_info;
-                ReadBodyInfo(FileStream, HeaderList[LocalDbid], false, *NodeDataPtr);
-                BodyMap.Emplace(LocalDbid, NodeDataPtr);
-            }
-            else
-            {
-                NodeDataPtr = BodyMap[LocalDbid];
-            }
+    //将停止信号传递给其他等待中的线程
+    Loader->LoadWorkEvent->Trigger();
+    return 0;
+}
 
-            if (CheckNode(*NodeDataPtr))
-            {
-                //新读入的节点需要尝试继承上级节点的材质数据
-                int32 LocalParentDbid = NodeDataPtr->parentdbid < 0 ? -1 : NodeDataPtr->parentdbid - StartDbid;
-                if (LocalParentDbid >= 0 && LocalParentDbid < Count)
-                {
-                    Body_info* ParentNodeDataPtr = nullptr;
-                    if (!BodyMap.Contains(LocalParentDbid))
-                    {
-                        ParentNodeDataPtr = new Body_info;
-                        ReadBodyInfo(FileStream, HeaderList[LocalParentDbid], false, *ParentNodeDataPtr);
-                        BodyMap.Emplace(LocalParentDbid, ParentNodeDataPtr);
-                    }
-                    else
-                    {
-                        ParentNodeDataPtr = BodyMap[LocalParentDbid];
-                    }
-                    
-                    InheritMaterial(*NodeDataPtr, *ParentNodeDataPtr);
-                }
-
-                GetMaterial(*NodeDataPtr, Request->Color, Request->Roughness);
-
-                //分发构建网格体的任务到线程池
-                (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(Request, NodeDataPtr, MergeRequestQueue))->StartBackgroundTask();
-            }
-            else
-            {
-                //无网格体的节点请求,置为无效,并加入黑名单
-                {
-                    FScopeLock Lock(&Loader->RequestCS);
-                    Request->Invalidate();
-                }
-                Loader->AddToBlacklist(Request->Dbid);
-                //置为可释放
+void FXSPFileLoadRunnalbe::Stop()
+{
+    bStopRequested = true;
+    Loader->LoadWorkEvent->Trigger();
+}
+
+FBodyInfoPtr FXSPFileLoadRunnalbe::GetBody(FXSPSourceData& SourceData, int32 LocalDbid, bool* bOutCacheHit)
+{
+    uint64 FrameNumber = Loader->FrameNumber.load();
+    FXSPCachedBody* CachedBodyPtr = SourceData.BodyMap.Find(LocalDbid);
+    if (nullptr != bOutCacheHit)
+        *bOutCacheHit = nullptr != CachedBodyPtr;
+    if (nullptr != CachedBodyPtr)
+    {
+        CachedBodyPtr->LastUsedFrameNumber = FrameNumber;
+        return CachedBodyPtr->Body;
+    }
+
+    //源文件打开失败可能是暂时的,不缓存也不计入预算
+    if (!Loader->OpenSourceFile(SourceData))
+        return FBodyInfoPtr();
+
+    FBodyInfoPtr NodeDataPtr = MakeShared<Body_info, ESPMode::ThreadSafe>();
+    Header_info Header;
+    SourceData.HeaderIndex[LocalDbid].GetHeaderInfo(Header);
+    ReadBodyInfo(SourceData.SourceFile, Header, false, *NodeDataPtr);
+
+    FXSPCachedBody& CachedBody = SourceData.BodyMap.Emplace(LocalDbid);
+    CachedBody.Body = NodeDataPtr;
+    CachedBody.AllocatedSize = sizeof(Body_info) + GetBodyInfoDataSize(*NodeDataPtr);
+    CachedBody.LastUsedFrameNumber = FrameNumber;
+    Loader->BodyCacheBytes.fetch_add(CachedBody.AllocatedSize);
+    INC_MEMORY_STAT_BY(STAT_XSPLoader_LoaderBodyCacheMemory, CachedBody.AllocatedSize);
+    return NodeDataPtr;
+}
+
+void FXSPFileLoadRunnalbe::ProcessRequest(FXSPSourceData& SourceData, FStaticMeshRequest* Request)
+{
+    Request->MarkStage(EXSPRequestStage::Taken);
+    INC_FLOAT_STAT_BY(STAT_XSPLoader_LoadRequestLatency, FPlatformTime::ToMilliseconds64(Request->StageCycles[(int32)EXSPRequestStage::Taken] - Request->StageCycles[(int32)EXSPRequestStage::Enqueued]));
+    INC_DWORD_STAT(STAT_XSPLoader_NumLoadRequestStarted);
+
+    //取出后被取消的请求,不再读取
+    if (!Loader->IsRequestAlive(Request))
+    {
+        INC_DWORD_STAT(STAT_XSPLoader_NumLoadRequestAbandoned);
+        Request->SetReleasable();
+        return;
+    }
+
+    //计算全局dbid在本文件中的局部dbid
+    int32 LocalDbid = Request->Dbid - SourceData.StartDbid;
+    check(LocalDbid >= 0 && LocalDbid < SourceData.Count);
+
+    bool bPrefetch;
+    {
+        FScopeLock Lock(&Loader->RequestCS);
+        bPrefetch = Request->bPrefetch;
+    }
+
+    //源文件的映射与节点数据的解码分别计时(缓存命中时不需要映射)
+    if (!SourceData.BodyMap.Contains(LocalDbid))
+        Loader->OpenSourceFile(SourceData);
+    Request->MarkStage(EXSPRequestStage::FileOpened);
+
+    //读取Body数据
+    bool bCacheHit = false;
+    FBodyInfoPtr NodeDataPtr = GetBody(SourceData, LocalDbid, &bCacheHit);
+    if (!NodeDataPtr.IsValid())
+    {
+        //源文件无法打开,节点本身未必无效:置为无效并释放,不加入黑名单,之后的请求会重新读取
+        {
+            FScopeLock Lock(&Loader->RequestCS);
+            Request->Invalidate();
+        }
+        INC_DWORD_STAT(STAT_XSPLoader_NumLoadRequestAbandoned);
+        Request->SetReleasable();
+        return;
+    }
+    if (!bPrefetch)
+    {
+        if (bCacheHit)
+            INC_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyCacheHit);
+        else
+            INC_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyCacheMiss);
+    }
+
+    if (CheckNode(*NodeDataPtr))
+    {
+        //新读入的节点需要尝试继承上级节点的材质数据
+        int32 LocalParentDbid = NodeDataPtr->parentdbid < 0 ? -1 : NodeDataPtr->parentdbid - SourceData.StartDbid;
+        FBodyInfoPtr ParentNodeDataPtr = (LocalParentDbid >= 0 && LocalParentDbid < SourceData.Count) ? GetBody(SourceData, LocalParentDbid) : FBodyInfoPtr();
+        if (ParentNodeDataPtr.IsValid())
+        {
+            InheritMaterial(*NodeDataPtr, *ParentNodeDataPtr);
+        }
+        Request->MarkStage(EXSPRequestStage::Decoded);
+
+        //预取只读入节点数据(含上级节点),网格体在调用方请求时再构建;
+        //加锁重新检查,读取期间已转为普通请求的继续构建,否则由Game线程在转换后重新分发
+        if (bPrefetch)
+        {
+            FScopeLock Lock(&Loader->RequestCS);
+            bPrefetch = Request->bPrefetch;
+            if (bPrefetch)
                 Request->SetReleasable();
-            }
         }
 
-        if (LoadRequestQueue.IsEmpty())
-            FPlatformProcess::SleepNoStats(1.0f);
+        if (!bPrefetch)
+        {
+            GetMaterial(*NodeDataPtr, Request->Color, Request->Roughness);
+
+            //分发构建网格体的任务到线程池
+            (new FAutoDeleteAsyncTask<FBuildStaticMeshTask>(Loader, Request, NodeDataPtr))->StartBackgroundTask();
+        }
+    }
+    else
+    {
+        //无网格体的节点请求,置为无效,并加入黑名单
+        {
+            FScopeLock Lock(&Loader->RequestCS);
+            Request->Invalidate();
+        }
+        Loader->AddToBlacklist(Request->Dbid);
+        //置为可释放
+        Request->SetReleasable();
     }
 
-    return 0;
+    Loader->TrimBodyCache(SourceData);
 }
 
 FXSPLoader::FXSPLoader()
 {
-    MergeRequestQueue.Loader = this;
 }
 
 FXSPLoader::~FXSPLoader()
 {
+    StopTrace();
     Reset();
 }
 
@@ -201,29 +626,31 @@ bool FXSPLoader::Init(const TArray<FString>& FilePathNameArray)
     if (NumFiles < 1)
         return false;
 
-    int32 TotalNumNodes = 0;
+    LoadWorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+    int32 NumNodesTotal = 0;
     bool bFail = false;
     SourceDataList.SetNum(NumFiles);
     for (int32 i = 0; i < NumFiles; ++i)
     {
-        SourceDataList[i] = new FSourceData;
+        SourceDataList[i] = new FXSPSourceData;
         SourceDataList[i]->LoadRequestQueue.Loader = this;
-        std::fstream& FileStream = SourceDataList[i]->FileStream;
-        FileStream.open(std::wstring(*FilePathNameArray[i]), std::ios::in | std::ios::binary);
-        if (!FileStream.is_open())
+        SourceDataList[i]->LoadRequestQueue.WorkEvent = LoadWorkEvent;
+        SourceDataList[i]->LoadRequestQueue.SourceData = SourceDataList[i];
+        SourceDataList[i]->FilePathName = FilePathNameArray[i];
+        //映射头信息索引(不存在时由源文件生成),节点数取自索引
+        FXSPHeaderIndex& HeaderIndex = SourceDataList[i]->HeaderIndex;
+        if (!HeaderIndex.Open(FilePathNameArray[i]))
         {
             bFail = true;
             break;
         }
 
-        //读取源文件的节点数
-        FileStream.seekg(0, std::ios::beg);
-        int NumNodes;
-        FileStream.read((char*)&NumNodes, sizeof(NumNodes));
-        
-        SourceDataList[i]->StartDbid = TotalNumNodes;
+        int32 NumNodes = HeaderIndex.Num();
+
+        SourceDataList[i]->StartDbid = NumNodesTotal;
         SourceDataList[i]->Count = NumNodes;
-        TotalNumNodes += NumNodes;
+        NumNodesTotal += NumNodes;
     }
     if (bFail)
     {
@@ -231,19 +658,43 @@ bool FXSPLoader::Init(const TArray<FString>& FilePathNameArray)
         return false;
     }
 
+    RequestTable.SetNumZeroed(NumNodesTotal);
+    int32 NumBlacklistWords = FMath::DivideAndRoundUp(NumNodesTotal, 64);
+    BlacklistBits = MakeUnique<std::atomic<uint64>[]>(NumBlacklistWords);
+    for (int32 i = 0; i < NumBlacklistWords; ++i)
+    {
+        BlacklistBits[i].store(0, std::memory_order_relaxed);
+    }
+    //黑名单就绪后才发布节点总数,其他线程据此判断dbid是否可请求
+    TotalNumNodes.store(NumNodesTotal);
+
     SourceMaterial = TStrongObjectPtr(Cast<UMaterialInterface>(StaticLoadObject(UMaterialInterface::StaticClass(), nullptr, L"/XSPLoader/M_MainOpaque")));
     check(SourceMaterial);
 
-    //为每个源文件创建一个读取线程
-    for (int32 i = 0; i < NumFiles; ++i)
+    //创建固定数量的读取线程,由所有源文件共享
+    int32 NumThreads = FMath::Clamp(XSPNumIOThreads, 1, NumFiles);
+    for (int32 i = 0; i < NumThreads; ++i)
     {
         FString ThreadName = FString::Printf(TEXT("XSPFileLoader_%d"), i);
-        SourceDataList[i]->FileLoadRunnable = new FXSPFileLoadRunnalbe(this, SourceDataList[i]->FileStream, SourceDataList[i]->StartDbid, SourceDataList[i]->Count, SourceDataList[i]->LoadRequestQueue, MergeRequestQueue);
-        SourceDataList[i]->LoadThread = FRunnableThread::Create(SourceDataList[i]->FileLoadRunnable, *ThreadName, 8 * 1024, TPri_Normal);
+        FXSPFileLoadRunnalbe* FileLoadRunnable = new FXSPFileLoadRunnalbe(this);
+        LoadRunnableList.Add(FileLoadRunnable);
+        LoadThreadList.Add(FRunnableThread::Create(FileLoadRunnable, *ThreadName, 8 * 1024, TPri_Normal));
     }
 
     bInitialized = true;
     FrameNumber.store(0);
+    SET_FLOAT_STAT(STAT_XSPLoader_LoadRequestLatency, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoadRequestStarted, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoadRequestCancelled, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoadRequestAbandoned, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyEvicted, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoaderMeshEvicted, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyCacheHit, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyCacheMiss, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumPrefetchRequest, 0);
+    SET_DWORD_STAT(STAT_XSPLoader_NumLoaderMeshCacheHit, 0);
+    LatencyStats.Reset();
+    LastLatencyReportSeconds = FPlatformTime::Seconds();
 
     return true;
 }
@@ -257,36 +708,266 @@ void FXSPLoader::Reset()
 
     SourceMaterial.Reset();
     MergeRequestQueue.Empty();
-    for (TMap<int32, FStaticMeshRequest*>::TIterator Itr(AllRequestMap); Itr; ++Itr)
-        delete Itr.Value();
-    AllRequestMap.Empty();
+    PendingMergeRequestArray.Empty();
+    DispatchSourceRequests.Empty();
+    ViewInfoArray.Empty();
+    ViewStateArray.Empty();
+    ReprioritizeCursor = 0;
+    CameraPredictor.Reset();
+    PrefetchDbidArray.Empty();
+    PrefetchFrameMap.Empty();
+    MeshCacheMap.Empty();
+    MeshCacheBytes = 0;
+    MaterialCache.Empty();
+    SET_MEMORY_STAT(STAT_XSPLoader_LoaderMeshMemory, 0);
+    for (int32 Dbid : ActiveDbidArray)
+        FreeRequest(RequestTable[Dbid]);
+    ActiveDbidArray.Empty();
+    RequestTable.Empty();
+
+    //先使请求函数拒绝所有dbid,再释放黑名单,并释放尚未分发的请求
+    TotalNumNodes.store(0);
+    BlacklistBits.Reset();
+    FStaticMeshRequest* CachedRequest = nullptr;
+    while (CachedRequestQueue.Dequeue(CachedRequest))
+        FreeRequest(CachedRequest);
+    TArray<FStaticMeshRequest*> CachedRequestBatch;
+    while (CachedRequestBatchQueue.Dequeue(CachedRequestBatch))
+    {
+        for (FStaticMeshRequest* Request : CachedRequestBatch)
+            FreeRequest(Request);
+    }
 
     bInitialized = false;
 }
 
 void FXSPLoader::RequestStaticMesh_GameThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
 {
+    if (!IsRequestable(Dbid))
+        return;
+
+    FStaticMeshRequest* Request = AllocateRequest(Dbid, Priority, TargetMeshComponent);
+    DispatchRequests(TArrayView<FStaticMeshRequest* const>(&Request, 1), CurrentFrameNumber);
+}
+
+void FXSPLoader::RequestStaticMesh_AnyThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+{
+    if (!IsRequestable(Dbid))
+        return;
+
+    CachedRequestQueue.Enqueue(AllocateRequest(Dbid, Priority, TargetMeshComponent));
+}
+
+void FXSPLoader::RequestStaticMeshes_GameThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests)
+{
+    TArray<FStaticMeshRequest*> NewRequests;
+    AllocateRequests(Requests, NewRequests);
+    DispatchRequests(NewRequests, CurrentFrameNumber);
+}
+
+void FXSPLoader::RequestStaticMeshes_AnyThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests)
+{
+    TArray<FStaticMeshRequest*> NewRequests;
+    AllocateRequests(Requests, NewRequests);
+    if (!NewRequests.IsEmpty())
+        CachedRequestBatchQueue.Enqueue(MoveTemp(NewRequests));
+}
+
+void FXSPLoader::UpdatePriority(int32 Dbid, float Priority)
+{
+    if (!bInitialized || Dbid < 0 || Dbid >= RequestTable.Num())
+        return;
+
+    FStaticMeshRequest* Request = RequestTable[Dbid];
+    if (nullptr == Request || Request->IsReleasable())
+        return;
+
+    FRequestQueue::UpdateRequest(this, Request, CurrentFrameNumber, Priority);
+}
+
+void FXSPLoader::CancelRequest(int32 Dbid)
+{
+    if (!bInitialized || Dbid < 0 || Dbid >= RequestTable.Num())
+        return;
+
+    FStaticMeshRequest* Request = RequestTable[Dbid];
+    if (nullptr == Request || Request->IsReleasable())
+        return;
+
+    INC_DWORD_STAT(STAT_XSPLoader_NumLoadRequestCancelled);
+    //移出队列的请求可立即释放;已取出的请求由读取线程、构建任务或ProcessMergeRequests在发现其无效后置为可释放
+    if (FRequestQueue::CancelRequest(this, Request))
+        Request->SetReleasable();
+}
+
+void FXSPLoader::SetViews_GameThread(TArrayView<const FXSPViewInfo> Views)
+{
+    ViewInfoArray = Views;
+    ViewStateArray.SetNum(Views.Num());
+    for (int32 i = 0; i < Views.Num(); i++)
     {
-        FScopeLock Lock(&BlacklistCS);
-        if (Blacklist.Contains(Dbid))
-            return;
+        MakeViewState(Views[i], FVector::ZeroVector, ViewStateArray[i]);
     }
+}
+
+float FXSPLoader::ComputeViewPriority(int32 Dbid, float DefaultPriority) const
+{
+    if (ViewStateArray.IsEmpty())
+        return DefaultPriority;
 
-    DispatchRequest(new FStaticMeshRequest(Dbid, Priority, TargetMeshComponent), CurrentFrameNumber);
+    const FXSPSourceData* SourceData = SourceDataList[FindSourceIndex(Dbid)];
+    return ComputeNodeViewPriority(SourceData->HeaderIndex[Dbid - SourceData->StartDbid], ViewStateArray, OutOfViewPriorityScale, DefaultPriority);
 }
 
-void FXSPLoader::RequestStaticMesh_AnyThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+void FXSPLoader::UpdateViewPriorities()
 {
+    if (ViewStateArray.IsEmpty() || ActiveDbidArray.IsEmpty())
+        return;
+
+    //每帧只处理一部分请求,视点持续移动时所有请求在若干帧内轮流更新一遍
+    int32 NumToUpdate = FMath::Min(FMath::Max(XSPLoaderMaxReprioritizePerTick, 1), ActiveDbidArray.Num());
+    for (int32 i = 0; i < NumToUpdate; i++)
     {
-        FScopeLock Lock(&BlacklistCS);
-        if (Blacklist.Contains(Dbid))
-            return;
+        ReprioritizeCursor = ReprioritizeCursor % ActiveDbidArray.Num();
+        FStaticMeshRequest* Request = RequestTable[ActiveDbidArray[ReprioritizeCursor++]];
+        //UpdateRequest会重新激活请求,已取消或过期的请求不处理;预取请求保持其较低的优先级
+        if (Request->bPrefetch || Request->IsReleasable() || !IsRequestAlive(Request))
+            continue;
+
+        //排序键只在Game线程修改,这里读取无需加锁
+        float Priority = ComputeViewPriority(Request->Dbid, Request->Priority);
+        if (FMath::Abs(Priority - Request->Priority) <= FMath::Abs(Request->Priority) * ReprioritizeTolerance)
+            continue;
+
+        //保持时间戳不变,只调整优先级
+        FRequestQueue::UpdateRequest(this, Request, Request->LastUpdateFrameNumber, Priority);
+    }
+}
+
+void FXSPLoader::PrefetchPredictedNodes()
+{
+    if (ViewInfoArray.IsEmpty())
+    {
+        CameraPredictor.Reset();
+        CancelPrefetchRequests(nullptr);
+        return;
     }
 
+    CameraPredictor.Update(ViewInfoArray[0].Origin, FPlatformTime::Seconds());
+    TArray<FXSPViewState> PredictedViewStates;
+    if (!bXSPLoaderPrefetch || !CameraPredictor.Predict(ViewInfoArray, XSPLoaderPrefetchSeconds, PredictedViewStates))
     {
-        FScopeLock Lock(&CachedRequestArrayCS);
-        CachedRequestArray.Emplace(new FStaticMeshRequest(Dbid, Priority, TargetMeshComponent));
+        CancelPrefetchRequests(nullptr);
+        return;
     }
+
+    int32 MaxPrefetch = FMath::Max(XSPLoaderMaxPrefetchPerTick, 1);
+    int32 MaxCandidates = MaxPrefetch * PrefetchCandidateMultiplier;
+    TArray<FXSPPrefetchCandidate> Candidates;
+    for (FXSPSourceData* SourceData : SourceDataList)
+    {
+        if (Candidates.Num() >= MaxCandidates)
+            break;
+        SelectPrefetchNodes(SourceData->HeaderIndex, SourceData->StartDbid, PredictedViewStates, XSPLoaderPrefetchMinScreenSize, MaxCandidates - Candidates.Num(), Candidates);
+    }
+
+    //相机改变方向后不再位于预测视锥内的预取请求直接取消
+    TSet<int32> CandidateSet;
+    CandidateSet.Reserve(Candidates.Num());
+    for (const FXSPPrefetchCandidate& Candidate : Candidates)
+    {
+        CandidateSet.Add(Candidate.Dbid);
+    }
+    CancelPrefetchRequests(&CandidateSet);
+
+    //先预取投影大的节点;已有请求、已设置给组件或最近预取过的节点跳过
+    Candidates.Sort([](const FXSPPrefetchCandidate& Lhs, const FXSPPrefetchCandidate& Rhs) { return Lhs.ScreenSize > Rhs.ScreenSize; });
+    TArray<FStaticMeshRequest*> NewRequests;
+    for (const FXSPPrefetchCandidate& Candidate : Candidates)
+    {
+        if (NewRequests.Num() >= MaxPrefetch)
+            break;
+
+        int32 Dbid = Candidate.Dbid;
+        if (!IsRequestable(Dbid) || nullptr != RequestTable[Dbid] || MeshCacheMap.Contains(Dbid))
+            continue;
+        uint64* PrefetchFrameNumber = PrefetchFrameMap.Find(Dbid);
+        if (nullptr != PrefetchFrameNumber && CurrentFrameNumber - *PrefetchFrameNumber < PrefetchReissueFrames)
+            continue;
+
+        PrefetchFrameMap.Add(Dbid, CurrentFrameNumber);
+        FStaticMeshRequest* Request = AllocateRequest(Dbid, Candidate.ScreenSize * PrefetchPriorityScale, nullptr);
+        Request->bPrefetch = true;
+        NewRequests.Add(Request);
+        PrefetchDbidArray.Add(Dbid);
+    }
+    INC_DWORD_STAT_BY(STAT_XSPLoader_NumPrefetchRequest, NewRequests.Num());
+    DispatchRequests(NewRequests, CurrentFrameNumber);
+
+    //定期清理过时的预取记录
+    if (CurrentFrameNumber % PrefetchReissueFrames == 0)
+    {
+        for (auto It = PrefetchFrameMap.CreateIterator(); It; ++It)
+        {
+            if (CurrentFrameNumber - It.Value() >= PrefetchReissueFrames)
+                It.RemoveCurrent();
+        }
+    }
+}
+
+void FXSPLoader::CancelPrefetchRequests(const TSet<int32>* KeepDbidSet)
+{
+    for (int32 Index = 0; Index < PrefetchDbidArray.Num(); )
+    {
+        int32 Dbid = PrefetchDbidArray[Index];
+        FStaticMeshRequest* Request = RequestTable[Dbid];
+        //已完成、已转为普通请求或已释放的请求不再跟踪
+        if (nullptr == Request || !Request->bPrefetch || Request->IsReleasable())
+        {
+            PrefetchDbidArray.RemoveAtSwap(Index, 1, false);
+            continue;
+        }
+
+        if (nullptr != KeepDbidSet && KeepDbidSet->Contains(Dbid))
+        {
+            //仍在预测视锥内,刷新时间戳以免过期
+            if (IsRequestAlive(Request))
+                FRequestQueue::UpdateRequest(this, Request, CurrentFrameNumber, Request->Priority);
+            Index++;
+            continue;
+        }
+
+        CancelRequest(Dbid);
+        PrefetchDbidArray.RemoveAtSwap(Index, 1, false);
+    }
+}
+
+bool FXSPLoader::StartTrace(const FString& FilePathName)
+{
+    StopTrace();
+    TraceWriter.Reset(IFileManager::Get().CreateFileWriter(*FilePathName));
+    if (!TraceWriter.IsValid())
+    {
+        UE_LOG(LogXSPLoader, Error, TEXT("无法写入视点轨迹: %s"), *FilePathName);
+        return false;
+    }
+    WriteTraceHeader(*TraceWriter);
+    TraceFrame = FXSPLoaderTraceFrame();
+    return true;
+}
+
+void FXSPLoader::StopTrace()
+{
+    if (!TraceWriter.IsValid())
+        return;
+    TraceWriter->Close();
+    TraceWriter.Reset();
+}
+
+bool FXSPLoader::IsRequestAlive(FStaticMeshRequest* Request)
+{
+    FScopeLock Lock(&RequestCS);
+    return Request->IsRequestCurrent(FrameNumber.load());
 }
 
 void FXSPLoader::Tick(float DeltaTime)
@@ -310,6 +991,8 @@ void FXSPLoader::Tick(float DeltaTime)
 
     int64 BeginTicks = FDateTime::Now().GetTicks();
     DispatchNewRequests(CurrentFrameNumber);
+    UpdateViewPriorities();
+    PrefetchPredictedNodes();
     float UsedTime = (float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond;
 
     //if (NumRequests > 0)
@@ -321,139 +1004,667 @@ void FXSPLoader::Tick(float DeltaTime)
     float AvailableTime = 0.1f - UsedTime;
     ProcessMergeRequests(AvailableTime);
 
+    TrimMeshCache();
+
     ReleaseRequests();
+
+    ReportLatency();
+
+    if (TraceWriter.IsValid())
+    {
+        TraceFrame.Seconds = FPlatformTime::Seconds();
+        TraceFrame.Views = ViewInfoArray;
+        WriteTraceFrame(*TraceWriter, TraceFrame);
+        TraceFrame.RequestedDbids.Reset();
+    }
 }
 
 void FXSPLoader::ResetInternal()
 {
+    //先通知全部读取线程停止,再逐个等待退出
+    for (FXSPFileLoadRunnalbe* FileLoadRunnable : LoadRunnableList)
+    {
+        FileLoadRunnable->Stop();
+    }
+    for (FRunnableThread* LoadThread : LoadThreadList)
+    {
+        if (nullptr != LoadThread)
+        {
+            LoadThread->Kill(true);
+            delete LoadThread;
+        }
+    }
+    LoadThreadList.Empty();
+    for (FXSPFileLoadRunnalbe* FileLoadRunnable : LoadRunnableList)
+    {
+        delete FileLoadRunnable;
+    }
+    LoadRunnableList.Empty();
+
+    OpenSourceList.Empty();
+    ReadySourceHeap.Empty();
     for (auto SourceDataPtr : SourceDataList)
     {
-        if (nullptr != SourceDataPtr->LoadThread)
+        if (nullptr == SourceDataPtr)
+            continue;
+        SourceDataPtr->SourceFile.Close();
+        SourceDataPtr->HeaderIndex.Close();
+        delete SourceDataPtr;
+    }
+    SourceDataList.Empty();
+    BodyCacheBytes.store(0);
+    SET_MEMORY_STAT(STAT_XSPLoader_LoaderBodyCacheMemory, 0);
+
+    if (nullptr != LoadWorkEvent)
+    {
+        FPlatformProcess::ReturnSynchEventToPool(LoadWorkEvent);
+        LoadWorkEvent = nullptr;
+    }
+}
+
+void FXSPLoader::TrimBodyCache(FXSPSourceData& ClaimedSourceData)
+{
+    int64 BudgetBytes = GetBudgetBytes(XSPLoaderBodyCacheBudgetMB);
+    if (BodyCacheBytes.load() <= BudgetBytes)
+        return;
+
+    //各源文件的缓存只能由占用它的线程访问:占用所有能占用的文件,在这些文件间按最近使用的帧全局淘汰;
+    //正被其他线程占用的文件本次跳过,其中的节点多为正在使用的
+    TArray<FXSPSourceData*> ClaimedSources;
+    ClaimedSources.Add(&ClaimedSourceData);
+    for (FXSPSourceData* SourceData : SourceDataList)
+    {
+        if (SourceData != &ClaimedSourceData && SourceData->TryClaim())
+            ClaimedSources.Add(SourceData);
+    }
+
+    struct FLastUsedBody
+    {
+        uint64 LastUsedFrameNumber;
+        FXSPSourceData* SourceData;
+        int32 LocalDbid;
+    };
+    TArray<FLastUsedBody> LastUsedArray;
+    for (FXSPSourceData* SourceData : ClaimedSources)
+    {
+        for (const auto& Pair : SourceData->BodyMap)
         {
-            SourceDataPtr->LoadThread->Kill(true);
-            delete SourceDataPtr->LoadThread;
+            LastUsedArray.Add({ Pair.Value.LastUsedFrameNumber, SourceData, Pair.Key });
         }
-        if (nullptr != SourceDataPtr->FileLoadRunnable)
+    }
+    LastUsedArray.Sort([](const FLastUsedBody& Lhs, const FLastUsedBody& Rhs) { return Lhs.LastUsedFrameNumber < Rhs.LastUsedFrameNumber; });
+
+    //正在构建的节点数据由构建任务共享持有,从缓存移除后在任务完成时释放
+    int64 TargetBytes = BudgetBytes / 100 * BudgetTrimPercent;
+    for (const FLastUsedBody& LastUsed : LastUsedArray)
+    {
+        if (BodyCacheBytes.load() <= TargetBytes)
+            break;
+        int64 AllocatedSize = LastUsed.SourceData->BodyMap.FindChecked(LastUsed.LocalDbid).AllocatedSize;
+        LastUsed.SourceData->BodyMap.Remove(LastUsed.LocalDbid);
+        BodyCacheBytes.fetch_sub(AllocatedSize);
+        DEC_MEMORY_STAT_BY(STAT_XSPLoader_LoaderBodyCacheMemory, AllocatedSize);
+        INC_DWORD_STAT(STAT_XSPLoader_NumLoaderBodyEvicted);
+    }
+
+    for (int32 i = 1; i < ClaimedSources.Num(); i++)
+    {
+        ReleaseSource(*ClaimedSources[i]);
+    }
+}
+
+int32 FXSPLoader::FXSPCachedMesh::GetRefCount()
+{
+    Components.RemoveAllSwap([this](const TWeakObjectPtr<UStaticMeshComponent>& Component) {
+        return !Component.IsValid() || Component->GetStaticMesh() != StaticMesh.Get();
+    });
+    return Components.Num();
+}
+
+FXSPLoader::FXSPCachedMesh& FXSPLoader::AddCachedMesh(FStaticMeshRequest* Request)
+{
+    FXSPCachedMesh& CachedMesh = MeshCacheMap.FindOrAdd(Request->Dbid);
+    MeshCacheBytes -= CachedMesh.GPUBytes;
+    DEC_MEMORY_STAT_BY(STAT_XSPLoader_LoaderMeshMemory, CachedMesh.GPUBytes);
+
+    if (nullptr != CachedMesh.Material)
+        MaterialCache.Release(CachedMesh.Material);
+
+    CachedMesh.StaticMesh = Request->StaticMesh;
+    CachedMesh.Material = MaterialCache.Acquire(FXSPMaterialKey(Request->Color, Request->Roughness, FLinearColor::Black), [this, Request]() {
+        return CreateMaterialInstanceDynamic(SourceMaterial.Get(), Request->Color, Request->Roughness);
+    });
+    CachedMesh.GPUBytes = GetStaticMeshGPUBytes(Request->StaticMesh.Get());
+    CachedMesh.LastRequestedFrameNumber = Request->LastUpdateFrameNumber;
+    MeshCacheBytes += CachedMesh.GPUBytes;
+    INC_MEMORY_STAT_BY(STAT_XSPLoader_LoaderMeshMemory, CachedMesh.GPUBytes);
+    return CachedMesh;
+}
+
+void FXSPLoader::AssignCachedMesh(FXSPCachedMesh& CachedMesh, UStaticMeshComponent* Component)
+{
+    Component->SetMaterial(0, CachedMesh.Material);
+    Component->SetStaticMesh(CachedMesh.StaticMesh.Get());
+    if (!Component->IsRegistered())
+        Component->RegisterComponent();
+    CachedMesh.Components.AddUnique(Component);
+}
+
+void FXSPLoader::TrimMeshCache()
+{
+    int64 BudgetBytes = GetBudgetBytes(XSPLoaderMeshBudgetMB);
+    if (MeshCacheBytes <= BudgetBytes)
+        return;
+
+    //没有组件使用的网格体先淘汰,同类中按最近被请求的帧排序
+    struct FEvictOrder
+    {
+        bool bInUse;
+        uint64 LastRequestedFrameNumber;
+        int32 Dbid;
+    };
+    TArray<FEvictOrder> EvictOrderArray;
+    EvictOrderArray.Reserve(MeshCacheMap.Num());
+    for (auto& Pair : MeshCacheMap)
+    {
+        EvictOrderArray.Add({ Pair.Value.GetRefCount() > 0, Pair.Value.LastRequestedFrameNumber, Pair.Key });
+    }
+    EvictOrderArray.Sort([](const FEvictOrder& Lhs, const FEvictOrder& Rhs) {
+        if (Lhs.bInUse != Rhs.bInUse)
+            return !Lhs.bInUse;
+        return Lhs.LastRequestedFrameNumber < Rhs.LastRequestedFrameNumber;
+    });
+
+    int64 TargetBytes = BudgetBytes / 100 * BudgetTrimPercent;
+    for (const FEvictOrder& EvictOrder : EvictOrderArray)
+    {
+        if (MeshCacheBytes <= TargetBytes)
+            break;
+
+        //仍有未完成请求的节点正被使用,不淘汰
+        int32 Dbid = EvictOrder.Dbid;
+        if (nullptr != RequestTable[Dbid])
+            continue;
+
+        //从组件上移除后网格体不再被引用,由GC回收
+        FXSPCachedMesh& CachedMesh = MeshCacheMap.FindChecked(Dbid);
+        for (const TWeakObjectPtr<UStaticMeshComponent>& Component : CachedMesh.Components)
         {
-            delete SourceDataPtr->FileLoadRunnable;
+            if (Component.IsValid() && Component->GetStaticMesh() == CachedMesh.StaticMesh.Get())
+                Component->SetStaticMesh(nullptr);
         }
-        if (SourceDataPtr->FileStream.is_open())
+        MaterialCache.Release(CachedMesh.Material);
+        MeshCacheBytes -= CachedMesh.GPUBytes;
+        DEC_MEMORY_STAT_BY(STAT_XSPLoader_LoaderMeshMemory, CachedMesh.GPUBytes);
+        INC_DWORD_STAT(STAT_XSPLoader_NumLoaderMeshEvicted);
+        MeshCacheMap.Remove(Dbid);
+    }
+}
+
+void FXSPLoader::UpdateReadySource(FXSPSourceData& SourceData)
+{
+    FScopeLock Lock(&ReadySourceCS);
+    uint64 FrameNumber;
+    float Priority;
+    if (SourceData.bBusy || !SourceData.LoadRequestQueue.PeekFirst(FrameNumber, Priority))
+    {
+        if (INDEX_NONE != SourceData.ReadyHeapIndex)
+            RemoveReadySourceAt(SourceData.ReadyHeapIndex);
+        return;
+    }
+
+    SourceData.ReadyFrameNumber = FrameNumber;
+    SourceData.ReadyPriority = Priority;
+    if (INDEX_NONE == SourceData.ReadyHeapIndex)
+        SourceData.ReadyHeapIndex = ReadySourceHeap.Add(&SourceData);
+    SiftUpReadySource(SourceData.ReadyHeapIndex);
+    SiftDownReadySource(SourceData.ReadyHeapIndex);
+}
+
+FXSPSourceData* FXSPLoader::ClaimReadySource()
+{
+    FScopeLock Lock(&ReadySourceCS);
+    while (!ReadySourceHeap.IsEmpty())
+    {
+        FXSPSourceData* SourceData = ReadySourceHeap[0];
+        RemoveReadySourceAt(0);
+        //淘汰缓存或关闭文件时被直接占用的源文件跳过,其释放时会重新入堆
+        if (SourceData->TryClaim())
+            return SourceData;
+    }
+    return nullptr;
+}
+
+void FXSPLoader::ReleaseSource(FXSPSourceData& SourceData)
+{
+    SourceData.Release();
+    UpdateReadySource(SourceData);
+}
+
+namespace
+{
+    //排序规则与FSortRequestFunctor一致: 队首请求的时间戳新者优先,其次优先级高者优先
+    bool IsReadySourceHigher(const FXSPSourceData* Lhs, const FXSPSourceData* Rhs)
+    {
+        if (Lhs->ReadyFrameNumber != Rhs->ReadyFrameNumber)
+            return Lhs->ReadyFrameNumber > Rhs->ReadyFrameNumber;
+        return Lhs->ReadyPriority > Rhs->ReadyPriority;
+    }
+}
+
+void FXSPLoader::SiftUpReadySource(int32 Index)
+{
+    FXSPSourceData* SourceData = ReadySourceHeap[Index];
+    while (Index > 0)
+    {
+        int32 ParentIndex = (Index - 1) / 2;
+        if (!IsReadySourceHigher(SourceData, ReadySourceHeap[ParentIndex]))
+            break;
+        ReadySourceHeap[Index] = ReadySourceHeap[ParentIndex];
+        ReadySourceHeap[Index]->ReadyHeapIndex = Index;
+        Index = ParentIndex;
+    }
+    ReadySourceHeap[Index] = SourceData;
+    SourceData->ReadyHeapIndex = Index;
+}
+
+void FXSPLoader::SiftDownReadySource(int32 Index)
+{
+    FXSPSourceData* SourceData = ReadySourceHeap[Index];
+    int32 Num = ReadySourceHeap.Num();
+    while (true)
+    {
+        int32 ChildIndex = Index * 2 + 1;
+        if (ChildIndex >= Num)
+            break;
+        if (ChildIndex + 1 < Num && IsReadySourceHigher(ReadySourceHeap[ChildIndex + 1], ReadySourceHeap[ChildIndex]))
+            ChildIndex++;
+        if (!IsReadySourceHigher(ReadySourceHeap[ChildIndex], SourceData))
+            break;
+        ReadySourceHeap[Index] = ReadySourceHeap[ChildIndex];
+        ReadySourceHeap[Index]->ReadyHeapIndex = Index;
+        Index = ChildIndex;
+    }
+    ReadySourceHeap[Index] = SourceData;
+    SourceData->ReadyHeapIndex = Index;
+}
+
+void FXSPLoader::RemoveReadySourceAt(int32 Index)
+{
+    FXSPSourceData* SourceData = ReadySourceHeap[Index];
+    FXSPSourceData* Last = ReadySourceHeap.Pop(false);
+    if (Last != SourceData)
+    {
+        //用末尾元素填补空位,再向上或向下调整
+        ReadySourceHeap[Index] = Last;
+        Last->ReadyHeapIndex = Index;
+        SiftUpReadySource(Index);
+        SiftDownReadySource(Last->ReadyHeapIndex);
+    }
+    SourceData->ReadyHeapIndex = INDEX_NONE;
+}
+
+bool FXSPLoader::OpenSourceFile(FXSPSourceData& SourceData)
+{
+    FScopeLock Lock(&OpenSourceListCS);
+    if (SourceData.SourceFile.IsOpen())
+    {
+        //移到最近使用的位置
+        OpenSourceList.Remove(&SourceData);
+        OpenSourceList.Add(&SourceData);
+        return true;
+    }
+
+    //超出上限时关闭最久未使用的文件,正被其他线程占用的文件跳过(上限因此可能被暂时超出)
+    int32 MaxOpenFiles = FMath::Max(XSPMaxOpenFiles, 1);
+    for (int32 Index = 0; Index < OpenSourceList.Num() && OpenSourceList.Num() >= MaxOpenFiles; )
+    {
+        FXSPSourceData* LeastRecentSourceData = OpenSourceList[Index];
+        if (LeastRecentSourceData->TryClaim())
         {
-            SourceDataPtr->FileStream.close();
+            LeastRecentSourceData->SourceFile.Close();
+            ReleaseSource(*LeastRecentSourceData);
+            OpenSourceList.RemoveAt(Index);
+        }
+        else
+        {
+            Index++;
         }
-        delete SourceDataPtr;
     }
-    SourceDataList.Empty();
+
+    if (!SourceData.SourceFile.Open(SourceData.FilePathName))
+    {
+        UE_LOG(LogXSPLoader, Error, TEXT("无法打开文件: %s"), *SourceData.FilePathName);
+        return false;
+    }
+    OpenSourceList.Add(&SourceData);
+    return true;
 }
 
 void FXSPLoader::AddToBlacklist(int32 Dbid)
 {
-    FScopeLock Lock(&BlacklistCS);
-    if (Blacklist.Contains(Dbid))
-        return;
-    Blacklist.Add(Dbid);
+    check(Dbid >= 0 && Dbid < TotalNumNodes.load());
+    BlacklistBits[Dbid >> 6].fetch_or(1ull << (Dbid & 63), std::memory_order_relaxed);
 }
 
-void FXSPLoader::DispatchRequest(FStaticMeshRequest* Request, uint64 InFrameNumber)
+bool FXSPLoader::IsRequestable(int32 Dbid) const
 {
-    auto DispatchToRequestQueue = [this](FStaticMeshRequest* Request) {
-        for (auto SourceDataPtr : SourceDataList)
+    if (Dbid < 0 || Dbid >= TotalNumNodes.load())
+        return false;
+    return (BlacklistBits[Dbid >> 6].load(std::memory_order_relaxed) & (1ull << (Dbid & 63))) == 0;
+}
+
+FStaticMeshRequest* FXSPLoader::AllocateRequest(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent)
+{
+    return new (RequestAllocator.Allocate()) FStaticMeshRequest(Dbid, Priority, TargetMeshComponent);
+}
+
+void FXSPLoader::AllocateRequests(TArrayView<const FXSPStaticMeshRequestDesc> Requests, TArray<FStaticMeshRequest*>& OutRequests)
+{
+    OutRequests.Reserve(OutRequests.Num() + Requests.Num());
+    for (const FXSPStaticMeshRequestDesc& Desc : Requests)
+    {
+        if (IsRequestable(Desc.Dbid))
+            OutRequests.Add(AllocateRequest(Desc.Dbid, Desc.Priority, Desc.TargetMeshComponent));
+    }
+}
+
+void FXSPLoader::FreeRequest(FStaticMeshRequest* Request)
+{
+    Request->~FStaticMeshRequest();
+    RequestAllocator.Free(Request);
+}
+
+int32 FXSPLoader::FindSourceIndex(int32 Dbid) const
+{
+    //取最后一个StartDbid不大于Dbid的文件(没有节点的文件与下一个文件的StartDbid相同,会被跳过)
+    int32 SourceIndex = Algo::UpperBoundBy(SourceDataList, Dbid, [](const FXSPSourceData* SourceData) { return SourceData->StartDbid; }) - 1;
+    check(SourceIndex >= 0 && Dbid < SourceDataList[SourceIndex]->StartDbid + SourceDataList[SourceIndex]->Count);
+    return SourceIndex;
+}
+
+FStaticMeshRequest* FXSPLoader::MergeIntoRequestTable(FStaticMeshRequest* Request, uint64 InFrameNumber)
+{
+    int32 Dbid = Request->Dbid;
+    FXSPCachedMesh* CachedMesh = MeshCacheMap.Find(Dbid);
+    if (!Request->bPrefetch)
+    {
+        if (TraceWriter.IsValid())
+            TraceFrame.RequestedDbids.Add(Dbid);
+
+        //网格体已缓存,直接设置给组件
+        if (nullptr != CachedMesh)
         {
-            if (Request->Dbid >= SourceDataPtr->StartDbid && Request->Dbid < SourceDataPtr->StartDbid + SourceDataPtr->Count)
-            {
-                SourceDataPtr->LoadRequestQueue.Add(Request);
-                break;
-            }
+            //显存预算按最近被请求的帧淘汰
+            CachedMesh->LastRequestedFrameNumber = InFrameNumber;
+            AssignCachedMesh(*CachedMesh, Request->TargetComponent);
+            INC_DWORD_STAT(STAT_XSPLoader_NumLoaderMeshCacheHit);
+            FreeRequest(Request);
+            return nullptr;
         }
+
+        Request->Priority = ComputeViewPriority(Dbid, Request->Priority);
+    }
+    else if (nullptr != CachedMesh)
+    {
+        FreeRequest(Request);
+        return nullptr;
+    }
+
+    //网格体由所有请求该节点的组件共享,不以某个组件为Outer
+    auto CreateStaticMesh = [](FStaticMeshRequest* MeshRequest) {
+        MeshRequest->StaticMesh = TStrongObjectPtr<UStaticMesh>(NewObject<UStaticMesh>(GetTransientPackage()));
+        MeshRequest->StaticMesh->bAllowCPUAccess = true;
     };
 
-    int32 Dbid = Request->Dbid;
-    if (AllRequestMap.Contains(Dbid))
+    if (FStaticMeshRequest* InQueueRequest = RequestTable[Dbid])
     {
-        //已有请求
-        FStaticMeshRequest* InQueueRequest = AllRequestMap[Dbid];
+        //预取请求不影响已有的普通请求
+        if (Request->bPrefetch && !InQueueRequest->bPrefetch)
         {
-            //更新时间戳
+            FreeRequest(Request);
+            return nullptr;
+        }
+
+        //预取请求被调用方请求时转为普通请求,先创建静态网格对象,再使读取线程看到转换
+        if (InQueueRequest->bPrefetch && !Request->bPrefetch)
+        {
+            CreateStaticMesh(InQueueRequest);
             FScopeLock Lock(&RequestCS);
-            InQueueRequest->bValid = true;
-            InQueueRequest->LastUpdateFrameNumber = InFrameNumber;
-            //InQueueRequest->Priority = Request->Priority;
-            //InQueueRequest->TargetComponent = Request->TargetComponent;
+            InQueueRequest->TargetComponent = Request->TargetComponent;
+            InQueueRequest->bPrefetch = false;
         }
+
+        //已有请求
+        //更新时间戳与优先级(在队列中时同时调整其在堆中的位置)
+        FRequestQueue::UpdateRequest(this, InQueueRequest, InFrameNumber, Request->Priority);
+        //InQueueRequest->TargetComponent = Request->TargetComponent;
+        //其他组件的请求在完成时一起设置
+        if (!Request->bPrefetch && Request->TargetComponent != InQueueRequest->TargetComponent)
+            InQueueRequest->ExtraComponents.AddUnique(Request->TargetComponent);
+        FreeRequest(Request);
         if (InQueueRequest->IsReleasable())
         {
             //重置并重新分发到请求队列
             InQueueRequest->ResetReleasable();
-            DispatchToRequestQueue(InQueueRequest);
+            return InQueueRequest;
         }
-        delete Request;
+        return nullptr;
     }
-    else
+
+    //新请求,为其创建静态网格对象(预取请求不构建网格体)
+    if (!Request->bPrefetch)
+        CreateStaticMesh(Request);
+    Request->LastUpdateFrameNumber = InFrameNumber;
+    //加入到请求表
+    RequestTable[Dbid] = Request;
+    ActiveDbidArray.Emplace(Dbid);
+    return Request;
+}
+
+void FXSPLoader::DispatchRequests(TArrayView<FStaticMeshRequest* const> Requests, uint64 InFrameNumber)
+{
+    if (Requests.IsEmpty())
+        return;
+
+    //根据Dbid按源文件分组
+    DispatchSourceRequests.SetNum(SourceDataList.Num());
+    TArray<int32, TInlineAllocator<16>> SourceIndices;
+    for (FStaticMeshRequest* Request : Requests)
     {
-        //新请求,为其创建静态网格对象
-        Request->StaticMesh = TStrongObjectPtr<UStaticMesh>(NewObject<UStaticMesh>(Request->TargetComponent));
-        Request->StaticMesh->bAllowCPUAccess = true;
-        Request->LastUpdateFrameNumber = InFrameNumber;
-        //根据Dbid分发到相应的请求队列
-        DispatchToRequestQueue(Request);
-        //加入到总Map
-        AllRequestMap.Emplace(Dbid, Request);
+        FStaticMeshRequest* RequestToDispatch = MergeIntoRequestTable(Request, InFrameNumber);
+        if (nullptr == RequestToDispatch)
+            continue;
+
+        int32 SourceIndex = FindSourceIndex(RequestToDispatch->Dbid);
+        if (DispatchSourceRequests[SourceIndex].IsEmpty())
+            SourceIndices.Add(SourceIndex);
+        DispatchSourceRequests[SourceIndex].Add(RequestToDispatch);
+    }
+
+    //每个请求队列整批加入一次
+    uint64 EnqueueCycles = FPlatformTime::Cycles64();
+    for (int32 SourceIndex : SourceIndices)
+    {
+        TArray<FStaticMeshRequest*>& SourceRequests = DispatchSourceRequests[SourceIndex];
+        for (FStaticMeshRequest* Request : SourceRequests)
+        {
+            Request->StageCycles[(int32)EXSPRequestStage::Enqueued] = EnqueueCycles;
+        }
+        SourceDataList[SourceIndex]->LoadRequestQueue.Add(SourceRequests);
+        SourceRequests.Reset();
     }
 }
 
 void FXSPLoader::DispatchNewRequests(uint64 InFrameNumber)
 {
-    TArray<FStaticMeshRequest*> NewRequestArray;
+    TArray<FStaticMeshRequest*> NewRequests;
+    FStaticMeshRequest* TempRequest = nullptr;
+    while (CachedRequestQueue.Dequeue(TempRequest))
     {
-        FScopeLock Lock(&CachedRequestArrayCS);
-        NewRequestArray = MoveTemp(CachedRequestArray);
+        NewRequests.Add(TempRequest);
     }
-
-    for (auto& TempRequest : NewRequestArray)
+    TArray<FStaticMeshRequest*> RequestBatch;
+    while (CachedRequestBatchQueue.Dequeue(RequestBatch))
     {
-        DispatchRequest(TempRequest, InFrameNumber);
+        NewRequests.Append(RequestBatch);
     }
+    DispatchRequests(NewRequests, InFrameNumber);
 }
 
 void FXSPLoader::ProcessMergeRequests(float AvailableTime)
 {
     int64 BeginTicks = FDateTime::Now().GetTicks();
-    while (!MergeRequestQueue.IsEmpty())
+
+    //批量取出新完成的请求,与上一帧未处理完的请求一起按优先级排序(数组末尾优先级最高)
+    int32 NumPending = PendingMergeRequestArray.Num();
+    FStaticMeshRequest* NewRequest = nullptr;
+    while (MergeRequestQueue.Dequeue(NewRequest))
     {
-        FStaticMeshRequest* Request;
-        MergeRequestQueue.TakeFirst(Request);
-        if (nullptr != Request)
+        PendingMergeRequestArray.Emplace(NewRequest);
+    }
+    if (PendingMergeRequestArray.Num() != NumPending)
+    {
+        //排序键只在Game线程修改,这里读取无需加锁
+        FSortRequestFunctor HighPriority;
+        PendingMergeRequestArray.Sort([&HighPriority](FStaticMeshRequest& Lhs, FStaticMeshRequest& Rhs) { return HighPriority(&Rhs, &Lhs); });
+    }
+
+    while (!PendingMergeRequestArray.IsEmpty())
+    {
+        FStaticMeshRequest* Request = PendingMergeRequestArray.Pop(false);
+        bool bCurrent;
         {
+            FScopeLock Lock(&RequestCS);
+            //构建前被取消的请求没有网格数据,即使之后又被重新请求也只能丢弃
+            bCurrent = Request->bBuilt && Request->IsRequestCurrent(CurrentFrameNumber);
+            if (!bCurrent)
+                Request->Invalidate();
+        }
+        if (bCurrent)
+        {
+            //直接生成渲染数据时没有BodySetup,碰撞数据由保留的CPU数据生成
+            if (nullptr == Request->StaticMesh->GetBodySetup())
+                Request->StaticMesh->CreateBodySetup();
             UBodySetup* BodySetup = Request->StaticMesh->GetBodySetup();
             BodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
             //BodySetup->CreatePhysicsMeshes();
 
-            Request->TargetComponent->SetMaterial(0, CreateMaterialInstanceDynamic(SourceMaterial.Get(), Request->Color, Request->Roughness));
-            Request->TargetComponent->SetStaticMesh(Request->StaticMesh.Get());
             Request->StaticMesh->RemoveFromRoot();
-            Request->TargetComponent->RegisterComponent();
-            
-            UE_LOG(LogXSPLoader, Display, TEXT("完成加载: %d"), Request->Dbid);
-            GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, FString::Printf(TEXT("完成加载: %d"), Request->Dbid));
+            FXSPCachedMesh& CachedMesh = AddCachedMesh(Request);
+            AssignCachedMesh(CachedMesh, Request->TargetComponent);
+            for (UStaticMeshComponent* Component : Request->ExtraComponents)
+            {
+                AssignCachedMesh(CachedMesh, Component);
+            }
 
-            //标记为可释放
-            Request->SetReleasable();
+            //逐个请求的输出改为由ReportLatency定期输出摘要
+            Request->MarkStage(EXSPRequestStage::Merged);
+            LatencyStats.AddRequest(Request->StageCycles);
         }
 
+        //标记为可释放(过期的请求直接丢弃)
+        Request->SetReleasable();
+
         if ((float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond >= AvailableTime)
             break;
     }
 }
 
+#define SET_XSP_LATENCY_STATS(Name, IntervalIndex) \
+    SET_FLOAT_STAT(STAT_XSPLoader_Latency##Name##P50, LatencyStats.GetHistogram(IntervalIndex).GetPercentile(50)); \
+    SET_FLOAT_STAT(STAT_XSPLoader_Latency##Name##P95, LatencyStats.GetHistogram(IntervalIndex).GetPercentile(95)); \
+    SET_FLOAT_STAT(STAT_XSPLoader_Latency##Name##P99, LatencyStats.GetHistogram(IntervalIndex).GetPercentile(99));
+
+void FXSPLoader::ReportLatency()
+{
+    double Seconds = FPlatformTime::Seconds();
+    if (XSPLoaderLatencyReportSeconds <= 0 || Seconds - LastLatencyReportSeconds < XSPLoaderLatencyReportSeconds)
+        return;
+    LastLatencyReportSeconds = Seconds;
+    if (LatencyStats.GetNumRequests() == 0)
+        return;
+
+    SET_XSP_LATENCY_STATS(QueueWait, 0);
+    SET_XSP_LATENCY_STATS(FileOpen, 1);
+    SET_XSP_LATENCY_STATS(Decode, 2);
+    SET_XSP_LATENCY_STATS(BuildWait, 3);
+    SET_XSP_LATENCY_STATS(Build, 4);
+    SET_XSP_LATENCY_STATS(MergeWait, 5);
+    SET_XSP_LATENCY_STATS(Total, 6);
+
+    FString Summary = LatencyStats.GetSummary();
+    UE_LOG(LogXSPLoader, Display, TEXT("%s"), *Summary);
+    //固定的Key使屏幕上只保留最新的一行
+    static const uint64 SummaryMessageKey = 0x585350;
+    if (nullptr != GEngine)
+        GEngine->AddOnScreenDebugMessage(SummaryMessageKey, XSPLoaderLatencyReportSeconds * 2, FColor::Green, Summary);
+
+    if (bXSPLoaderLatencyCsv)
+    {
+        //每次运行首次输出时重写表头
+        FString CsvFilePathName = FPaths::ProfilingDir() / TEXT("XSPLoaderLatency.csv");
+        FString Lines;
+        if (!bLatencyCsvHeaderWritten)
+            Lines = FXSPRequestLatencyStats::GetCsvHeader() + LINE_TERMINATOR;
+        Lines += LatencyStats.GetCsvRow(Seconds) + LINE_TERMINATOR;
+        uint32 WriteFlags = bLatencyCsvHeaderWritten ? FILEWRITE_Append : FILEWRITE_None;
+        if (FFileHelper::SaveStringToFile(Lines, *CsvFilePathName, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), WriteFlags))
+            bLatencyCsvHeaderWritten = true;
+    }
+
+    LatencyStats.Reset();
+}
+
+#undef SET_XSP_LATENCY_STATS
+
 void FXSPLoader::ReleaseRequests()
 {
-    for (TMap<int32, FStaticMeshRequest*>::TIterator Itr(AllRequestMap); Itr; ++Itr)
+    for (int32 Index = 0; Index < ActiveDbidArray.Num(); )
     {
-        if (Itr.Value()->IsReleasable())
+        int32 Dbid = ActiveDbidArray[Index];
+        if (RequestTable[Dbid]->IsReleasable())
         {
             //唯一释放请求的位置
-            delete Itr.Value();
-            Itr.RemoveCurrent();
+            FreeRequest(RequestTable[Dbid]);
+            RequestTable[Dbid] = nullptr;
+            ActiveDbidArray.RemoveAtSwap(Index, 1, false);
         }
+        else
+        {
+            Index++;
+        }
+    }
+}
+
+namespace
+{
+    //模块创建的加载器实例
+    FXSPLoader& GetModuleLoader()
+    {
+        return static_cast<FXSPLoader&>(FModuleManager::GetModuleChecked<FXSPLoaderModule>(TEXT("XSPLoader")).Get());
     }
-}
\ No newline at end of file
+}
+
+FAutoConsoleCommand XSPLoaderTraceStartCommand(
+    TEXT("xsp.LoaderTrace.Start"),
+    TEXT("开始录制FXSPLoader每帧的视点与请求, 参数: 轨迹文件路径"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+    {
+        if (Args.Num() < 1)
+        {
+            UE_LOG(LogXSPLoader, Display, TEXT("用法: xsp.LoaderTrace.Start <轨迹文件路径>"));
+            return;
+        }
+        GetModuleLoader().StartTrace(Args[0]);
+    })
+);
+
+FAutoConsoleCommand XSPLoaderTraceStopCommand(
+    TEXT("xsp.LoaderTrace.Stop"),
+    TEXT("停止录制FXSPLoader的视点轨迹"),
+    FConsoleCommandDelegate::CreateLambda([]()
+    {
+        GetModuleLoader().StopTrace();
+    })
+);
@@ -5,8 +5,16 @@
 #include "CoreMinimal.h"
 #include "IXSPLoader.h"
 #include "XSPFileUtils.h"
-#include <fstream>
+#include "XSPMappedFile.h"
+#include "XSPHeaderIndex.h"
+#include "Containers/Queue.h"
+#include "Containers/LockFreeFixedSizeAllocator.h"
+#include "XSPMaterialCache.h"
+#include "XSPLatency.h"
+#include "XSPPrefetch.h"
 
+struct FRequestQueue;
+struct FXSPSourceData;
 
 struct FStaticMeshRequest
 {
@@ -19,6 +27,11 @@ struct FStaticMeshRequest
 	UStaticMeshComponent* TargetComponent;
 	TStrongObjectPtr<UStaticMesh> StaticMesh;
 	std::atomic_bool bReleasable;
+	//各阶段的时刻,用于统计流水线延迟.每个阶段只由当时处理请求的线程写入
+	FXSPRequestStageCycles StageCycles;
+	//所在的队列及在其堆中的位置,只在该队列的锁内修改
+	std::atomic<FRequestQueue*> OwnerQueue;
+	int32 HeapIndex;
 
 	FStaticMeshRequest(int32 InDbid, float InPriority, UStaticMeshComponent* InTargetComponent)
 		: Dbid(InDbid)
@@ -29,6 +42,9 @@ struct FStaticMeshRequest
 		, Roughness(1)
 		, TargetComponent(InTargetComponent)
 		, bReleasable(false)
+		, StageCycles{}
+		, OwnerQueue(nullptr)
+		, HeapIndex(INDEX_NONE)
 	{}
 
 	void Invalidate();
@@ -42,6 +58,17 @@ struct FStaticMeshRequest
 	bool IsReleasable() { return bReleasable; }
 
 	bool IsRequestCurrent(uint64 FrameNumber);
+
+	void MarkStage(EXSPRequestStage Stage) { StageCycles[(int32)Stage] = FPlatformTime::Cycles64(); }
+
+	//由构建任务设置,Game线程从MergeRequestQueue取出后读取
+	bool bBuilt = false;
+
+	//预取请求只读入节点数据,不构建网格体,也没有目标组件;被调用方请求时转为普通请求.分发后只在RequestCS内修改
+	bool bPrefetch = false;
+
+	//请求未完成时其他组件对同一节点的请求,完成后一起设置网格体.只在Game线程访问
+	TArray<UStaticMeshComponent*> ExtraComponents;
 };
 
 struct FSortRequestFunctor
@@ -54,15 +81,26 @@ struct FSortRequestFunctor
 	}
 };
 
+/**
+请求队列: 以FSortRequestFunctor为序的二叉堆,入队、出队与更新排序键均为O(log n)
+过期请求不做全量扫描,只在出队时检查堆顶,并在每次出队时顺带检查少量元素
+队列中请求的排序键(LastUpdateFrameNumber、Priority)只能通过UpdateRequest修改
+*/
 struct FRequestQueue
 {
 public:
 	void Add(FStaticMeshRequest* Request);
 
-	void AddNoLock(FStaticMeshRequest* Request);
+	//整批加入,只加锁一次并只唤醒一次读取线程
+	void Add(TArrayView<FStaticMeshRequest* const> Requests);
+
+	void AddNoLock(TArrayView<FStaticMeshRequest* const> Requests);
 
 	void TakeFirst(FStaticMeshRequest*& Request);
 
+	//查看队首请求的排序键(不出队),队列中没有有效请求时返回false
+	bool PeekFirst(uint64& OutLastUpdateFrameNumber, float& OutPriority);
+
 	bool IsEmpty();
 
 	void Empty();
@@ -70,19 +108,47 @@ public:
 	typedef TArray<FStaticMeshRequest*> FRequestList;
 	void Swap(FRequestList& RequestList);
 
+	//更新请求的时间戳与优先级并重新激活;请求在某个队列中时同时调整其在堆中的位置
+	static void UpdateRequest(class FXSPLoader* Loader, FStaticMeshRequest* Request, uint64 LastUpdateFrameNumber, float Priority);
+
+	//将请求置为无效;请求在某个队列中时同时将其移出,返回是否从队列中移出
+	static bool CancelRequest(class FXSPLoader* Loader, FStaticMeshRequest* Request);
+
 	FRequestList RequestList;
 	FCriticalSection RequestListCS;
 
 	class FXSPLoader* Loader;
+
+	//队列所属的源文件,队首请求变化时更新其在就绪堆中的位置
+	FXSPSourceData* SourceData = nullptr;
+
+	//有新请求加入时触发(自动重置),读取线程在没有可处理的请求时等待该事件
+	FEvent* WorkEvent = nullptr;
+
+private:
+	void FindFirst(FStaticMeshRequest*& Request, bool bRemove);
+
+	void SiftUp(int32 Index);
+	void SiftDown(int32 Index);
+	void RemoveAt(int32 Index);
+	void ExpireRequestAt(int32 Index);
+
+	//增量检查过期请求的位置
+	int32 ExpireCursor = 0;
 };
 
+//多生产者单消费者的无锁队列,用于向Game线程移交请求
+typedef TQueue<FStaticMeshRequest*, EQueueMode::Mpsc> FRequestMpscQueue;
+
+typedef TSharedPtr<Body_info, ESPMode::ThreadSafe> FBodyInfoPtr;
+
 class FBuildStaticMeshTask : public FNonAbandonableTask
 {
 public:
-	FBuildStaticMeshTask(FStaticMeshRequest* InRequest, Body_info* InNodeData, FRequestQueue& MergeQueue)
-		: Request(InRequest)
+	FBuildStaticMeshTask(class FXSPLoader* InLoader, FStaticMeshRequest* InRequest, const FBodyInfoPtr& InNodeData)
+		: Loader(InLoader)
+		, Request(InRequest)
 		, NodeData(InNodeData)
-		, MergeRequestQueue(MergeQueue)
 	{
 	}
 
@@ -94,23 +160,53 @@ public:
 	}
 
 private:
+	class FXSPLoader* Loader;
 	FStaticMeshRequest* Request;
-	Body_info* NodeData;
-	FRequestQueue& MergeRequestQueue;
+	//共享持有,节点数据在构建期间被淘汰出缓存也不会释放
+	FBodyInfoPtr NodeData;
+};
+
+//缓存的节点数据
+struct FXSPCachedBody
+{
+	FBodyInfoPtr Body;
+	int64 AllocatedSize = 0;
+	//最近一次被请求使用的帧
+	uint64 LastUsedFrameNumber = 0;
 };
 
+//源文件及其请求队列,可由任一读取线程处理,同一时刻只被一个读取线程占用
+struct FXSPSourceData
+{
+	int32 StartDbid = 0;
+	int32 Count = 0;
+	FString FilePathName;
+	//头信息索引在Init时映射,源文件在处理请求时按需打开(受xsp.MaxOpenFiles约束)
+	FXSPHeaderIndex HeaderIndex;
+	FXSPMappedFile SourceFile;
+	FRequestQueue LoadRequestQueue;
+	//读过的节点数据缓存,只由占用该文件的读取线程访问
+	TMap<int32, FXSPCachedBody> BodyMap;
+	//是否正被某个读取线程占用
+	std::atomic<bool> bBusy = false;
+
+	//在FXSPLoader::ReadySourceHeap中的位置与排序键(入堆时的队首请求),只在ReadySourceCS内访问
+	int32 ReadyHeapIndex = INDEX_NONE;
+	uint64 ReadyFrameNumber = 0;
+	float ReadyPriority = 0;
+
+	bool TryClaim() { return !bBusy.exchange(true); }
+
+	void Release() { bBusy.store(false); }
+};
+
+//读取线程池中的一个线程,服务所有源文件的请求队列
 class FXSPFileLoadRunnalbe : public FRunnable
 {
 public:
-	FXSPFileLoadRunnalbe(class FXSPLoader* Owner, std::fstream& InFileStream, int32 InStartDbid, int32 InCount, FRequestQueue& LoadQueue, FRequestQueue& MergeQueue)
+	FXSPFileLoadRunnalbe(class FXSPLoader* Owner)
 		: Loader(Owner)
-		, FileStream(InFileStream)
-		, StartDbid(InStartDbid)
-		, Count(InCount)
-		, LoadRequestQueue(LoadQueue)
-		, MergeRequestQueue(MergeQueue)
 	{}
-	~FXSPFileLoadRunnalbe();
 
 	virtual bool Init() override
 	{
@@ -118,28 +214,23 @@ public:
 		return true;
 	}
 	virtual uint32 Run() override;
-	virtual void Stop() override
-	{
-		bStopRequested = true;
-	}
+	virtual void Stop() override;
 	virtual void Exit() override
 	{
 		bIsRunning = false;
 	}
 
+private:
+	void ProcessRequest(FXSPSourceData& SourceData, FStaticMeshRequest* Request);
+
+	//读取节点数据,读过的缓存在SourceData.BodyMap中;源文件无法打开时返回空指针且不缓存
+	FBodyInfoPtr GetBody(FXSPSourceData& SourceData, int32 LocalDbid, bool* bOutCacheHit = nullptr);
+
 private:
 	TAtomic<bool> bIsRunning = false;
 	TAtomic<bool> bStopRequested = false;
 
 	class FXSPLoader* Loader = nullptr;
-
-	std::fstream& FileStream;
-	int32 StartDbid = 0;
-	int32 Count = 0;
-	FRequestQueue& LoadRequestQueue;
-	FRequestQueue& MergeRequestQueue;
-	TArray<Header_info> HeaderList;
-	TMap<int32, Body_info*> BodyMap;
 };
 
 class FXSPLoader : public IXSPLoader
@@ -152,62 +243,182 @@ public:
 	virtual void Reset() override;
 	virtual void RequestStaticMesh_GameThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) override;
 	virtual void RequestStaticMesh_AnyThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) override;
+	virtual void RequestStaticMeshes_GameThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests) override;
+	virtual void RequestStaticMeshes_AnyThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests) override;
+	virtual void UpdatePriority(int32 Dbid, float Priority) override;
+	virtual void CancelRequest(int32 Dbid) override;
+	virtual void SetViews_GameThread(TArrayView<const FXSPViewInfo> Views) override;
 
 	void Tick(float DeltaTime);
 
+	//录制每帧的视点与请求到轨迹文件,用于回放评估预取效果
+	bool StartTrace(const FString& FilePathName);
+	void StopTrace();
+
 private:
-	void DispatchRequest(FStaticMeshRequest* Request, uint64 InFrameNumber);
+	//从对象池分配请求,可在任意线程调用;只能在Game线程释放
+	FStaticMeshRequest* AllocateRequest(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent);
+	void AllocateRequests(TArrayView<const FXSPStaticMeshRequestDesc> Requests, TArray<FStaticMeshRequest*>& OutRequests);
+	void FreeRequest(FStaticMeshRequest* Request);
+
+	//合并到请求表,返回需要投入读取队列的请求,没有时返回nullptr
+	FStaticMeshRequest* MergeIntoRequestTable(FStaticMeshRequest* Request, uint64 InFrameNumber);
+	//按源文件分组后整批投入各读取队列
+	void DispatchRequests(TArrayView<FStaticMeshRequest* const> Requests, uint64 InFrameNumber);
+	//二分查找dbid所在的源文件
+	int32 FindSourceIndex(int32 Dbid) const;
 	void DispatchNewRequests(uint64 InFrameNumber);
 	void ProcessMergeRequests(float AvailableTime);
 	void ReleaseRequests();
 	void AddToBlacklist(int32 Dbid);
+	//dbid超出范围或在黑名单中时返回false,可在任意线程调用
+	bool IsRequestable(int32 Dbid) const;
 	void ResetInternal();
 
+	//按源文件的队首请求与占用状态更新其在就绪堆中的位置;调用时不能持有请求队列的锁或RequestCS
+	void UpdateReadySource(FXSPSourceData& SourceData);
+	//取出就绪堆中队首请求优先级最高的源文件并占用它,没有可处理的请求时返回nullptr
+	FXSPSourceData* ClaimReadySource();
+	//释放占用的源文件(TryClaim或ClaimReadySource取得的),并重新加入就绪堆
+	void ReleaseSource(FXSPSourceData& SourceData);
+	void SiftUpReadySource(int32 Index);
+	void SiftDownReadySource(int32 Index);
+	void RemoveReadySourceAt(int32 Index);
+
+	//确保源文件已映射,打开的文件数超过上限时关闭最久未使用且未被占用的文件
+	bool OpenSourceFile(FXSPSourceData& SourceData);
+
+	//节点数据缓存超出预算时在所有能占用的源文件间淘汰最久未使用的节点数据,由占用ClaimedSourceData的读取线程调用
+	void TrimBodyCache(FXSPSourceData& ClaimedSourceData);
+
+	//根据当前视点计算节点的优先级,没有视点或节点没有包围盒时返回DefaultPriority
+	float ComputeViewPriority(int32 Dbid, float DefaultPriority) const;
+	//每帧按视点重新计算一部分请求的优先级
+	void UpdateViewPriorities();
+	//按相机运动外推视点,为预测视锥内的节点发出预取请求,并取消不再位于其中的预取请求
+	void PrefetchPredictedNodes();
+	void CancelPrefetchRequests(const TSet<int32>* KeepDbidSet);
+
+	struct FXSPCachedMesh;
+	//缓存构建完成的网格体及其材质,超出显存预算时先淘汰没有组件使用的,再淘汰最久未被请求的.只在Game线程调用
+	FXSPCachedMesh& AddCachedMesh(FStaticMeshRequest* Request);
+	void AssignCachedMesh(FXSPCachedMesh& CachedMesh, UStaticMeshComponent* Component);
+	void TrimMeshCache();
+
+	//定期输出延迟统计到stat、日志与CSV,之后开始新的统计时段
+	void ReportLatency();
+
 private:
 	bool bInitialized = false;
 	std::atomic<uint64> FrameNumber;
 	uint64 CurrentFrameNumber;			//gamethread
 
-	//每个源文件对应一个读取线程和一个请求队列
-	struct FSourceData
+	//每个源文件对应一个请求队列,按StartDbid升序排列
+	TArray<FXSPSourceData*> SourceDataList;
+	//所有源文件的节点总数
+	std::atomic<int32> TotalNumNodes = 0;
+
+	//固定数量的读取线程(xsp.NumIOThreads),与源文件数量无关
+	TArray<FXSPFileLoadRunnalbe*> LoadRunnableList;
+	TArray<FRunnableThread*> LoadThreadList;
+	//所有请求队列共享的唤醒事件
+	FEvent* LoadWorkEvent = nullptr;
+
+	//请求队列非空且未被占用的源文件,以队首请求的排序键(同FSortRequestFunctor)为序的二叉堆,
+	//读取线程从堆顶选取源文件,不必逐个查看所有文件的队列
+	TArray<FXSPSourceData*> ReadySourceHeap;
+	FCriticalSection ReadySourceCS;
+
+	//所有源文件的节点数据缓存总量
+	std::atomic<int64> BodyCacheBytes = 0;
+
+	//当前视点,只在Game线程访问
+	TArray<FXSPViewInfo> ViewInfoArray;
+	TArray<FXSPViewState> ViewStateArray;
+	//下一帧从ActiveDbidArray中的该位置继续重新计算优先级
+	int32 ReprioritizeCursor = 0;
+
+	//预取,只在Game线程访问
+	FXSPCameraPredictor CameraPredictor;
+	//已发出且可能仍在队列中的预取请求
+	TArray<int32> PrefetchDbidArray;
+	//各节点最近一次预取的帧,一段时间内不重复预取
+	TMap<int32, uint64> PrefetchFrameMap;
+
+	//完成的请求各阶段的延迟,只在Game线程访问
+	FXSPRequestLatencyStats LatencyStats;
+	double LastLatencyReportSeconds = 0;
+	bool bLatencyCsvHeaderWritten = false;
+
+	//视点轨迹录制
+	TUniquePtr<FArchive> TraceWriter;
+	FXSPLoaderTraceFrame TraceFrame;
+
+	//构建完成的网格体及其材质,按dbid共享给所有请求该节点的组件,再次请求时直接设置,不再读取和构建.只在Game线程访问
+	struct FXSPCachedMesh
 	{
-		int32 StartDbid;
-		int32 Count;
-		std::fstream FileStream;
-		FXSPFileLoadRunnalbe* FileLoadRunnable = nullptr;
-		FRunnableThread* LoadThread = nullptr;
-		FRequestQueue LoadRequestQueue;
+		TStrongObjectPtr<UStaticMesh> StaticMesh;
+		//由MaterialCache持有
+		UMaterialInstanceDynamic* Material = nullptr;
+		//设置了该网格体的组件
+		TArray<TWeakObjectPtr<UStaticMeshComponent>> Components;
+		int64 GPUBytes = 0;
+		uint64 LastRequestedFrameNumber = 0;
+
+		//引用计数,即仍在使用该网格体的组件数(同时移除已销毁或已换用其他网格体的组件)
+		int32 GetRefCount();
 	};
-	TArray<FSourceData*> SourceDataList;
+	TMap<int32, FXSPCachedMesh> MeshCacheMap;
+	int64 MeshCacheBytes = 0;
+
+	//已映射的源文件,按最近使用排序(末尾为最近使用)
+	TArray<FXSPSourceData*> OpenSourceList;
+	FCriticalSection OpenSourceListCS;
 
 	// 材质模板
 	TStrongObjectPtr<UMaterialInterface> SourceMaterial;
+	//按颜色与粗糙度共享的材质实例,只在Game线程访问
+	FXSPMaterialCache MaterialCache;
 
-	FRequestQueue MergeRequestQueue;
+	//构建完成的请求,由线程池任意线程投入,Game线程批量取出到PendingMergeRequestArray后按优先级处理
+	FRequestMpscQueue MergeRequestQueue;
+	TArray<FStaticMeshRequest*> PendingMergeRequestArray;
 
 	/**
 	Request的生命周期:
-	1.在FXSPLoader::Tick中被创建,根据dbid投入到相应文件对应的LoadRequestQueue	--Game线程
-	2.在FXSPFileLoadRunnalbe::Run中被从LoadRequestQueue中取出,(读取节点数据后)填充材质数据,与节点数据一起被封装为一个构建任务分发到线程池	--每个文件对应一个工作线程
-	3.在FBuildStaticMeshTask::DoWork中完成网格体构建后,被投入到全局的MergeRequestQueue	--线程池任意线程
-	4.在FXSPLoader::Tick中被从MergeRequestQueue中取出,将静态网格设置给组件对象,之后Request被销毁	--Game线程
-	在整个声明周期中,无论Request如何流转,AllRequestMap一直持有Request,最终必须确保Request在Game线程释放
+	1.在请求函数中从RequestAllocator分配,在FXSPLoader::Tick中(或直接在Game线程的请求函数中)按dbid分组投入到相应文件对应的LoadRequestQueue	--Game线程[Enqueued]
+	2.在FXSPFileLoadRunnalbe::Run中被从LoadRequestQueue中取出,(读取节点数据后)填充材质数据,与节点数据一起被封装为一个构建任务分发到线程池	--读取线程池中的任一线程,同一文件同一时刻只由一个线程处理[Taken,FileOpened,Decoded]
+	3.在FBuildStaticMeshTask::DoWork中完成网格体构建后,被投入到全局的MergeRequestQueue	--线程池任意线程[BuildStarted,Built]
+	4.在FXSPLoader::Tick中被从MergeRequestQueue中取出,将静态网格加入MeshCacheMap并设置给组件对象,之后Request被销毁	--Game线程[Merged]
+	方括号内为各步骤记录的EXSPRequestStage
+	在整个声明周期中,无论Request如何流转,RequestTable一直持有Request,最终必须确保Request在Game线程释放
 	*/
 
-	//全部请求的Map,只在Game线程访问
-	TMap<int32, FStaticMeshRequest*> AllRequestMap;
+	//全部请求,以dbid为下标;ActiveDbidArray是其中非空项的紧凑列表,用于遍历.只在Game线程访问
+	TArray<FStaticMeshRequest*> RequestTable;
+	TArray<int32> ActiveDbidArray;
 
-	//没有网格体的节点
-	TArray<int32> Blacklist;
-	FCriticalSection BlacklistCS;
+	//没有网格体的节点,每个dbid一位,原子读写
+	TUniquePtr<std::atomic<uint64>[]> BlacklistBits;
 
 	//收集新请求的缓存数组,由外部调用线程和Game线程访问
-	TArray<FStaticMeshRequest*> CachedRequestArray;
-	FCriticalSection CachedRequestArrayCS;
+	FRequestMpscQueue CachedRequestQueue;
+	//批量请求整批投入,每批只入队一次
+	TQueue<TArray<FStaticMeshRequest*>, EQueueMode::Mpsc> CachedRequestBatchQueue;
+
+	//请求对象池
+	TLockFreeFixedSizeAllocator<sizeof(FStaticMeshRequest), PLATFORM_CACHE_LINE_SIZE> RequestAllocator;
+
+	//DispatchRequests中按源文件分组的临时数组,只在Game线程访问
+	TArray<TArray<FStaticMeshRequest*>> DispatchSourceRequests;
 
 	//所有Request的可更新属性共享同一把锁
 	FCriticalSection RequestCS;
 
+	//请求是否仍需处理(未被取消且未过期),在读取和构建网格体之前检查
+	bool IsRequestAlive(FStaticMeshRequest* Request);
+
 	friend struct FRequestQueue;
 	friend class FXSPFileLoadRunnalbe;
+	friend class FBuildStaticMeshTask;
 };
@@ -0,0 +1,60 @@
+#include "XSPMappedFile.h"
+#include "HAL/PlatformFileManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPMappedFile, Log, All);
+
+
+FXSPMappedFile::FXSPMappedFile()
+{
+}
+
+FXSPMappedFile::~FXSPMappedFile()
+{
+    Close();
+}
+
+bool FXSPMappedFile::Open(const FString& InFilePathName)
+{
+    Close();
+
+    IMappedFileHandle* Handle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*InFilePathName);
+    if (nullptr == Handle)
+    {
+        UE_LOG(LogXSPMappedFile, Warning, TEXT("无法映射文件: %s"), *InFilePathName);
+        return false;
+    }
+    MappedFileHandle.Reset(Handle);
+
+    int64 FileSize = MappedFileHandle->GetFileSize();
+    if (FileSize <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    //映射整个文件,按顺序访问为主,提示系统预读
+    IMappedFileRegion* Region = MappedFileHandle->MapRegion(0, FileSize, true);
+    if (nullptr == Region)
+    {
+        UE_LOG(LogXSPMappedFile, Warning, TEXT("无法映射文件区域: %s"), *InFilePathName);
+        Close();
+        return false;
+    }
+    MappedFileRegion.Reset(Region);
+
+    Data = MappedFileRegion->GetMappedPtr();
+    Size = MappedFileRegion->GetMappedSize();
+    FilePathName = InFilePathName;
+
+    return true;
+}
+
+void FXSPMappedFile::Close()
+{
+    //区域必须先于文件句柄释放
+    MappedFileRegion.Reset();
+    MappedFileHandle.Reset();
+    Data = nullptr;
+    Size = 0;
+    FilePathName.Empty();
+}
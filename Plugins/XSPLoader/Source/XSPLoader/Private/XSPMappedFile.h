@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/MappedFileHandle.h"
+
+
+//以只读内存映射方式打开的源文件,整个文件映射为一段连续内存,可被多个线程同时读取
+class FXSPMappedFile
+{
+public:
+	FXSPMappedFile();
+	~FXSPMappedFile();
+
+	FXSPMappedFile(const FXSPMappedFile&) = delete;
+	FXSPMappedFile& operator=(const FXSPMappedFile&) = delete;
+
+	bool Open(const FString& FilePathName);
+	void Close();
+
+	bool IsOpen() const { return nullptr != Data; }
+	const uint8* GetData() const { return Data; }
+	int64 GetSize() const { return Size; }
+	const FString& GetFilePathName() const { return FilePathName; }
+
+	//检查[Offset, Offset+Length)是否位于文件范围内
+	bool IsValidRange(int64 Offset, int64 Length) const
+	{
+		return Offset >= 0 && Length >= 0 && Offset <= Size && Length <= Size - Offset;
+	}
+
+	//从指定偏移读取一个定长字段(文件中的字段不保证对齐)
+	template<typename T>
+	bool Read(int64 Offset, T& OutValue) const
+	{
+		if (!IsValidRange(Offset, sizeof(T)))
+			return false;
+		FMemory::Memcpy(&OutValue, Data + Offset, sizeof(T));
+		return true;
+	}
+
+private:
+	FString FilePathName;
+	TUniquePtr<IMappedFileHandle> MappedFileHandle;
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+};
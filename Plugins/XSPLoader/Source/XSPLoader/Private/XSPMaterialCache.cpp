@@ -0,0 +1,43 @@
+#include "XSPMaterialCache.h"
+#include "XSPStat.h"
+
+UMaterialInstanceDynamic* FXSPMaterialCache::Acquire(const FXSPMaterialKey& Key, TFunctionRef<UMaterialInstanceDynamic*()> CreateMaterial)
+{
+    FEntry& Entry = EntryMap.FindOrAdd(Key);
+    if (!Entry.Material.IsValid())
+    {
+        Entry.Material = TStrongObjectPtr<UMaterialInstanceDynamic>(CreateMaterial());
+        KeyMap.Add(Entry.Material.Get(), Key);
+        INC_DWORD_STAT(STAT_XSPLoader_NumMaterialInstance);
+    }
+    else
+    {
+        INC_DWORD_STAT(STAT_XSPLoader_NumMaterialInstanceCacheHit);
+    }
+    Entry.RefCount++;
+    return Entry.Material.Get();
+}
+
+void FXSPMaterialCache::Release(UMaterialInstanceDynamic* Material)
+{
+    const FXSPMaterialKey* Key = KeyMap.Find(Material);
+    if (nullptr == Key)
+        return;
+
+    FEntry& Entry = EntryMap.FindChecked(*Key);
+    check(Entry.RefCount > 0);
+    if (--Entry.RefCount > 0)
+        return;
+
+    //不再被引用的实例移出缓存,由GC回收
+    EntryMap.Remove(*Key);
+    KeyMap.Remove(Material);
+    DEC_DWORD_STAT(STAT_XSPLoader_NumMaterialInstance);
+}
+
+void FXSPMaterialCache::Empty()
+{
+    DEC_DWORD_STAT_BY(STAT_XSPLoader_NumMaterialInstance, EntryMap.Num());
+    EntryMap.Empty();
+    KeyMap.Empty();
+}
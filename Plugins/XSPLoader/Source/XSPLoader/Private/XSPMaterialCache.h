@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+//动态材质实例的参数,参数相同的实例共享
+struct FXSPMaterialKey
+{
+	FLinearColor BaseColor = FLinearColor::White;
+	float Roughness = 1.f;
+	FLinearColor EmissiveColor = FLinearColor::Black;
+	bool bTranslucent = false;
+
+	FXSPMaterialKey() {}
+
+	FXSPMaterialKey(const FLinearColor& InBaseColor, float InRoughness, const FLinearColor& InEmissiveColor)
+		: BaseColor(InBaseColor)
+		, Roughness(InRoughness)
+		, EmissiveColor(InEmissiveColor)
+		, bTranslucent(InBaseColor.A < 1.f)
+	{}
+
+	bool operator==(const FXSPMaterialKey& Other) const
+	{
+		return BaseColor == Other.BaseColor && Roughness == Other.Roughness && EmissiveColor == Other.EmissiveColor && bTranslucent == Other.bTranslucent;
+	}
+
+	friend uint32 GetTypeHash(const FXSPMaterialKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash(Key.BaseColor), GetTypeHash(Key.Roughness));
+		Hash = HashCombine(Hash, GetTypeHash(Key.EmissiveColor));
+		return HashCombine(Hash, GetTypeHash(Key.bTranslucent));
+	}
+};
+
+/**
+按参数共享的动态材质实例缓存,减少重复创建实例的Game线程耗时、GC压力与渲染线程的Uniform Buffer更新
+Acquire与Release成对调用,引用计数归零的实例移出缓存,之后由GC回收
+只能在Game线程使用
+*/
+class FXSPMaterialCache
+{
+public:
+	FXSPMaterialCache() {}
+	FXSPMaterialCache(const FXSPMaterialCache&) = delete;
+	FXSPMaterialCache& operator=(const FXSPMaterialCache&) = delete;
+
+	/**
+	 *	获取参数为Key的材质实例,引用计数加一
+	 *	@param	CreateMaterial	[in]	缓存中没有时调用,创建并设置好参数的材质实例
+	 */
+	UMaterialInstanceDynamic* Acquire(const FXSPMaterialKey& Key, TFunctionRef<UMaterialInstanceDynamic*()> CreateMaterial);
+
+	//引用计数减一,不是由本缓存创建的实例忽略
+	void Release(UMaterialInstanceDynamic* Material);
+
+	void Empty();
+
+	//缓存中的实例数
+	int32 Num() const { return EntryMap.Num(); }
+
+private:
+	struct FEntry
+	{
+		TStrongObjectPtr<UMaterialInstanceDynamic> Material;
+		int32 RefCount = 0;
+	};
+	TMap<FXSPMaterialKey, FEntry> EntryMap;
+	//由实例反查其参数
+	TMap<UMaterialInstanceDynamic*, FXSPMaterialKey> KeyMap;
+};
@@ -0,0 +1,278 @@
+#include "XSPMeshCodec.h"
+#include "XSPStat.h"
+#include "MeshUtils.h"
+
+int32 XSPMeshCodec = (int32)EXSPMeshCodec::Quantized;
+FAutoConsoleVariableRef CVarXSPMeshCodec(
+    TEXT("xsp.MeshCodec"),
+    XSPMeshCodec,
+    TEXT("节点网格体数据的存储编码，0:不编码，1:量化位置、八面体法线与差分索引，缺省为1")
+);
+
+float XSPMeshCodecMaxError = 0.1f;
+FAutoConsoleVariableRef CVarXSPMeshCodecMaxError(
+    TEXT("xsp.MeshCodec.MaxError"),
+    XSPMeshCodecMaxError,
+    TEXT("位置量化允许的最大误差(厘米)，超过时该网格体不编码，缺省为0.1")
+);
+
+namespace
+{
+    static const float QuantizationLevels = 65535.0f;
+
+    FORCEINLINE uint32 ZigZagEncode(int32 Value)
+    {
+        return ((uint32)Value << 1) ^ (uint32)(Value >> 31);
+    }
+
+    FORCEINLINE int32 ZigZagDecode(uint32 Value)
+    {
+        return (int32)(Value >> 1) ^ -(int32)(Value & 1);
+    }
+
+    FORCEINLINE float SignNotZero(float Value)
+    {
+        return Value >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+EXSPMeshCodec GetMeshCodec()
+{
+    return XSPMeshCodec == (int32)EXSPMeshCodec::Quantized ? EXSPMeshCodec::Quantized : EXSPMeshCodec::Raw;
+}
+
+float GetMeshCodecMaxError()
+{
+    return XSPMeshCodecMaxError;
+}
+
+bool QuantizePositions(const FVector3f* Positions, int32 NumVertices, float MaxError, FVector3f& OutMin, FVector3f& OutStep, uint16* OutQuantized)
+{
+    FBox3f Box(ForceInit);
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        Box += Positions[i];
+    }
+    OutMin = Box.Min;
+    OutStep = (Box.Max - Box.Min) / QuantizationLevels;
+
+    //四舍五入后每轴误差不超过半个步长
+    if ((OutStep * 0.5f).Size() > MaxError)
+        return false;
+
+    FVector3f InvStep(
+        OutStep.X > 0.0f ? 1.0f / OutStep.X : 0.0f,
+        OutStep.Y > 0.0f ? 1.0f / OutStep.Y : 0.0f,
+        OutStep.Z > 0.0f ? 1.0f / OutStep.Z : 0.0f);
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        FVector3f Quantized = (Positions[i] - OutMin) * InvStep;
+        OutQuantized[i * 3 + 0] = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.X), 0, 65535);
+        OutQuantized[i * 3 + 1] = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.Y), 0, 65535);
+        OutQuantized[i * 3 + 2] = (uint16)FMath::Clamp(FMath::RoundToInt(Quantized.Z), 0, 65535);
+    }
+    return true;
+}
+
+void DequantizePositions(const uint16* Quantized, int32 NumVertices, const FVector3f& Min, const FVector3f& Step, FVector3f* OutPositions)
+{
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        OutPositions[i] = FVector3f(
+            Min.X + Quantized[i * 3 + 0] * Step.X,
+            Min.Y + Quantized[i * 3 + 1] * Step.Y,
+            Min.Z + Quantized[i * 3 + 2] * Step.Z);
+    }
+}
+
+void EncodeOctNormals(const FPackedNormal* Normals, int32 NumVertices, uint16* OutEncoded)
+{
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        FVector3f Normal = Normals[i].ToFVector3f();
+        float L1 = FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Abs(Normal.Z);
+        float U = 0.0f, V = 0.0f;
+        if (L1 > 0.0f)
+        {
+            U = Normal.X / L1;
+            V = Normal.Y / L1;
+            //下半球折叠到上半球的外侧
+            if (Normal.Z < 0.0f)
+            {
+                float FoldedU = (1.0f - FMath::Abs(V)) * SignNotZero(U);
+                float FoldedV = (1.0f - FMath::Abs(U)) * SignNotZero(V);
+                U = FoldedU;
+                V = FoldedV;
+            }
+        }
+        uint32 EncodedU = (uint32)FMath::Clamp(FMath::RoundToInt((U * 0.5f + 0.5f) * 255.0f), 0, 255);
+        uint32 EncodedV = (uint32)FMath::Clamp(FMath::RoundToInt((V * 0.5f + 0.5f) * 255.0f), 0, 255);
+        OutEncoded[i] = (uint16)(EncodedU | (EncodedV << 8));
+    }
+}
+
+void DecodeOctNormals(const uint16* Encoded, int32 NumVertices, FPackedNormal* OutNormals)
+{
+    for (int32 i = 0; i < NumVertices; i++)
+    {
+        float U = (Encoded[i] & 0xff) / 255.0f * 2.0f - 1.0f;
+        float V = (Encoded[i] >> 8) / 255.0f * 2.0f - 1.0f;
+        FVector3f Normal(U, V, 1.0f - FMath::Abs(U) - FMath::Abs(V));
+        if (Normal.Z < 0.0f)
+        {
+            Normal.X = (1.0f - FMath::Abs(V)) * SignNotZero(U);
+            Normal.Y = (1.0f - FMath::Abs(U)) * SignNotZero(V);
+        }
+        OutNormals[i] = Normal.GetSafeNormal();
+    }
+}
+
+void EncodeDeltaIndices(const uint32* Indices, int32 NumIndices, TArray<uint8>& OutBytes)
+{
+    //相邻三角形的索引通常相近,差值多数在一个字节内
+    uint32 Previous = 0;
+    for (int32 i = 0; i < NumIndices; i++)
+    {
+        uint32 Value = ZigZagEncode((int32)(Indices[i] - Previous));
+        Previous = Indices[i];
+        while (Value >= 0x80)
+        {
+            OutBytes.Add((uint8)(Value | 0x80));
+            Value >>= 7;
+        }
+        OutBytes.Add((uint8)Value);
+    }
+}
+
+bool DecodeDeltaIndices(const uint8* Bytes, int32 NumBytes, int32 NumIndices, uint32* OutIndices)
+{
+    int32 Position = 0;
+    uint32 Previous = 0;
+    for (int32 i = 0; i < NumIndices; i++)
+    {
+        uint32 Value = 0;
+        for (int32 Shift = 0; ; Shift += 7)
+        {
+            if (Position >= NumBytes || Shift > 28)
+                return false;
+            uint8 Byte = Bytes[Position++];
+            Value |= (uint32)(Byte & 0x7f) << Shift;
+            if (!(Byte & 0x80))
+                break;
+        }
+        Previous += (uint32)ZigZagDecode(Value);
+        OutIndices[i] = Previous;
+    }
+    return true;
+}
+
+bool EncodeMesh(const TArray<FVector3f>& Positions, const TArray<FPackedNormal>& Normals, const TArray<uint32>& Indices, float MaxError, FXSPEncodedMesh& OutMesh)
+{
+    check(Positions.Num() == Normals.Num());
+
+    FXSPEncodedMesh Mesh;
+    Mesh.NumVertices = Positions.Num();
+    Mesh.NumIndices = Indices.Num();
+    Mesh.Positions.SetNumUninitialized(Mesh.NumVertices * 3);
+    if (!QuantizePositions(Positions.GetData(), Mesh.NumVertices, MaxError, Mesh.QuantizationMin, Mesh.QuantizationStep, Mesh.Positions.GetData()))
+        return false;
+
+    Mesh.Normals.SetNumUninitialized(Mesh.NumVertices);
+    EncodeOctNormals(Normals.GetData(), Mesh.NumVertices, Mesh.Normals.GetData());
+
+    Mesh.Indices.Reserve(Mesh.NumIndices * 2);
+    EncodeDeltaIndices(Indices.GetData(), Mesh.NumIndices, Mesh.Indices);
+    Mesh.Indices.Shrink();
+
+    OutMesh = MoveTemp(Mesh);
+    return true;
+}
+
+void DecodeMesh(const FXSPEncodedMesh& Mesh, TArray<FVector3f>& OutPositions, TArray<FPackedNormal>& OutNormals, TArray<uint32>& OutIndices)
+{
+    OutPositions.SetNumUninitialized(Mesh.NumVertices, false);
+    DequantizePositions(Mesh.Positions.GetData(), Mesh.NumVertices, Mesh.QuantizationMin, Mesh.QuantizationStep, OutPositions.GetData());
+
+    OutNormals.SetNumUninitialized(Mesh.NumVertices, false);
+    DecodeOctNormals(Mesh.Normals.GetData(), Mesh.NumVertices, OutNormals.GetData());
+
+    OutIndices.SetNumUninitialized(Mesh.NumIndices, false);
+    verify(DecodeDeltaIndices(Mesh.Indices.GetData(), Mesh.Indices.Num(), Mesh.NumIndices, OutIndices.GetData()));
+}
+
+bool EncodeNodeMesh(FXSPNodeData& NodeData, EXSPMeshCodec Codec)
+{
+    if (Codec != EXSPMeshCodec::Quantized || NodeData.MeshPositionArray.IsEmpty())
+        return false;
+
+    if (!EncodeMesh(NodeData.MeshPositionArray, NodeData.MeshNormalArray, NodeData.MeshIndexArray, XSPMeshCodecMaxError, NodeData.EncodedMesh))
+        return false;
+
+    NodeData.MeshPositionArray.Empty();
+    NodeData.MeshNormalArray.Empty();
+    NodeData.MeshIndexArray.Empty();
+    INC_DWORD_STAT(STAT_XSPLoader_NumEncodedMesh);
+    return true;
+}
+
+FXSPMeshScratch& GetThreadMeshScratch()
+{
+    static thread_local FXSPMeshScratch Scratch;
+    return Scratch;
+}
+
+FXSPNodeMeshView GetNodeMeshView(const FXSPNodeData& NodeData, FXSPMeshScratch& Scratch, bool bInstancePrimitives)
+{
+    FXSPNodeMeshView View;
+    int32 NumPrimitiveVertices = NodeData.GetNumPrimitiveVertices(bInstancePrimitives);
+    if (NumPrimitiveVertices > 0)
+    {
+        //节点网格与参数化几何体的网格一起放入Scratch
+        if (NodeData.EncodedMesh.IsEmpty())
+        {
+            Scratch.Positions = NodeData.MeshPositionArray;
+            Scratch.Normals = NodeData.MeshNormalArray;
+            Scratch.Indices = NodeData.MeshIndexArray;
+        }
+        else
+        {
+            DecodeMesh(NodeData.EncodedMesh, Scratch.Positions, Scratch.Normals, Scratch.Indices);
+        }
+        Scratch.Positions.Reserve(Scratch.Positions.Num() + NumPrimitiveVertices);
+        Scratch.Normals.Reserve(Scratch.Normals.Num() + NumPrimitiveVertices);
+        Scratch.Indices.Reserve(Scratch.Indices.Num() + NodeData.GetNumPrimitiveIndices(bInstancePrimitives));
+        FBox3f BoundingBox(ForceInit);
+        for (const FXSPPrimitiveInstance& Instance : NodeData.PrimitiveInstanceArray)
+        {
+            if (!bInstancePrimitives || !Instance.CanInstance())
+                AppendPrimitiveInstanceMesh(Instance, Scratch.Positions, Scratch.Normals, Scratch.Indices, BoundingBox);
+        }
+        View.Positions = Scratch.Positions;
+        View.Normals = Scratch.Normals;
+        View.Indices = Scratch.Indices;
+    }
+    else if (NodeData.EncodedMesh.IsEmpty())
+    {
+        View.Positions = NodeData.MeshPositionArray;
+        View.Normals = NodeData.MeshNormalArray;
+        View.Indices = NodeData.MeshIndexArray;
+    }
+    else
+    {
+        DecodeMesh(NodeData.EncodedMesh, Scratch.Positions, Scratch.Normals, Scratch.Indices);
+        View.Positions = Scratch.Positions;
+        View.Normals = Scratch.Normals;
+        View.Indices = Scratch.Indices;
+    }
+    return View;
+}
+
+int32 GetNodeMeshNumVertices(const FXSPNodeData& NodeData, bool bInstancePrimitives)
+{
+    return NodeData.GetNumVertices() + NodeData.GetNumPrimitiveVertices(bInstancePrimitives);
+}
+
+int32 GetNodeMeshNumIndices(const FXSPNodeData& NodeData, bool bInstancePrimitives)
+{
+    return NodeData.GetNumIndices() + NodeData.GetNumPrimitiveIndices(bInstancePrimitives);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "XSPDataStruct.h"
+
+/**
+网格体数据的存储编码,用于常驻内存的节点数据与几何缓存文件:
+	位置	--相对包围盒量化为每轴16位,量化误差超过xsp.MeshCodec.MaxError(厘米)的网格体保持不编码
+	法线	--八面体编码为两个8位分量
+	索引	--与前一索引之差做zigzag变长编码
+网格体数据只在生成渲染数据或碰撞数据时解码,通过GetNodeMeshView统一访问;参数化几何体也在此时按需生成网格
+*/
+
+enum class EXSPMeshCodec : int32
+{
+	//不编码,保存完整的FVector3f位置与32位索引
+	Raw = 0,
+	//量化位置、八面体法线、差分索引
+	Quantized = 1,
+};
+
+//当前选择的编码方式(xsp.MeshCodec)
+EXSPMeshCodec GetMeshCodec();
+
+//允许的位置量化误差,单位厘米(xsp.MeshCodec.MaxError)
+float GetMeshCodecMaxError();
+
+//位置量化: 计算包围盒与步长,误差超过MaxError时返回false
+bool QuantizePositions(const FVector3f* Positions, int32 NumVertices, float MaxError, FVector3f& OutMin, FVector3f& OutStep, uint16* OutQuantized);
+
+void DequantizePositions(const uint16* Quantized, int32 NumVertices, const FVector3f& Min, const FVector3f& Step, FVector3f* OutPositions);
+
+//法线八面体编码
+void EncodeOctNormals(const FPackedNormal* Normals, int32 NumVertices, uint16* OutEncoded);
+
+void DecodeOctNormals(const uint16* Encoded, int32 NumVertices, FPackedNormal* OutNormals);
+
+//索引差分编码,追加到OutBytes
+void EncodeDeltaIndices(const uint32* Indices, int32 NumIndices, TArray<uint8>& OutBytes);
+
+//索引差分解码,数据不完整时返回false
+bool DecodeDeltaIndices(const uint8* Bytes, int32 NumBytes, int32 NumIndices, uint32* OutIndices);
+
+//编码网格体,量化误差超过MaxError时返回false
+bool EncodeMesh(const TArray<FVector3f>& Positions, const TArray<FPackedNormal>& Normals, const TArray<uint32>& Indices, float MaxError, FXSPEncodedMesh& OutMesh);
+
+void DecodeMesh(const FXSPEncodedMesh& Mesh, TArray<FVector3f>& OutPositions, TArray<FPackedNormal>& OutNormals, TArray<uint32>& OutIndices);
+
+//按Codec编码节点的网格体数据,成功时释放未编码的数组
+bool EncodeNodeMesh(FXSPNodeData& NodeData, EXSPMeshCodec Codec);
+
+//解码时使用的临时数组,在同一线程内重复使用以避免反复分配
+struct FXSPMeshScratch
+{
+	TArray<FVector3f> Positions;
+	TArray<FPackedNormal> Normals;
+	TArray<uint32> Indices;
+};
+
+//当前线程的临时数组,构建任务在各自的线程中重复使用
+FXSPMeshScratch& GetThreadMeshScratch();
+
+//节点网格体数据的只读视图
+struct FXSPNodeMeshView
+{
+	TArrayView<const FVector3f> Positions;
+	TArrayView<const FPackedNormal> Normals;
+	TArrayView<const uint32> Indices;
+};
+
+//未编码时直接引用节点数据,已编码时解码到Scratch并引用Scratch(视图在Scratch下次使用前有效)
+//不以实例绘制的参数化几何体(bInstancePrimitives为false时为全部)的网格追加在节点网格之后,一起生成在Scratch中
+FXSPNodeMeshView GetNodeMeshView(const FXSPNodeData& NodeData, FXSPMeshScratch& Scratch, bool bInstancePrimitives);
+
+//GetNodeMeshView返回的顶点数与索引数
+int32 GetNodeMeshNumVertices(const FXSPNodeData& NodeData, bool bInstancePrimitives);
+int32 GetNodeMeshNumIndices(const FXSPNodeData& NodeData, bool bInstancePrimitives);
@@ -6,9 +6,12 @@
 #include "MeshUtils.h"
 #include "XSPFileReader.h"
 #include "XSPSubModelActor.h"
+#include "XSPMaterialCache.h"
 #include "XSPBatchMeshComponent.h"
 #include "XSPCustomMeshComponent.h"
+#include "XSPInstancedPrimitiveComponent.h"
 #include "XSPStat.h"
+#include "PhysicsEngine/BodySetup.h"
 
 
 float XSPMaxTickTimeWhenInitLoading = 0.3f;
@@ -31,6 +34,7 @@ extern int32 XSPMaxNumBatches;
 extern int32 XSPMaxNumVerticesPerBatch;
 extern int32 XSPMinNumVerticesPerBatch;
 extern int32 XSPMinNumVerticesUnbatch;
+extern bool bXSPBuildPhysicsData;
 
 namespace 
 {
@@ -48,8 +52,16 @@ namespace
         SET_DWORD_STAT(STAT_XSPLoader_NumCylinderMesh, 0);
         SET_DWORD_STAT(STAT_XSPLoader_NumEllipticalMesh, 0);
         SET_FLOAT_STAT(STAT_XSPLoader_ReadFileTime, 0);
+        SET_FLOAT_STAT(STAT_XSPLoader_ReadFileTimeCold, 0);
+        SET_FLOAT_STAT(STAT_XSPLoader_ReadFileTimeWarm, 0);
+        SET_DWORD_STAT(STAT_XSPLoader_NumGeometryCacheHit, 0);
         SET_DWORD_STAT(STAT_XSPLoader_NumRawMeshSimplified, 0);
         SET_DWORD_STAT(STAT_XSPLoader_NumTotalVerticesSimplied, 0);
+        SET_DWORD_STAT(STAT_XSPLoader_NumTotalVerticesWelded, 0);
+        SET_DWORD_STAT(STAT_XSPLoader_NumPrimitiveInstance, 0);
+        SET_DWORD_STAT(STAT_XSPLoader_NumInstancedComponent, 0);
+        SET_DWORD_STAT(STAT_XSPLoader_NumEncodedMesh, 0);
+        SET_MEMORY_STAT(STAT_XSPLoader_NodeDataMeshMemory, 0);
     }
 }
 
@@ -59,10 +71,13 @@ AXSPModelActor::AXSPModelActor()
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
     RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
+    MaterialCache = MakeUnique<FXSPMaterialCache>();
 }
 
 AXSPModelActor::~AXSPModelActor()
 {
+    //子模型在析构时释放其材质实例,需先于材质缓存销毁
+    SubModelActorMap.Empty();
     for (FXSPNodeData* NodeData : NodeDataArray)
     {
         delete NodeData;
@@ -97,9 +112,19 @@ int32 AXSPModelActor::GetNode(UPrimitiveComponent* Component, int32 FaceIndex)
     if (nullptr != MyComponent)
         return MyComponent->GetNode(FaceIndex);
 
+    UXSPInstancedPrimitiveComponent* InstancedComponent = Cast<UXSPInstancedPrimitiveComponent>(Component);
+    if (nullptr != InstancedComponent)
+        return InstancedComponent->GetNode(FaceIndex);
+
     return -1;
 }
 
+int32 AXSPModelActor::GetNodeFromHit(const FHitResult& Hit)
+{
+    UPrimitiveComponent* Component = Hit.GetComponent();
+    return GetNode(Component, Cast<UXSPInstancedPrimitiveComponent>(Component) ? Hit.Item : Hit.FaceIndex);
+}
+
 namespace
 {
     //递归计算节点包围盒,计算过程中将计算完的数据写入节点数据结构
@@ -166,7 +191,7 @@ namespace
 {
     bool RecursiveCheckModelNode(TArray<FXSPNodeData*>& NodeDataArray, int32 Dbid)
     {
-        if (NodeDataArray[Dbid]->MeshPositionArray.Num() > 0)
+        if (NodeDataArray[Dbid]->HasGeometry())
             return true;
 
         for (int32 i = 1; i < NodeDataArray[Dbid]->NumChildren; ++i)
@@ -397,20 +422,72 @@ void AXSPModelActor::Tick(float DeltaTime)
         TickDynamicCombine(EState::Updating == State ? XSPMaxTickTime : XSPMaxTickTimeWhenInitLoading);
 }
 
-UMaterialInstanceDynamic* AXSPModelActor::CreateMaterialInstanceDynamic(const FLinearColor& BaseColor, float Roughness, const FLinearColor& EmissiveColor)
+UMaterialInstanceDynamic* AXSPModelActor::AcquireMaterialInstanceDynamic(const FLinearColor& BaseColor, float Roughness, const FLinearColor& EmissiveColor)
+{
+    //剖切参数对所有实例相同,由SetCrossSection统一更新,不作为缓存的键
+    return MaterialCache->Acquire(FXSPMaterialKey(BaseColor, Roughness, EmissiveColor), [&]()
+    {
+        UMaterialInterface* ParentMaterial = BaseColor.A < 1.f ? SourceMaterialTranslucent : SourceMaterialOpaque;
+        UMaterialInstanceDynamic* MaterialInstanceDynamic = UMaterialInstanceDynamic::Create(ParentMaterial, nullptr);
+        MaterialInstanceDynamic->SetVectorParameterValue(TEXT("BaseColor"), BaseColor);
+        MaterialInstanceDynamic->SetScalarParameterValue(TEXT("Roughness"), Roughness);
+        MaterialInstanceDynamic->SetVectorParameterValue(TEXT("EmissiveColor"), EmissiveColor);
+
+        MaterialInstanceDynamic->SetScalarParameterValue(TEXT("CrossSectionEnable"), bCrossSectionEnable ? 1.f : 0.f);
+        MaterialInstanceDynamic->SetVectorParameterValue(TEXT("CrossSectionPlanePoint"), CrossSectionPosition);
+        MaterialInstanceDynamic->SetVectorParameterValue(TEXT("CrossSectionNormal"), CrossSectionNormal);
+        return MaterialInstanceDynamic;
+    });
+}
+
+void AXSPModelActor::ReleaseMaterialInstanceDynamic(UMaterialInstanceDynamic* MaterialInstanceDynamic)
+{
+    MaterialCache->Release(MaterialInstanceDynamic);
+}
+
+UStaticMesh* AXSPModelActor::GetPrimitiveUnitMesh(const FXSPPrimitiveInstance& Instance)
 {
-    UMaterialInterface* ParentMaterial = BaseColor.A < 1.f ? SourceMaterialTranslucent : SourceMaterialOpaque;
-    UMaterialInstanceDynamic* MaterialInstanceDynamic = UMaterialInstanceDynamic::Create(ParentMaterial, nullptr);
-    MaterialInstanceDynamic->SetVectorParameterValue(TEXT("BaseColor"), BaseColor);
-    MaterialInstanceDynamic->SetScalarParameterValue(TEXT("Roughness"), Roughness);
-    MaterialInstanceDynamic->SetVectorParameterValue(TEXT("EmissiveColor"), EmissiveColor);
+    int32 Key = ((int32)Instance.Type << 8) | Instance.NumSegments;
+    UStaticMesh*& UnitMesh = PrimitiveUnitMeshMap.FindOrAdd(Key, nullptr);
+    if (nullptr != UnitMesh)
+        return UnitMesh;
+
+    TArray<FStaticMeshBuildVertex> Vertices;
+    TArray<uint32> Indices;
+    FBox3f BoundingBox;
+    BuildPrimitiveUnitMesh(Instance.Type, Instance.NumSegments, Vertices, Indices, BoundingBox);
 
-    MaterialInstanceDynamic->SetScalarParameterValue(TEXT("CrossSectionEnable"), bCrossSectionEnable ? 1.f : 0.f);
-    MaterialInstanceDynamic->SetVectorParameterValue(TEXT("CrossSectionPlanePoint"), CrossSectionPosition);
-    MaterialInstanceDynamic->SetVectorParameterValue(TEXT("CrossSectionNormal"), CrossSectionNormal);
+    UnitMesh = NewObject<UStaticMesh>(this);
+    UnitMesh->SetFlags(RF_Transient | RF_DuplicateTransient | RF_TextExportTransient);
+    UnitMesh->NeverStream = true;
+    UnitMesh->GetStaticMaterials().Add(FStaticMaterial());
+    BuildStaticMeshRenderData(UnitMesh, Vertices, Indices, BoundingBox, false, false);
 
-    MaterialInstanceArray.Add(MaterialInstanceDynamic);
-    return MaterialInstanceDynamic;
+    //实例的碰撞使用简单碰撞体:圆柱体为其顶点的凸包,椭圆形为薄板;复杂查询(拾取)同样使用简单碰撞体
+    if (bXSPBuildPhysicsData)
+    {
+        UnitMesh->CreateBodySetup();
+        UBodySetup* BodySetup = UnitMesh->GetBodySetup();
+        BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+        if (Instance.Type == EXSPPrimitiveType::Cylinder)
+        {
+            FKConvexElem& ConvexElem = BodySetup->AggGeom.ConvexElems.AddDefaulted_GetRef();
+            for (const FStaticMeshBuildVertex& Vertex : Vertices)
+            {
+                ConvexElem.VertexData.Add(FVector(Vertex.Position));
+            }
+            ConvexElem.UpdateElemBox();
+        }
+        else
+        {
+            FKBoxElem& BoxElem = BodySetup->AggGeom.BoxElems.AddDefaulted_GetRef();
+            BoxElem.X = 2.f;
+            BoxElem.Y = 2.f;
+            BoxElem.Z = 0.01f;
+        }
+        BodySetup->CreatePhysicsMeshes();
+    }
+    return UnitMesh;
 }
 
 bool AXSPModelActor::LoadToDynamicCombinedMesh(const TArray<FString>& FilePathNameArray)
@@ -0,0 +1,197 @@
+#include "XSPPrefetch.h"
+#include "SceneManagement.h"
+#include "HAL/FileManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogXSPPrefetch, Log, All);
+
+
+namespace
+{
+    static const uint32 TraceMagic = 0x54505358;    //'XSPT'
+    static const uint32 TraceVersion = 1;
+
+    //速度的平滑系数,越大越跟随最近一帧的运动
+    static const float VelocitySmoothing = 0.3f;
+    //低于该速度(厘米/秒)视为静止
+    static const float MinPredictSpeed = 10.0f;
+    //高于该速度(厘米/秒)视为视点跳转,不参与速度估计
+    static const float MaxPredictSpeed = 100000.0f;
+
+    float ComputeScreenSize(const FVector& Center, const FVector& Extent, const FXSPViewState& ViewState)
+    {
+        return ComputeBoundsScreenSize(FVector4(Center, 1.0f), (float)Extent.Size(), FVector4(ViewState.Origin, 1.0f), ViewState.ProjectionMatrix);
+    }
+
+    void SerializeView(FArchive& Ar, FXSPViewInfo& View)
+    {
+        Ar << View.Origin;
+        Ar << View.ProjectionMatrix;
+        Ar << View.ViewProjectionMatrix;
+    }
+}
+
+void MakeViewState(const FXSPViewInfo& View, const FVector& Offset, FXSPViewState& OutViewState)
+{
+    OutViewState.Origin = View.Origin + Offset;
+    OutViewState.ProjectionMatrix = View.ProjectionMatrix;
+    //视点平移Offset等价于场景平移-Offset
+    GetViewFrustumBounds(OutViewState.Frustum, FTranslationMatrix(-Offset) * View.ViewProjectionMatrix, false);
+}
+
+float ComputeNodeViewPriority(const FXSPHeaderIndexEntry& Entry, TArrayView<const FXSPViewState> ViewStates, float OutOfViewScale, float DefaultPriority)
+{
+    if (ViewStates.IsEmpty() || !Entry.HasBoundingBox())
+        return DefaultPriority;
+
+    //包围球在屏幕上的投影大小,已包含距离因素;取各视点中的最大值
+    FBox BoundingBox(Entry.GetBoundingBox());
+    FVector Center = BoundingBox.GetCenter();
+    FVector Extent = BoundingBox.GetExtent();
+    float Priority = 0;
+    for (const FXSPViewState& ViewState : ViewStates)
+    {
+        float ScreenSize = ComputeScreenSize(Center, Extent, ViewState);
+        if (!ViewState.Frustum.IntersectBox(Center, Extent))
+            ScreenSize *= OutOfViewScale;
+        Priority = FMath::Max(Priority, ScreenSize);
+    }
+    return Priority;
+}
+
+void FXSPCameraPredictor::Update(const FVector& Origin, double Seconds)
+{
+    double DeltaSeconds = Seconds - LastSeconds;
+    if (LastSeconds >= 0 && DeltaSeconds > 0)
+    {
+        FVector InstantVelocity = (Origin - LastOrigin) / DeltaSeconds;
+        if (InstantVelocity.Size() > MaxPredictSpeed)
+            Velocity = FVector::ZeroVector;
+        else
+            Velocity = FMath::Lerp(Velocity, InstantVelocity, VelocitySmoothing);
+    }
+    LastOrigin = Origin;
+    LastSeconds = Seconds;
+}
+
+void FXSPCameraPredictor::Reset()
+{
+    LastOrigin = FVector::ZeroVector;
+    LastSeconds = -1;
+    Velocity = FVector::ZeroVector;
+}
+
+bool FXSPCameraPredictor::Predict(TArrayView<const FXSPViewInfo> Views, float LeadSeconds, TArray<FXSPViewState>& OutViewStates) const
+{
+    OutViewStates.Reset();
+    if (Views.IsEmpty() || LeadSeconds <= 0 || Velocity.Size() < MinPredictSpeed)
+        return false;
+
+    FVector Offset = Velocity * LeadSeconds;
+    OutViewStates.SetNum(Views.Num());
+    for (int32 i = 0; i < Views.Num(); i++)
+    {
+        MakeViewState(Views[i], Offset, OutViewStates[i]);
+    }
+    return true;
+}
+
+void SelectPrefetchNodes(const FXSPHeaderIndex& HeaderIndex, int32 StartDbid, TArrayView<const FXSPViewState> ViewStates, float MinScreenSize, int32 MaxNodes, TArray<FXSPPrefetchCandidate>& OutCandidates)
+{
+    int32 NumNodes = HeaderIndex.Num();
+    int32 NumSelected = 0;
+    for (int32 LocalDbid = 0; LocalDbid < NumNodes && NumSelected < MaxNodes; )
+    {
+        const FXSPHeaderIndexEntry& Entry = HeaderIndex[LocalDbid];
+        //子树中最后一个节点,数据异常时只跳过当前节点
+        int32 LocalLastChildDbid = FMath::Clamp(Entry.LastChildDbid - StartDbid, LocalDbid, NumNodes - 1);
+        bool bLeaf = LocalLastChildDbid == LocalDbid;
+
+        //没有包围盒的中间节点无法裁剪,继续访问其子节点
+        if (!Entry.HasBoundingBox())
+        {
+            LocalDbid++;
+            continue;
+        }
+
+        FBox BoundingBox(Entry.GetBoundingBox());
+        FVector Center = BoundingBox.GetCenter();
+        FVector Extent = BoundingBox.GetExtent();
+        float ScreenSize = 0;
+        for (const FXSPViewState& ViewState : ViewStates)
+        {
+            if (ViewState.Frustum.IntersectBox(Center, Extent))
+                ScreenSize = FMath::Max(ScreenSize, ComputeScreenSize(Center, Extent, ViewState));
+        }
+
+        if (ScreenSize < MinScreenSize)
+        {
+            LocalDbid = LocalLastChildDbid + 1;
+            continue;
+        }
+
+        if (bLeaf)
+        {
+            OutCandidates.Add({ StartDbid + LocalDbid, ScreenSize });
+            NumSelected++;
+        }
+        LocalDbid++;
+    }
+}
+
+void WriteTraceHeader(FArchive& Ar)
+{
+    uint32 Magic = TraceMagic;
+    uint32 Version = TraceVersion;
+    Ar << Magic;
+    Ar << Version;
+}
+
+void WriteTraceFrame(FArchive& Ar, FXSPLoaderTraceFrame& Frame)
+{
+    Ar << Frame.Seconds;
+    int32 NumViews = Frame.Views.Num();
+    Ar << NumViews;
+    for (FXSPViewInfo& View : Frame.Views)
+    {
+        SerializeView(Ar, View);
+    }
+    Ar << Frame.RequestedDbids;
+}
+
+bool ReadTrace(const FString& FilePathName, TArray<FXSPLoaderTraceFrame>& OutFrames)
+{
+    OutFrames.Reset();
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePathName));
+    if (!Reader.IsValid())
+        return false;
+
+    uint32 Magic = 0, Version = 0;
+    *Reader << Magic;
+    *Reader << Version;
+    if (Magic != TraceMagic || Version != TraceVersion)
+    {
+        UE_LOG(LogXSPPrefetch, Warning, TEXT("不是有效的视点轨迹文件: %s"), *FilePathName);
+        return false;
+    }
+
+    while (!Reader->AtEnd() && !Reader->IsError())
+    {
+        FXSPLoaderTraceFrame& Frame = OutFrames.AddDefaulted_GetRef();
+        *Reader << Frame.Seconds;
+        int32 NumViews = 0;
+        *Reader << NumViews;
+        if (NumViews < 0 || Reader->IsError())
+            break;
+        Frame.Views.SetNum(NumViews);
+        for (FXSPViewInfo& View : Frame.Views)
+        {
+            SerializeView(*Reader, View);
+        }
+        *Reader << Frame.RequestedDbids;
+    }
+
+    //丢弃未完整写入的最后一帧
+    if (Reader->IsError() && !OutFrames.IsEmpty())
+        OutFrames.Pop();
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvexVolume.h"
+#include "IXSPLoader.h"
+#include "XSPHeaderIndex.h"
+
+/**
+视点相关的工具,由FXSPLoader与性能测试共用:
+	按节点包围盒计算视点优先级
+	根据相机运动外推视点,选出预测视锥内的节点用于预取
+	记录与读取视点轨迹(xsp.LoaderTrace.Start/Stop录制,xsp.Benchmark.PrefetchReplay回放)
+*/
+
+//视点及其视锥
+struct FXSPViewState
+{
+	FVector Origin;
+	FMatrix ProjectionMatrix;
+	FConvexVolume Frustum;
+};
+
+//由视点生成FXSPViewState,Offset为视点的平移(用于预测)
+void MakeViewState(const FXSPViewInfo& View, const FVector& Offset, FXSPViewState& OutViewState);
+
+//节点包围球在各视点屏幕上投影大小的最大值,视锥外的节点乘以OutOfViewScale;节点没有包围盒时返回DefaultPriority
+float ComputeNodeViewPriority(const FXSPHeaderIndexEntry& Entry, TArrayView<const FXSPViewState> ViewStates, float OutOfViewScale, float DefaultPriority);
+
+//根据视点位置的变化估计相机速度
+class FXSPCameraPredictor
+{
+public:
+	void Update(const FVector& Origin, double Seconds);
+
+	void Reset();
+
+	//按当前速度将视点外推LeadSeconds秒,相机几乎静止时返回false
+	bool Predict(TArrayView<const FXSPViewInfo> Views, float LeadSeconds, TArray<FXSPViewState>& OutViewStates) const;
+
+	const FVector& GetVelocity() const { return Velocity; }
+
+private:
+	FVector LastOrigin = FVector::ZeroVector;
+	double LastSeconds = -1;
+	FVector Velocity = FVector::ZeroVector;
+};
+
+struct FXSPPrefetchCandidate
+{
+	int32 Dbid;
+	float ScreenSize;
+};
+
+/**
+ *	选出视锥内投影大小不小于MinScreenSize的叶子节点
+ *	按头信息中的子树范围遍历,子树根节点的包围盒不与视锥相交或投影过小时跳过整个子树
+ *	@param	StartDbid		[in]	HeaderIndex中第一个节点的全局dbid
+ *	@param	MaxNodes		[in]	最多选出的节点数
+ */
+void SelectPrefetchNodes(const FXSPHeaderIndex& HeaderIndex, int32 StartDbid, TArrayView<const FXSPViewState> ViewStates, float MinScreenSize, int32 MaxNodes, TArray<FXSPPrefetchCandidate>& OutCandidates);
+
+//视点轨迹中的一帧
+struct FXSPLoaderTraceFrame
+{
+	double Seconds = 0;
+	TArray<FXSPViewInfo> Views;
+	//本帧调用方请求的节点(不含预取)
+	TArray<int32> RequestedDbids;
+};
+
+//写入轨迹文件头,之后逐帧写入
+void WriteTraceHeader(FArchive& Ar);
+void WriteTraceFrame(FArchive& Ar, FXSPLoaderTraceFrame& Frame);
+
+bool ReadTrace(const FString& FilePathName, TArray<FXSPLoaderTraceFrame>& OutFrames);
@@ -21,10 +21,68 @@ DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("MinNumVerticesPerBatch"), STAT_XSPLoader_Mi
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("MinNumVerticesUnbatch"), STAT_XSPLoader_MinNumVerticesUnbatch, STATGROUP_XSPLoader);
 
 DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("ReadFileTime"), STAT_XSPLoader_ReadFileTime, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("ReadFileTime Cold"), STAT_XSPLoader_ReadFileTimeCold, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("ReadFileTime Warm"), STAT_XSPLoader_ReadFileTimeWarm, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num GeometryCacheHit"), STAT_XSPLoader_NumGeometryCacheHit, STATGROUP_XSPLoader);
 
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num RawMesh"), STAT_XSPLoader_NumRawMesh, STATGROUP_XSPLoader);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num CylinderMesh"), STAT_XSPLoader_NumCylinderMesh, STATGROUP_XSPLoader);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num EllipticalMesh"), STAT_XSPLoader_NumEllipticalMesh, STATGROUP_XSPLoader);
+//以实例绘制的圆柱体与椭圆形
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num PrimitiveInstance"), STAT_XSPLoader_NumPrimitiveInstance, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num InstancedComponent"), STAT_XSPLoader_NumInstancedComponent, STATGROUP_XSPLoader);
 
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num RawMeshSimplified"), STAT_XSPLoader_NumRawMeshSimplified, STATGROUP_XSPLoader);
 DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num TotalVerticesSimplied"), STAT_XSPLoader_NumTotalVerticesSimplied, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num TotalVerticesWelded"), STAT_XSPLoader_NumTotalVerticesWelded, STATGROUP_XSPLoader);
+
+//读取请求从投入队列到开始处理的累计等待时间,除以请求数即平均值
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("LoadRequest TotalLatency (ms)"), STAT_XSPLoader_LoadRequestLatency, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoadRequestStarted"), STAT_XSPLoader_NumLoadRequestStarted, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoadRequestCancelled"), STAT_XSPLoader_NumLoadRequestCancelled, STATGROUP_XSPLoader);
+//已取出但在读取或构建前被取消(或过期)而放弃的请求数
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoadRequestAbandoned"), STAT_XSPLoader_NumLoadRequestAbandoned, STATGROUP_XSPLoader);
+
+//加载请求各阶段延迟的百分位(毫秒),每xsp.LoaderLatencyReportSeconds秒按该时段内完成的请求更新
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency QueueWait p50 (ms)"), STAT_XSPLoader_LatencyQueueWaitP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency QueueWait p95 (ms)"), STAT_XSPLoader_LatencyQueueWaitP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency QueueWait p99 (ms)"), STAT_XSPLoader_LatencyQueueWaitP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency FileOpen p50 (ms)"), STAT_XSPLoader_LatencyFileOpenP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency FileOpen p95 (ms)"), STAT_XSPLoader_LatencyFileOpenP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency FileOpen p99 (ms)"), STAT_XSPLoader_LatencyFileOpenP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Decode p50 (ms)"), STAT_XSPLoader_LatencyDecodeP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Decode p95 (ms)"), STAT_XSPLoader_LatencyDecodeP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Decode p99 (ms)"), STAT_XSPLoader_LatencyDecodeP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency BuildWait p50 (ms)"), STAT_XSPLoader_LatencyBuildWaitP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency BuildWait p95 (ms)"), STAT_XSPLoader_LatencyBuildWaitP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency BuildWait p99 (ms)"), STAT_XSPLoader_LatencyBuildWaitP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Build p50 (ms)"), STAT_XSPLoader_LatencyBuildP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Build p95 (ms)"), STAT_XSPLoader_LatencyBuildP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Build p99 (ms)"), STAT_XSPLoader_LatencyBuildP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency MergeWait p50 (ms)"), STAT_XSPLoader_LatencyMergeWaitP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency MergeWait p95 (ms)"), STAT_XSPLoader_LatencyMergeWaitP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency MergeWait p99 (ms)"), STAT_XSPLoader_LatencyMergeWaitP99, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Total p50 (ms)"), STAT_XSPLoader_LatencyTotalP50, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Total p95 (ms)"), STAT_XSPLoader_LatencyTotalP95, STATGROUP_XSPLoader);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Latency Total p99 (ms)"), STAT_XSPLoader_LatencyTotalP99, STATGROUP_XSPLoader);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num EncodedMesh"), STAT_XSPLoader_NumEncodedMesh, STATGROUP_XSPLoader);
+DECLARE_MEMORY_STAT(TEXT("NodeData MeshMemory"), STAT_XSPLoader_NodeDataMeshMemory, STATGROUP_XSPLoader);
+
+//FXSPLoader缓存的节点数据与构建完成的网格体,受xsp.LoaderBodyCacheBudgetMB与xsp.LoaderMeshBudgetMB约束
+DECLARE_MEMORY_STAT(TEXT("Loader BodyCacheMemory"), STAT_XSPLoader_LoaderBodyCacheMemory, STATGROUP_XSPLoader);
+DECLARE_MEMORY_STAT(TEXT("Loader MeshMemory"), STAT_XSPLoader_LoaderMeshMemory, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoaderBodyEvicted"), STAT_XSPLoader_NumLoaderBodyEvicted, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoaderMeshEvicted"), STAT_XSPLoader_NumLoaderMeshEvicted, STATGROUP_XSPLoader);
+
+//调用方请求的节点数据是否已在缓存中(由预取或之前的请求读入)
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoaderBodyCacheHit"), STAT_XSPLoader_NumLoaderBodyCacheHit, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoaderBodyCacheMiss"), STAT_XSPLoader_NumLoaderBodyCacheMiss, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num PrefetchRequest"), STAT_XSPLoader_NumPrefetchRequest, STATGROUP_XSPLoader);
+
+//请求的网格体已缓存,直接设置给组件
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num LoaderMeshCacheHit"), STAT_XSPLoader_NumLoaderMeshCacheHit, STATGROUP_XSPLoader);
+
+//按参数共享的动态材质实例(FXSPMaterialCache)
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num MaterialInstance"), STAT_XSPLoader_NumMaterialInstance, STATGROUP_XSPLoader);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Num MaterialInstanceCacheHit"), STAT_XSPLoader_NumMaterialInstanceCacheHit, STATGROUP_XSPLoader);
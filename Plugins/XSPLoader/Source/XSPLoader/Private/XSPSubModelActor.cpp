@@ -22,7 +22,7 @@ void FXSPSubModelActor::Init(AXSPModelActor* InOwner, int32 Dbid, int32 Num)
     TMap<FLinearColor, TArray<int32>> MaterialNodesMap;
     for (int32 Index = 0; Index < Num; Index++)
     {
-        if (NodeDataArray[StartDbid + Index]->MeshPositionArray.IsEmpty())
+        if (!NodeDataArray[StartDbid + Index]->HasGeometry())
             continue;
 
         FLinearColor& Material = NodeDataArray[StartDbid + Index]->MeshMaterial;
@@ -190,7 +190,7 @@ FXSPSubModelMaterialActor* FXSPSubModelActor::GetOrCreateMaterialActor(const FLi
         return Found->Get();
 
     TSharedPtr<FXSPSubModelMaterialActor> Actor = MakeShareable(new FXSPSubModelMaterialActor);
-    Actor->Init(Owner, Owner->CreateMaterialInstanceDynamic(Material, Material.A, FLinearColor::Black), -1, true);
+    Actor->Init(Owner, Owner->AcquireMaterialInstanceDynamic(Material, Material.A, FLinearColor::Black), -1, true);
     MaterialActorMap.Add(Material, Actor);
     return Actor.Get();
 }
@@ -202,7 +202,7 @@ FXSPSubModelMaterialActor* FXSPSubModelActor::GetOrCreateStencilActor(int32 Cust
         return Found->Get();
 
     TSharedPtr<FXSPSubModelMaterialActor> Actor = MakeShareable(new FXSPSubModelMaterialActor);
-    Actor->Init(Owner, Owner->CreateMaterialInstanceDynamic(FLinearColor::White, 0, FLinearColor::Black), CustomDepthStencilValue, false);
+    Actor->Init(Owner, Owner->AcquireMaterialInstanceDynamic(FLinearColor::White, 0, FLinearColor::Black), CustomDepthStencilValue, false);
     CustomStencilActorMap.Add(CustomDepthStencilValue, Actor);
     return Actor.Get();
 }
@@ -214,7 +214,7 @@ FXSPSubModelMaterialActor* FXSPSubModelActor::GetOrCreateHighlightActor(const FL
         return Found->Get();
 
     TSharedPtr<FXSPSubModelMaterialActor> Actor = MakeShareable(new FXSPSubModelMaterialActor);
-    Actor->Init(Owner, Owner->CreateMaterialInstanceDynamic(Color, 1, Color), -1, true);
+    Actor->Init(Owner, Owner->AcquireMaterialInstanceDynamic(Color, 1, Color), -1, true);
     HighlightActorMap.Add(Color, Actor);
     return Actor.Get();
 }
@@ -225,7 +225,7 @@ TArray<int32> FXSPSubModelActor::GetChildLeafNodeArray(int32 Dbid)
     TArray<int32> ChildLeafNodeArray;
     for (int32 Index = 0; Index < NodeDataArray[Dbid]->NumChildren; Index++)
     {
-        if (!NodeDataArray[Dbid + Index]->MeshPositionArray.IsEmpty())
+        if (NodeDataArray[Dbid + Index]->HasGeometry())
         {
             ChildLeafNodeArray.Add(Dbid + Index);
         }
@@ -242,7 +242,7 @@ TArray<int32> FXSPSubModelActor::GetChildLeafNodeArray(const TArray<int32>& Dbid
     {
         for (int32 Index = 0; Index < NodeDataArray[Dbid]->NumChildren; Index++)
         {
-            if (!NodeDataArray[Dbid + Index]->MeshPositionArray.IsEmpty() &&
+            if (NodeDataArray[Dbid + Index]->HasGeometry() &&
                 !ChildLeafNodeArray.Contains(Dbid + Index))
             {
                 ChildLeafNodeArray.Add(Dbid + Index);
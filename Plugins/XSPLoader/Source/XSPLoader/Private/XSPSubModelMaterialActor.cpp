@@ -3,13 +3,16 @@
 #include "XSPModelActor.h"
 #include "XSPDataStruct.h"
 #include "MeshUtils.h"
+#include "XSPMeshCodec.h"
 #include "XSPStat.h"
 #include "XSPBatchMeshComponent.h"
 #include "XSPCustomMeshComponent.h"
+#include "XSPInstancedPrimitiveComponent.h"
 
 extern int32 XSPMaxNumVerticesPerBatch;
 extern int32 XSPMinNumVerticesPerBatch;
 extern int32 XSPMinNumVerticesUnbatch;
+extern bool bXSPInstancePrimitives;
 
 
 FXSPSubModelMaterialActor::FXSPSubModelMaterialActor()
@@ -18,6 +21,8 @@ FXSPSubModelMaterialActor::FXSPSubModelMaterialActor()
 
 FXSPSubModelMaterialActor::~FXSPSubModelMaterialActor()
 {
+    if (nullptr != MaterialInstanceDynamic)
+        Owner->ReleaseMaterialInstanceDynamic(MaterialInstanceDynamic);
 }
 
 void FXSPSubModelMaterialActor::Init(AXSPModelActor* InOwner, UMaterialInstanceDynamic* Material, int32 InCustomDepthStencilValue, bool bInRenderInMainAndDepthPass)
@@ -26,6 +31,7 @@ void FXSPSubModelMaterialActor::Init(AXSPModelActor* InOwner, UMaterialInstanceD
     MaterialInstanceDynamic = Material;
     CustomDepthStencilValue = InCustomDepthStencilValue;
     bRenderInMainAndDepthPass = bInRenderInMainAndDepthPass;
+    bInstancePrimitives = bXSPInstancePrimitives;
 }
 
 void FXSPSubModelMaterialActor::AddNode(int32 Dbid)
@@ -57,6 +63,11 @@ bool FXSPSubModelMaterialActor::TickDynamicCombine(float& InOutSeconds, bool bAs
         ProcessBatch(bAsyncBuild);
     }
 
+    if (InstanceNodeToAddArray.Num() > 0 || InstanceNodeToRemoveArray.Num() > 0)
+    {
+        ProcessInstances();
+    }
+
     bool bFinished = ProcessRegister();
 
     InOutSeconds -= (float)(FDateTime::Now().GetTicks() - BeginTicks) / ETimespan::TicksPerSecond;
@@ -81,6 +92,19 @@ bool FXSPSubModelMaterialActor::PreProcess()
         if (!NodeComponentMap.Contains(Dbid))
             continue;
 
+        if (InstanceNodeSet.Remove(Dbid) > 0)
+        {
+            InstanceNodeToRemoveArray.Add(Dbid);
+        }
+
+        //只有实例的节点没有对应的Component
+        if (nullptr == NodeComponentMap[Dbid])
+        {
+            NodeToBuildArray.Remove(Dbid);
+            NodeComponentMap.Remove(Dbid);
+            continue;
+        }
+
         MyComponentClass* Component = Cast<MyComponentClass>(NodeComponentMap[Dbid]);
         check(Component);
         if (!ComponentsToRelease.Contains(Component))
@@ -96,13 +120,23 @@ bool FXSPSubModelMaterialActor::PreProcess()
     NodeToRemoveArray.Reset();
 
     //处理待添加
+    const TArray<FXSPNodeData*>& NodeDataArray = Owner->GetNodeDataArray();
     for (int32 Dbid : NodeToAddArray)
     {
         if (NodeComponentMap.Contains(Dbid))
             continue;
 
         NodeComponentMap.Add(Dbid, nullptr);
-        NodeToBuildArray.Add(Dbid);
+        if (bInstancePrimitives && NodeDataArray[Dbid]->HasInstanceablePrimitive())
+        {
+            InstanceNodeSet.Add(Dbid);
+            InstanceNodeToAddArray.Add(Dbid);
+        }
+        //节点网格与不以实例绘制的参数化几何体合批
+        if (GetNodeMeshNumVertices(*NodeDataArray[Dbid], bInstancePrimitives) > 0)
+        {
+            NodeToBuildArray.Add(Dbid);
+        }
     }
     NodeToAddArray.Reset();
 
@@ -141,7 +175,7 @@ void FXSPSubModelMaterialActor::ProcessBatch(bool bAsyncBuild)
     const TArray<FXSPNodeData*>& NodeDataArray = Owner->GetNodeDataArray();
     for (int32 Dbid : NodeToBuildArray)
     {
-        int32 NodeVertexNum = NodeDataArray[Dbid]->MeshPositionArray.Num();
+        int32 NodeVertexNum = GetNodeMeshNumVertices(*NodeDataArray[Dbid], bInstancePrimitives);
         //独立成包的
         if (NodeVertexNum > XSPMinNumVerticesUnbatch)
         {
@@ -166,6 +200,69 @@ void FXSPSubModelMaterialActor::ProcessBatch(bool bAsyncBuild)
     NodeToBuildArray.Reset();
 }
 
+void FXSPSubModelMaterialActor::ProcessInstances()
+{
+    //先移除,同一节点先移除再添加时实例得以更新
+    if (InstanceNodeToRemoveArray.Num() > 0)
+    {
+        for (TPair<UStaticMesh*, UXSPInstancedPrimitiveComponent*>& Pair : InstancedComponentMap)
+        {
+            Pair.Value->RemoveNodeInstances(InstanceNodeToRemoveArray);
+        }
+    }
+
+    //按单位网格体分组收集待添加的实例
+    struct FInstanceGroup
+    {
+        TArray<int32> DbidArray;
+        TArray<FTransform> TransformArray;
+    };
+    TMap<UStaticMesh*, FInstanceGroup> InstanceGroupMap;
+    const TArray<FXSPNodeData*>& NodeDataArray = Owner->GetNodeDataArray();
+    for (int32 Dbid : InstanceNodeToAddArray)
+    {
+        for (const FXSPPrimitiveInstance& Instance : NodeDataArray[Dbid]->PrimitiveInstanceArray)
+        {
+            if (!Instance.CanInstance())
+                continue;
+            FInstanceGroup& Group = InstanceGroupMap.FindOrAdd(Owner->GetPrimitiveUnitMesh(Instance));
+            Group.DbidArray.Add(Dbid);
+            Group.TransformArray.Add(GetPrimitiveInstanceTransform(Instance));
+        }
+    }
+
+    //创建Component或在已有的Component上追加实例
+    for (TPair<UStaticMesh*, FInstanceGroup>& Pair : InstanceGroupMap)
+    {
+        UXSPInstancedPrimitiveComponent*& Component = InstancedComponentMap.FindOrAdd(Pair.Key, nullptr);
+        if (nullptr == Component)
+        {
+            Component = NewObject<UXSPInstancedPrimitiveComponent>(Owner);
+            INC_DWORD_STAT(STAT_XSPLoader_NumInstancedComponent);
+            Component->SetStaticMesh(Pair.Key);
+            SetupComponent(Component);
+            Component->AttachToComponent(Owner->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
+            Component->RegisterComponent();
+        }
+        Component->AddNodeInstances(Pair.Value.DbidArray, Pair.Value.TransformArray);
+    }
+
+    //释放已没有实例的Component
+    for (TMap<UStaticMesh*, UXSPInstancedPrimitiveComponent*>::TIterator Itr(InstancedComponentMap); Itr; ++Itr)
+    {
+        if (Itr->Value->GetInstanceCount() == 0)
+        {
+            Itr->Value->DetachFromComponent(FDetachmentTransformRules::KeepRelativeTransform);
+            Itr->Value->DestroyComponent();
+            DEC_DWORD_STAT(STAT_XSPLoader_NumInstancedComponent);
+            Itr.RemoveCurrent();
+        }
+    }
+
+    InstanceNodeToAddArray.Reset();
+    InstanceNodeToRemoveArray.Reset();
+}
+
 bool FXSPSubModelMaterialActor::ProcessRegister()
 {
     for (TArray<TStrongObjectPtr<UPrimitiveComponent>>::TIterator Itr(BuildingComponentArray); Itr; ++Itr)
@@ -194,14 +291,9 @@ void FXSPSubModelMaterialActor::AddComponent(const TArray<int32>& DbidArray, boo
     }
     BatchMeshComponentArray.Add(Component);
 
-    Component->SetMaterial(0, MaterialInstanceDynamic);
-    Component->SetMobility(EComponentMobility::Movable);
-    Component->SetRenderInMainPass(bRenderInMainAndDepthPass);
-    Component->SetRenderInDepthPass(bRenderInMainAndDepthPass);
-    Component->SetRenderCustomDepth(CustomDepthStencilValue >= 0);
-    Component->SetCustomDepthStencilValue(CustomDepthStencilValue);
+    SetupComponent(Component);
 
-    Component->Init(Owner, DbidArray, bAsyncBuild);
+    Component->Init(Owner, DbidArray, bAsyncBuild, bInstancePrimitives);
     if (bAsyncBuild)
     {
         BuildingComponentArray.Add(TStrongObjectPtr<UPrimitiveComponent>(Component));
@@ -239,3 +331,13 @@ void FXSPSubModelMaterialActor::RegisterComponent(UPrimitiveComponent* Component
     INC_DWORD_STAT(STAT_XSPLoader_NumRegisteredComponents);
     INC_DWORD_STAT_BY(STAT_XSPLoader_NumRegisteredVertices, Cast<MyComponentClass>(Component)->GetNumVertices());
 }
+
+void FXSPSubModelMaterialActor::SetupComponent(UPrimitiveComponent* Component)
+{
+    Component->SetMaterial(0, MaterialInstanceDynamic);
+    Component->SetMobility(EComponentMobility::Movable);
+    Component->SetRenderInMainPass(bRenderInMainAndDepthPass);
+    Component->SetRenderInDepthPass(bRenderInMainAndDepthPass);
+    Component->SetRenderCustomDepth(CustomDepthStencilValue >= 0);
+    Component->SetCustomDepthStencilValue(CustomDepthStencilValue);
+}
\ No newline at end of file
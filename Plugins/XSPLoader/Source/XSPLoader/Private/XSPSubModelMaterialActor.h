@@ -3,6 +3,7 @@
 #include "CoreMinimal.h"
 
 class AXSPModelActor;
+class UXSPInstancedPrimitiveComponent;
 
 class FXSPSubModelMaterialActor
 {
@@ -27,10 +28,12 @@ public:
 private:
     bool PreProcess();
     void ProcessBatch(bool bAsyncBuild);
+    void ProcessInstances();
     bool ProcessRegister();
     void AddComponent(const TArray<int32>& DbidArray, bool bAsyncBuild);
     void ReleaseComponent(UPrimitiveComponent* Component);
     void RegisterComponent(UPrimitiveComponent* Component);
+    void SetupComponent(UPrimitiveComponent* Component);
 
 private:
     AXSPModelActor* Owner;
@@ -41,6 +44,9 @@ private:
 
     bool bRenderInMainAndDepthPass = true;
 
+    //参数化几何体以实例绘制,否则在合批时生成网格(创建时取xsp.InstancePrimitives)
+    bool bInstancePrimitives = true;
+
     TArray<int32> NodeArray;
 
     TArray<int32> NodeToAddArray;
@@ -55,4 +61,14 @@ private:
 
     //尚在异步构建中的Component的数组
     TArray<TStrongObjectPtr<UPrimitiveComponent>> BuildingComponentArray;
+
+    //含圆柱体、椭圆形实例的节点
+    TSet<int32> InstanceNodeSet;
+
+    //待添加、移除实例的节点,只增量更新实例化的Component
+    TArray<int32> InstanceNodeToAddArray;
+    TArray<int32> InstanceNodeToRemoveArray;
+
+    //以单位网格体为索引的实例化Component
+    TMap<UStaticMesh*, UXSPInstancedPrimitiveComponent*> InstancedComponentMap;
 };
\ No newline at end of file
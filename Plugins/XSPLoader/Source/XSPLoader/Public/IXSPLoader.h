@@ -7,6 +7,22 @@
 #include "Components/StaticMeshComponent.h"
 #include "UObject/WeakObjectPtrTemplates.h"
 
+//批量请求中的一项
+struct FXSPStaticMeshRequestDesc
+{
+	int32 Dbid;
+	float Priority;
+	UStaticMeshComponent* TargetMeshComponent;
+};
+
+//视点,用于自动计算请求优先级
+struct FXSPViewInfo
+{
+	FVector Origin;
+	FMatrix ProjectionMatrix;
+	FMatrix ViewProjectionMatrix;
+};
+
 class IXSPLoader
 {
 public:
@@ -31,4 +47,31 @@ public:
 	 */
 	virtual void RequestStaticMesh_GameThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) = 0;
 	virtual void RequestStaticMesh_AnyThread(int32 Dbid, float Priority, UStaticMeshComponent* TargetMeshComponent) = 0;
+
+	/**
+	 *	批量请求静态网格数据，与逐个调用RequestStaticMesh相同，但加锁与队列操作按批次分摊
+	 *	@param	Requests			[in]	请求数组
+	 */
+	virtual void RequestStaticMeshes_GameThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests) = 0;
+	virtual void RequestStaticMeshes_AnyThread(TArrayView<const FXSPStaticMeshRequestDesc> Requests) = 0;
+
+	/**
+	 *	更新已有请求的优先级，请求在队列中时立即按新优先级排序（只能在Game线程调用）
+	 *	@param	Dbid				[in]	请求的节点
+	 *  @param	Priority			[in]	新的优先级
+	 */
+	virtual void UpdatePriority(int32 Dbid, float Priority) = 0;
+
+	/**
+	 *	取消请求，排队中的请求立即移出队列，已取出的请求在读取和构建网格体之前放弃（只能在Game线程调用）
+	 *	@param	Dbid				[in]	请求的节点
+	 */
+	virtual void CancelRequest(int32 Dbid) = 0;
+
+	/**
+	 *	设置当前视点（每帧调用），设置后请求的优先级由节点包围盒在屏幕上的投影大小与距离自动计算，
+	 *	调用方传入的优先级只用于没有包围盒的节点
+	 *	@param	Views				[in]	视点数组，为空时恢复使用调用方传入的优先级
+	 */
+	virtual void SetViews_GameThread(TArrayView<const FXSPViewInfo> Views) = 0;
 };
@@ -5,8 +5,10 @@
 #include "XSPModelActor.generated.h"
 
 struct FXSPNodeData;
+struct FXSPPrimitiveInstance;
 class FXSPFileReader;
 class FXSPSubModelActor;
+class FXSPMaterialCache;
 
 UCLASS()
 class XSPLOADER_API AXSPModelActor : public AActor
@@ -26,10 +28,14 @@ public:
 	UFUNCTION(BlueprintPure)
 	int32 GetNumNodes();
 
-	//查询拾取到的节点DBID
+	//查询拾取到的节点DBID(圆柱体、椭圆形等实例化绘制的组件,FaceIndex传入拾取结果的Item即实例序号)
 	UFUNCTION(BlueprintPure)
 	int32 GetNode(UPrimitiveComponent* Component, int32 FaceIndex);
 
+	//由拾取结果查询节点DBID,按组件类型取FaceIndex或实例序号
+	UFUNCTION(BlueprintPure)
+	int32 GetNodeFromHit(const FHitResult& Hit);
+
 	//查询节点包围盒
 	UFUNCTION(BlueprintCallable)
 	FBox3f GetNodeBoundingBox(int32 Dbid);
@@ -91,7 +97,11 @@ public:
 	virtual void Tick(float DeltaTime) override;
 
 	inline const TArray<FXSPNodeData*>& GetNodeDataArray() const { return NodeDataArray; }
-	UMaterialInstanceDynamic* CreateMaterialInstanceDynamic(const FLinearColor& BaseColor, float Roughness, const FLinearColor& EmissiveColor);
+	//获取参数相同时共享的材质实例,不再使用时调用ReleaseMaterialInstanceDynamic
+	UMaterialInstanceDynamic* AcquireMaterialInstanceDynamic(const FLinearColor& BaseColor, float Roughness, const FLinearColor& EmissiveColor);
+	void ReleaseMaterialInstanceDynamic(UMaterialInstanceDynamic* MaterialInstanceDynamic);
+	//获取实例共享的单位网格体,按几何体类型与圆周分段数创建一次
+	UStaticMesh* GetPrimitiveUnitMesh(const FXSPPrimitiveInstance& Instance);
 
 private:
 	bool LoadToDynamicCombinedMesh(const TArray<FString>& FilePathNameArray);
@@ -111,8 +121,12 @@ private:
 	UPROPERTY()
 	UMaterialInterface* SourceMaterialTranslucent = nullptr;
 
+	//按参数共享的材质实例,由子模型的材质Actor引用
+	TUniquePtr<FXSPMaterialCache> MaterialCache;
+
+	//圆柱体、椭圆形实例共享的单位网格体,键为几何体类型与圆周分段数
 	UPROPERTY()
-	TArray<UMaterialInterface*> MaterialInstanceArray;
+	TMap<int32, UStaticMesh*> PrimitiveUnitMeshMap;
 
 	TMap<int32, TSharedPtr<FXSPSubModelActor>> SubModelActorMap;
 
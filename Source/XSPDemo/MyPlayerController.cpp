@@ -3,6 +3,7 @@
 
 #include "MyPlayerController.h"
 #include "Engine/EngineTypes.h"
+#include "Components/InstancedStaticMeshComponent.h"
 
 bool AMyPlayerController::GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult) const
 {
@@ -18,6 +19,12 @@ bool AMyPlayerController::GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTy
             CollisionQueryParams.bTraceComplex = true;
             CollisionQueryParams.bReturnFaceIndex = true;
             bHit = GetHitResultAtScreenPosition(MousePosition, UEngineTypes::ConvertToCollisionChannel(TraceChannel), CollisionQueryParams, HitResult);
+
+            //实例化绘制的组件(圆柱体、椭圆形)按实例拾取节点,以实例序号Item代替FaceIndex传给AXSPModelActor::GetNode
+            if (bHit && Cast<UInstancedStaticMeshComponent>(HitResult.GetComponent()))
+            {
+                HitResult.FaceIndex = HitResult.Item;
+            }
         }
     }
 
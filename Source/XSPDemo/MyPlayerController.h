@@ -15,7 +15,7 @@ class XSPDEMO_API AMyPlayerController : public APlayerController
 	GENERATED_BODY()
 	
 public:
-	//封装这个拾取函数以便能够在HitResult中返回FaceIndex
+	//封装这个拾取函数以便能够在HitResult中返回FaceIndex(实例化绘制的组件返回实例序号)
 	UFUNCTION(BlueprintCallable, Category = "Game|Player")
 	bool GetHitResultWithFaceIndexUnderCursorByChannel(ETraceTypeQuery TraceChannel, FHitResult& HitResult) const;
 };